@@ -0,0 +1,168 @@
+// Rachel Crawford 2016
+// This file lives at https://github.com/rachelnertia/Box2D-Raycasting-Test
+
+#include "benchmark_report.h"
+
+#include <cstdlib>
+#include <iomanip>
+#include <istream>
+#include <map>
+#include <ostream>
+#include <sstream>
+
+const ProfileField kProfileFields[] = {
+	{ "step", &b2Profile::step },
+	{ "collide", &b2Profile::collide },
+	{ "solve", &b2Profile::solve },
+	{ "solve_init", &b2Profile::solveInit },
+	{ "solve_velocity", &b2Profile::solveVelocity },
+	{ "solve_position", &b2Profile::solvePosition },
+	{ "broadphase", &b2Profile::broadphase },
+	{ "solve_toi", &b2Profile::solveTOI },
+};
+
+const int kProfileFieldCount = int(sizeof(kProfileFields) / sizeof(kProfileFields[0]));
+
+namespace {
+
+std::vector<std::string> SplitCsvLine(const std::string& line) {
+	std::vector<std::string> cells;
+	std::stringstream stream(line);
+	std::string cell;
+	while (std::getline(stream, cell, ',')) {
+		// Tolerate files that were saved with Windows line endings.
+		if (!cell.empty() && cell.back() == '\r') {
+			cell.pop_back();
+		}
+		cells.push_back(cell);
+	}
+	return cells;
+}
+
+double PercentChange(double base, double now) {
+	return base != 0.0 ? 100.0 * (now - base) / base : 0.0;
+}
+
+}
+
+void WriteCsv(std::ostream& out, const std::vector<BenchmarkResult>& results) {
+	out << "scene,steps,bodies,peak_contacts,peak_bytes,total_ms,steps_per_sec";
+	for (const ProfileField& field : kProfileFields) {
+		out << ',' << field.name << "_mean_ms," << field.name << "_max_ms";
+	}
+	out << '\n';
+
+	for (const BenchmarkResult& result : results) {
+		out << result.scene << ',' << result.steps << ',' << result.bodies << ',' <<
+			result.peak_contacts << ',' << result.peak_bytes << ',' << result.total_ms << ',' <<
+			result.steps_per_sec;
+		for (const ProfileField& field : kProfileFields) {
+			out << ',' << result.mean.*field.member << ',' << result.max.*field.member;
+		}
+		out << '\n';
+	}
+}
+
+void WriteJson(std::ostream& out, const std::vector<BenchmarkResult>& results) {
+	out << "[\n";
+	for (size_t i = 0; i < results.size(); ++i) {
+		const BenchmarkResult& result = results[i];
+		out << "  {\"scene\": \"" << result.scene << "\", \"steps\": " << result.steps <<
+			", \"bodies\": " << result.bodies << ", \"peak_contacts\": " << result.peak_contacts <<
+			", \"peak_bytes\": " << result.peak_bytes << ", \"total_ms\": " << result.total_ms <<
+			", \"steps_per_sec\": " << result.steps_per_sec << ",\n   \"profile\": {";
+		for (int f = 0; f < kProfileFieldCount; ++f) {
+			const ProfileField& field = kProfileFields[f];
+			out << (f > 0 ? ", " : "") << '"' << field.name << "\": {\"mean_ms\": " <<
+				result.mean.*field.member << ", \"max_ms\": " << result.max.*field.member << '}';
+		}
+		out << "}}" << (i + 1 < results.size() ? "," : "") << '\n';
+	}
+	out << "]\n";
+}
+
+bool ReadCsv(std::istream& in, std::vector<BenchmarkResult>& results) {
+	std::string line;
+	if (!std::getline(in, line)) {
+		return false;
+	}
+
+	std::map<std::string, size_t> columns;
+	std::vector<std::string> header = SplitCsvLine(line);
+	for (size_t i = 0; i < header.size(); ++i) {
+		columns[header[i]] = i;
+	}
+	if (!columns.count("scene") || !columns.count("steps_per_sec")) {
+		return false;
+	}
+
+	while (std::getline(in, line)) {
+		std::vector<std::string> cells = SplitCsvLine(line);
+		if (cells.size() != header.size()) {
+			continue;
+		}
+
+		// Missing columns read as zero.
+		auto number = [&](const std::string& name) {
+			auto column = columns.find(name);
+			return column != columns.end() ? std::atof(cells[column->second].c_str()) : 0.0;
+		};
+
+		BenchmarkResult result;
+		result.scene = cells[columns["scene"]];
+		result.steps = int(number("steps"));
+		result.bodies = int(number("bodies"));
+		result.peak_contacts = int(number("peak_contacts"));
+		result.peak_bytes = int(number("peak_bytes"));
+		result.total_ms = number("total_ms");
+		result.steps_per_sec = number("steps_per_sec");
+		for (const ProfileField& field : kProfileFields) {
+			result.mean.*field.member = float32(number(std::string(field.name) + "_mean_ms"));
+			result.max.*field.member = float32(number(std::string(field.name) + "_max_ms"));
+		}
+		results.push_back(result);
+	}
+	return true;
+}
+
+int CompareToBaseline(std::ostream& out, const std::vector<BenchmarkResult>& results,
+	const std::vector<BenchmarkResult>& baseline, float threshold_percent) {
+	int regressions = 0;
+
+	out << std::left << std::setw(18) << "scene" << std::right <<
+		std::setw(12) << "base/s" << std::setw(12) << "now/s" << std::setw(10) << "change" <<
+		std::setw(12) << "base step" << std::setw(12) << "now step" << std::setw(12) << "peak KiB" << '\n';
+	out << std::fixed;
+
+	for (const BenchmarkResult& result : results) {
+		const BenchmarkResult* base = nullptr;
+		for (const BenchmarkResult& candidate : baseline) {
+			if (candidate.scene == result.scene) {
+				base = &candidate;
+				break;
+			}
+		}
+
+		out << std::left << std::setw(18) << result.scene << std::right;
+		if (base == nullptr) {
+			out << "  not in baseline\n";
+			continue;
+		}
+
+		const double change = PercentChange(base->steps_per_sec, result.steps_per_sec);
+		const bool slower = change < -threshold_percent;
+		if (slower) {
+			++regressions;
+		}
+
+		out << std::setprecision(1) << std::setw(12) << base->steps_per_sec <<
+			std::setw(12) << result.steps_per_sec << std::setw(9) << std::showpos << change <<
+			std::noshowpos << '%' << std::setprecision(3) << std::setw(12) << base->mean.step <<
+			std::setw(12) << result.mean.step << std::setprecision(0) << std::setw(12) <<
+			(result.peak_bytes / 1024.0) << (slower ? "  SLOWER" : "") << '\n';
+	}
+
+	out.unsetf(std::ios::floatfield);
+	out << std::setprecision(6);
+	return regressions;
+}
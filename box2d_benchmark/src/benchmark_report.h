@@ -0,0 +1,54 @@
+// Rachel Crawford 2016
+// This file lives at https://github.com/rachelnertia/Box2D-Raycasting-Test
+
+#ifndef BENCHMARK_REPORT_H_
+#define BENCHMARK_REPORT_H_
+
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+#include "Box2D/Dynamics/b2TimeStep.h"
+
+// A b2Profile field and the name it is reported under.
+struct ProfileField {
+	const char* name;
+	float32 b2Profile::*member;
+};
+
+// The b2Profile fields in report order.
+extern const ProfileField kProfileFields[];
+extern const int kProfileFieldCount;
+
+// What running one scene measured. Times are in milliseconds.
+struct BenchmarkResult {
+	std::string scene;
+	int steps;
+	int bodies;
+	int peak_contacts;
+	int peak_bytes;
+	double total_ms;
+	double steps_per_sec;
+	// The per-phase times of the world's b2Profile, averaged over the steps and at
+	// their worst.
+	b2Profile mean;
+	b2Profile max;
+};
+
+// Write results as CSV with a header row.
+void WriteCsv(std::ostream& out, const std::vector<BenchmarkResult>& results);
+
+// Write results as a JSON array with one object per scene.
+void WriteJson(std::ostream& out, const std::vector<BenchmarkResult>& results);
+
+// Read results written by WriteCsv, e.g. from an earlier build. Columns are found by
+// name, so baselines keep working when columns are added. Returns false if there is
+// no header or a required column is missing.
+bool ReadCsv(std::istream& in, std::vector<BenchmarkResult>& results);
+
+// Print how each scene's speed and step times changed from the baseline.
+// Returns the number of scenes whose steps/sec dropped by more than threshold_percent.
+int CompareToBaseline(std::ostream& out, const std::vector<BenchmarkResult>& results,
+	const std::vector<BenchmarkResult>& baseline, float threshold_percent);
+
+#endif//BENCHMARK_REPORT_H_
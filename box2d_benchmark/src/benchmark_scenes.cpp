@@ -0,0 +1,265 @@
+// Rachel Crawford 2016
+// This file lives at https://github.com/rachelnertia/Box2D-Raycasting-Test
+
+#include "benchmark_scenes.h"
+
+#include <cmath>
+#include <vector>
+
+#include "Box2D/Box2D.h"
+
+namespace {
+
+// A small linear congruential generator, so scenes don't depend on the C library's rand.
+class Random {
+public:
+	explicit Random(unsigned seed) : m_state(seed) {}
+
+	// A number in [lo, hi).
+	float Next(float lo, float hi) {
+		m_state = m_state * 1664525u + 1013904223u;
+		return lo + (hi - lo) * ((m_state >> 8) * (1.0f / 16777216.0f));
+	}
+
+private:
+	unsigned m_state;
+};
+
+b2Body* AddBody(b2World& world, b2BodyType type, const b2Vec2& position, const b2Shape& shape,
+	float density) {
+	b2BodyDef body_def;
+	body_def.type = type;
+	body_def.position = position;
+	b2Body* body = world.CreateBody(&body_def);
+	body->CreateFixture(&shape, density);
+	return body;
+}
+
+// A flat edge along y = 0.
+b2Body* AddGround(b2World& world, float half_width) {
+	b2EdgeShape edge;
+	edge.Set(b2Vec2(-half_width, 0.0f), b2Vec2(half_width, 0.0f));
+	return AddBody(world, b2_staticBody, b2Vec2_zero, edge, 0.0f);
+}
+
+// Boxes are shape 0, circles 1 and triangles 2.
+void AddMixedShape(b2World& world, const b2Vec2& position, float size, int shape) {
+	switch (shape % 3) {
+	case 0: {
+		b2PolygonShape box;
+		box.SetAsBox(size, size);
+		AddBody(world, b2_dynamicBody, position, box, 1.0f);
+		break;
+	}
+	case 1: {
+		b2CircleShape circle;
+		circle.m_radius = size;
+		AddBody(world, b2_dynamicBody, position, circle, 1.0f);
+		break;
+	}
+	default: {
+		b2Vec2 vertices[3] = { b2Vec2(-size, -size), b2Vec2(size, -size), b2Vec2(0.0f, size) };
+		b2PolygonShape triangle;
+		triangle.Set(vertices, 3);
+		AddBody(world, b2_dynamicBody, position, triangle, 1.0f);
+		break;
+	}
+	}
+}
+
+// 820 boxes stacked in rows that get one shorter each time.
+void CreatePyramid(b2World& world) {
+	AddGround(world, 40.0f);
+
+	const int base = 40;
+	b2PolygonShape box;
+	box.SetAsBox(0.5f, 0.5f);
+	for (int row = 0; row < base; ++row) {
+		const int count = base - row;
+		for (int i = 0; i < count; ++i) {
+			b2Vec2 position(i - 0.5f * (count - 1), 0.5f + row);
+			AddBody(world, b2_dynamicBody, position, box, 1.0f);
+		}
+	}
+}
+
+// A motorised box that turns over the shapes dropped into it, one per step.
+const int kTumblerShapes = 800;
+
+void CreateTumbler(b2World& world) {
+	b2BodyDef ground_def;
+	b2Body* ground = world.CreateBody(&ground_def);
+
+	b2BodyDef body_def;
+	body_def.type = b2_dynamicBody;
+	body_def.allowSleep = false;
+	body_def.position.Set(0.0f, 10.0f);
+	b2Body* body = world.CreateBody(&body_def);
+
+	b2PolygonShape wall;
+	wall.SetAsBox(0.5f, 10.0f, b2Vec2(10.0f, 0.0f), 0.0f);
+	body->CreateFixture(&wall, 5.0f);
+	wall.SetAsBox(0.5f, 10.0f, b2Vec2(-10.0f, 0.0f), 0.0f);
+	body->CreateFixture(&wall, 5.0f);
+	wall.SetAsBox(10.0f, 0.5f, b2Vec2(0.0f, 10.0f), 0.0f);
+	body->CreateFixture(&wall, 5.0f);
+	wall.SetAsBox(10.0f, 0.5f, b2Vec2(0.0f, -10.0f), 0.0f);
+	body->CreateFixture(&wall, 5.0f);
+
+	b2RevoluteJointDef joint_def;
+	joint_def.bodyA = ground;
+	joint_def.bodyB = body;
+	joint_def.localAnchorA.Set(0.0f, 10.0f);
+	joint_def.localAnchorB.Set(0.0f, 0.0f);
+	joint_def.referenceAngle = 0.0f;
+	joint_def.motorSpeed = 0.05f * b2_pi;
+	joint_def.maxMotorTorque = 1e8f;
+	joint_def.enableMotor = true;
+	world.CreateJoint(&joint_def);
+}
+
+void UpdateTumbler(b2World& world, int step) {
+	if (step < kTumblerShapes) {
+		AddMixedShape(world, b2Vec2(0.0f, 10.0f), 0.125f, step);
+	}
+}
+
+// 2000 circles dropped into an open box.
+void CreateFallingCircles(b2World& world) {
+	const float half_width = 20.0f;
+	b2Body* ground = AddGround(world, half_width);
+	b2EdgeShape wall;
+	wall.Set(b2Vec2(-half_width, 0.0f), b2Vec2(-half_width, 60.0f));
+	ground->CreateFixture(&wall, 0.0f);
+	wall.Set(b2Vec2(half_width, 0.0f), b2Vec2(half_width, 60.0f));
+	ground->CreateFixture(&wall, 0.0f);
+
+	Random random(1);
+	b2CircleShape circle;
+	circle.m_radius = 0.25f;
+	const int columns = 50;
+	const int rows = 40;
+	for (int row = 0; row < rows; ++row) {
+		for (int i = 0; i < columns; ++i) {
+			b2Vec2 position(-18.0f + 0.72f * i + random.Next(-0.1f, 0.1f), 2.0f + 0.75f * row);
+			AddBody(world, b2_dynamicBody, position, circle, 1.0f);
+		}
+	}
+}
+
+// Chains of limb-sized boxes joined by limited revolute joints, like ragdoll limbs.
+// They start out level, swing down and tangle with their neighbours.
+void CreateRagdollChains(b2World& world) {
+	b2Body* ground = AddGround(world, 200.0f);
+
+	const int chains = 10;
+	const int links = 40;
+	const float height = 30.0f;
+	b2PolygonShape link;
+	link.SetAsBox(0.5f, 0.125f);
+	for (int c = 0; c < chains; ++c) {
+		const float x = -100.0f + 15.0f * c;
+		b2Body* previous = ground;
+		for (int i = 0; i < links; ++i) {
+			b2Body* body = AddBody(world, b2_dynamicBody, b2Vec2(x + i + 0.5f, height), link, 1.0f);
+
+			b2RevoluteJointDef joint_def;
+			joint_def.Initialize(previous, body, b2Vec2(x + i, height));
+			if (previous != ground) {
+				joint_def.lowerAngle = -0.25f * b2_pi;
+				joint_def.upperAngle = 0.25f * b2_pi;
+				joint_def.enableLimit = true;
+			}
+			world.CreateJoint(&joint_def);
+			previous = body;
+		}
+	}
+}
+
+// 2000m of bumpy terrain in one chain shape, optionally with a segment tree.
+void AddTerrain(b2World& world, Random& random, bool segment_tree) {
+	const int vertex_count = 4000;
+	std::vector<b2Vec2> vertices(vertex_count);
+	for (int i = 0; i < vertex_count; ++i) {
+		const float x = -1000.0f + 0.5f * i;
+		vertices[i].Set(x, 2.0f * std::sin(0.05f * x) + random.Next(-0.2f, 0.2f));
+	}
+
+	b2ChainShape chain;
+	chain.CreateChain(vertices.data(), vertex_count);
+	if (segment_tree) {
+		chain.CreateSegmentTree();
+	}
+	AddBody(world, b2_staticBody, b2Vec2_zero, chain, 0.0f);
+}
+
+// Bodies rolling and sliding over the terrain.
+void CreateChainTerrain(b2World& world) {
+	Random random(2);
+	AddTerrain(world, random, false);
+
+	for (int i = 0; i < 1000; ++i) {
+		b2Vec2 position(-950.0f + 1.9f * i, 5.0f + random.Next(0.0f, 5.0f));
+		AddMixedShape(world, position, 0.25f, i);
+	}
+}
+
+// The terrain as one segment tree chain, with weightless sensor circles sweeping along
+// it. Every sensor overlaps the chain somewhere in its middle, so each step tests the
+// segments under each sensor.
+void CreateChainTreeSensors(b2World& world) {
+	Random random(2);
+	AddTerrain(world, random, true);
+
+	b2CircleShape circle;
+	circle.m_radius = 1.0f;
+	b2FixtureDef fixture_def;
+	fixture_def.shape = &circle;
+	fixture_def.isSensor = true;
+
+	for (int i = 0; i < 500; ++i) {
+		const float x = -950.0f + 3.8f * i;
+		b2BodyDef body_def;
+		body_def.type = b2_dynamicBody;
+		body_def.position.Set(x, 2.0f * std::sin(0.05f * x));
+		body_def.linearVelocity.Set(i % 2 == 0 ? 4.0f : -4.0f, 0.0f);
+		body_def.gravityScale = 0.0f;
+		world.CreateBody(&body_def)->CreateFixture(&fixture_def);
+	}
+}
+
+// 2000 boxes in short columns that fall asleep during warm-up, so the timed steps
+// measure how much a world full of sleeping bodies costs. The columns stand apart so
+// that each one is its own island and can sleep on its own.
+void CreateSleepingPile(b2World& world) {
+	const int columns = 200;
+	const int rows = 10;
+	const float spacing = 1.25f;
+	AddGround(world, 0.5f * spacing * columns + 10.0f);
+
+	b2PolygonShape box;
+	box.SetAsBox(0.5f, 0.5f);
+	for (int i = 0; i < columns; ++i) {
+		for (int row = 0; row < rows; ++row) {
+			b2Vec2 position(spacing * (i - 0.5f * (columns - 1)), 0.5f + row);
+			AddBody(world, b2_dynamicBody, position, box, 1.0f);
+		}
+	}
+}
+
+const BenchmarkScene kScenes[] = {
+	{ "pyramid", CreatePyramid, nullptr, 0 },
+	{ "tumbler", CreateTumbler, UpdateTumbler, 0 },
+	{ "falling_circles", CreateFallingCircles, nullptr, 0 },
+	{ "ragdoll_chains", CreateRagdollChains, nullptr, 0 },
+	{ "chain_terrain", CreateChainTerrain, nullptr, 0 },
+	{ "chain_tree_sensors", CreateChainTreeSensors, nullptr, 0 },
+	{ "sleeping_pile", CreateSleepingPile, nullptr, 300 },
+};
+
+}
+
+const BenchmarkScene* GetBenchmarkScenes(int* count) {
+	*count = int(sizeof(kScenes) / sizeof(kScenes[0]));
+	return kScenes;
+}
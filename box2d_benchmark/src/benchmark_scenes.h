@@ -0,0 +1,24 @@
+// Rachel Crawford 2016
+// This file lives at https://github.com/rachelnertia/Box2D-Raycasting-Test
+
+#ifndef BENCHMARK_SCENES_H_
+#define BENCHMARK_SCENES_H_
+
+class b2World;
+
+// A canonical world to step. Scenes are built the same way every time, without
+// randomness, so results from different builds can be compared.
+struct BenchmarkScene {
+	const char* name;
+	// Fill an empty world.
+	void (*create)(b2World& world);
+	// Called before each step, e.g. to keep adding bodies. May be null.
+	void (*update)(b2World& world, int step);
+	// Steps run after creation and before timing starts, e.g. to let a pile settle.
+	int warmup_steps;
+};
+
+// The scenes in the order they are run.
+const BenchmarkScene* GetBenchmarkScenes(int* count);
+
+#endif//BENCHMARK_SCENES_H_
@@ -0,0 +1,258 @@
+// Rachel Crawford 2016
+// This file lives at https://github.com/rachelnertia/Box2D-Raycasting-Test
+
+// Steps a set of canonical scenes without a window and reports how fast the world
+// stepped, phase by phase, so that solver and broad-phase changes can be measured.
+//
+// Usage: box2d_benchmark [options]
+//   --steps N          timed steps per scene (default 600)
+//   --scene NAME       only run this scene, can be given more than once
+//   --format csv|json  report format (default csv)
+//   --out PATH         write the report to a file instead of stdout
+//   --baseline PATH    compare with the CSV report of an earlier run
+//   --threshold PCT    flag scenes whose steps/sec dropped by more than this (default 5)
+//   --list             print the scene names and exit
+//   --help             print these options and exit
+//
+// Progress and the baseline comparison go to stderr, so stdout only holds the report.
+// The exit code is 2 if any scene was flagged as slower than the baseline.
+
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "Box2D/Box2D.h"
+#include "benchmark_report.h"
+#include "benchmark_scenes.h"
+
+namespace {
+
+const char usage[] =
+	"Usage: box2d_benchmark [options]\n"
+	"  --steps N          timed steps per scene (default 600)\n"
+	"  --scene NAME       only run this scene, can be given more than once\n"
+	"  --format csv|json  report format (default csv)\n"
+	"  --out PATH         write the report to a file instead of stdout\n"
+	"  --baseline PATH    compare with the CSV report of an earlier run\n"
+	"  --threshold PCT    flag scenes whose steps/sec dropped by more than this (default 5)\n"
+	"  --list             print the scene names and exit\n"
+	"  --help             print these options and exit\n";
+
+// The options that are followed by a value.
+const char* const value_options[] = {
+	"--steps", "--scene", "--format", "--out", "--baseline", "--threshold"
+};
+
+bool TakesValue(const char* arg) {
+	for (const char* option : value_options) {
+		if (strcmp(arg, option) == 0) {
+			return true;
+		}
+	}
+	return false;
+}
+
+struct Options {
+	int steps = 600;
+	std::vector<std::string> scenes;
+	bool json = false;
+	std::string out_path;
+	std::string baseline_path;
+	float threshold_percent = 5.0f;
+	bool list = false;
+	bool help = false;
+};
+
+bool ParseOptions(int argc, char** argv, Options& options) {
+	for (int i = 1; i < argc; ++i) {
+		const char* arg = argv[i];
+		const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+		if (strcmp(arg, "--help") == 0) {
+			options.help = true;
+			continue;
+		}
+		if (strcmp(arg, "--list") == 0) {
+			options.list = true;
+			continue;
+		}
+		if (!TakesValue(arg)) {
+			std::cerr << "Unknown option: " << arg << " (see --help)" << std::endl;
+			return false;
+		}
+		if (value == nullptr) {
+			std::cerr << "Missing value for " << arg << std::endl;
+			return false;
+		}
+		++i;
+		if (strcmp(arg, "--steps") == 0) {
+			options.steps = std::atoi(value);
+		}
+		else if (strcmp(arg, "--scene") == 0) {
+			options.scenes.push_back(value);
+		}
+		else if (strcmp(arg, "--format") == 0) {
+			if (strcmp(value, "json") != 0 && strcmp(value, "csv") != 0) {
+				std::cerr << "Unknown format: " << value << std::endl;
+				return false;
+			}
+			options.json = strcmp(value, "json") == 0;
+		}
+		else if (strcmp(arg, "--out") == 0) {
+			options.out_path = value;
+		}
+		else if (strcmp(arg, "--baseline") == 0) {
+			options.baseline_path = value;
+		}
+		else if (strcmp(arg, "--threshold") == 0) {
+			options.threshold_percent = float(std::atof(value));
+		}
+	}
+	if (options.steps <= 0) {
+		std::cerr << "--steps must be positive" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+BenchmarkResult RunScene(const BenchmarkScene& scene, int steps) {
+	const float timestep = 1.0f / 60.0f;
+	const int velocity_iterations = 8;
+	const int position_iterations = 3;
+
+	b2World world(b2Vec2(0.0f, -10.0f));
+	// Peak contacts come and go between steps, so sample every step.
+	world.SetStepMemorySampling(true);
+	scene.create(world);
+
+	int step = 0;
+	for (; step < scene.warmup_steps; ++step) {
+		if (scene.update) {
+			scene.update(world, step);
+		}
+		world.Step(timestep, velocity_iterations, position_iterations);
+	}
+
+	BenchmarkResult result;
+	result.scene = scene.name;
+	result.steps = steps;
+	memset(&result.mean, 0, sizeof(b2Profile));
+	memset(&result.max, 0, sizeof(b2Profile));
+
+	b2Timer timer;
+	for (int i = 0; i < steps; ++i, ++step) {
+		if (scene.update) {
+			scene.update(world, step);
+		}
+		world.Step(timestep, velocity_iterations, position_iterations);
+
+		const b2Profile& profile = world.GetProfile();
+		for (int f = 0; f < kProfileFieldCount; ++f) {
+			float32 b2Profile::*member = kProfileFields[f].member;
+			result.mean.*member += profile.*member;
+			result.max.*member = b2Max(result.max.*member, profile.*member);
+		}
+	}
+	result.total_ms = timer.GetMilliseconds();
+	result.steps_per_sec = result.total_ms > 0.0 ? 1000.0 * steps / result.total_ms : 0.0;
+
+	for (int f = 0; f < kProfileFieldCount; ++f) {
+		result.mean.*kProfileFields[f].member /= steps;
+	}
+
+	// Peaks cover the warm-up too, since that memory is still held.
+	b2MemoryStats memory = world.GetMemoryStats();
+	result.bodies = world.GetBodyCount();
+	result.peak_contacts = memory.peakContactCount;
+	result.peak_bytes = memory.peakTotalBytes;
+	return result;
+}
+
+}
+
+int main(int argc, char** argv) {
+	Options options;
+	if (!ParseOptions(argc, argv, options)) {
+		return 1;
+	}
+
+	if (options.help) {
+		std::cout << usage;
+		return 0;
+	}
+
+	int scene_count = 0;
+	const BenchmarkScene* scenes = GetBenchmarkScenes(&scene_count);
+
+	if (options.list) {
+		for (int i = 0; i < scene_count; ++i) {
+			std::cout << scenes[i].name << std::endl;
+		}
+		return 0;
+	}
+
+	for (const std::string& name : options.scenes) {
+		bool found = false;
+		for (int i = 0; i < scene_count; ++i) {
+			found = found || name == scenes[i].name;
+		}
+		if (!found) {
+			std::cerr << "Unknown scene: " << name << std::endl;
+			return 1;
+		}
+	}
+
+	// Read the baseline first so a bad path doesn't waste a whole run.
+	std::vector<BenchmarkResult> baseline;
+	if (!options.baseline_path.empty()) {
+		std::ifstream baseline_file(options.baseline_path);
+		if (!baseline_file || !ReadCsv(baseline_file, baseline)) {
+			std::cerr << "Couldn't read baseline " << options.baseline_path << std::endl;
+			return 1;
+		}
+	}
+
+	std::vector<BenchmarkResult> results;
+	for (int i = 0; i < scene_count; ++i) {
+		const BenchmarkScene& scene = scenes[i];
+		bool selected = options.scenes.empty();
+		for (const std::string& name : options.scenes) {
+			selected = selected || name == scene.name;
+		}
+		if (!selected) {
+			continue;
+		}
+
+		results.push_back(RunScene(scene, options.steps));
+		const BenchmarkResult& result = results.back();
+		std::cerr << scene.name << ": " << result.steps_per_sec << " steps/sec, " <<
+			result.mean.step << " ms per step" << std::endl;
+	}
+
+	std::ofstream out_file;
+	if (!options.out_path.empty()) {
+		out_file.open(options.out_path);
+		if (!out_file) {
+			std::cerr << "Couldn't write " << options.out_path << std::endl;
+			return 1;
+		}
+	}
+	std::ostream& out = options.out_path.empty() ? std::cout : out_file;
+	if (options.json) {
+		WriteJson(out, results);
+	}
+	else {
+		WriteCsv(out, results);
+	}
+
+	if (!options.baseline_path.empty()) {
+		int regressions = CompareToBaseline(std::cerr, results, baseline, options.threshold_percent);
+		if (regressions > 0) {
+			return 2;
+		}
+	}
+
+	return 0;
+}
@@ -32,7 +32,9 @@ For discussion please visit http://box2d.org/forum
 // These include files constitute the main Box2D API
 
 #include <Box2D/Common/b2Settings.h>
+#include <Box2D/Common/b2Allocator.h>
 #include <Box2D/Common/b2Draw.h>
+#include <Box2D/Common/b2Profiler.h>
 #include <Box2D/Common/b2Timer.h>
 
 #include <Box2D/Collision/Shapes/b2CircleShape.h>
@@ -50,6 +52,8 @@ For discussion please visit http://box2d.org/forum
 #include <Box2D/Dynamics/b2WorldCallbacks.h>
 #include <Box2D/Dynamics/b2TimeStep.h>
 #include <Box2D/Dynamics/b2World.h>
+#include <Box2D/Dynamics/b2QuerySnapshot.h>
+#include <Box2D/Dynamics/b2WorldFile.h>
 
 #include <Box2D/Dynamics/Contacts/b2Contact.h>
 
@@ -31,6 +31,10 @@ void b2ChainShape::Clear()
 	b2Free(m_vertices);
 	m_vertices = NULL;
 	m_count = 0;
+
+	b2Free(m_segmentTree);
+	m_segmentTree = NULL;
+	m_segmentTreeCount = 0;
 }
 
 void b2ChainShape::CreateLoop(const b2Vec2* vertices, int32 count)
@@ -88,6 +92,47 @@ void b2ChainShape::SetNextVertex(const b2Vec2& nextVertex)
 	m_hasNextVertex = true;
 }
 
+void b2ChainShape::CreateSegmentTree()
+{
+	b2Assert(m_vertices != NULL && m_segmentTree == NULL);
+
+	// Halve the segment count until it fits in a leaf to find the tree depth. The
+	// larger half rounds up, so this bounds every path.
+	int32 segmentCount = m_count - 1;
+	int32 depth = 0;
+	for (int32 count = segmentCount; count > b2_segmentTreeLeafSize; count = count - count / 2)
+	{
+		++depth;
+	}
+
+	m_segmentTreeCount = (1 << (depth + 1)) - 1;
+	m_segmentTree = (b2AABB*)b2Alloc(m_segmentTreeCount * sizeof(b2AABB));
+	BuildSegmentTree(0, 0, segmentCount);
+}
+
+void b2ChainShape::BuildSegmentTree(int32 node, int32 first, int32 count)
+{
+	b2Assert(node < m_segmentTreeCount);
+	b2AABB* aabb = m_segmentTree + node;
+
+	if (count <= b2_segmentTreeLeafSize)
+	{
+		aabb->lowerBound = m_vertices[first];
+		aabb->upperBound = m_vertices[first];
+		for (int32 i = first + 1; i <= first + count; ++i)
+		{
+			aabb->lowerBound = b2Min(aabb->lowerBound, m_vertices[i]);
+			aabb->upperBound = b2Max(aabb->upperBound, m_vertices[i]);
+		}
+		return;
+	}
+
+	int32 count1 = count / 2;
+	BuildSegmentTree(2 * node + 1, first, count1);
+	BuildSegmentTree(2 * node + 2, first + count1, count - count1);
+	aabb->Combine(m_segmentTree[2 * node + 1], m_segmentTree[2 * node + 2]);
+}
+
 b2Shape* b2ChainShape::Clone(b2BlockAllocator* allocator) const
 {
 	void* mem = allocator->Allocate(sizeof(b2ChainShape));
@@ -97,11 +142,23 @@ b2Shape* b2ChainShape::Clone(b2BlockAllocator* allocator) const
 	clone->m_nextVertex = m_nextVertex;
 	clone->m_hasPrevVertex = m_hasPrevVertex;
 	clone->m_hasNextVertex = m_hasNextVertex;
+	if (m_segmentTree)
+	{
+		clone->m_segmentTreeCount = m_segmentTreeCount;
+		clone->m_segmentTree = (b2AABB*)b2Alloc(m_segmentTreeCount * sizeof(b2AABB));
+		memcpy(clone->m_segmentTree, m_segmentTree, m_segmentTreeCount * sizeof(b2AABB));
+	}
 	return clone;
 }
 
 int32 b2ChainShape::GetChildCount() const
 {
+	// A segment tree covers all the edges with one child.
+	if (m_segmentTree)
+	{
+		return 1;
+	}
+
 	// edge count = vertex count - 1
 	return m_count - 1;
 }
@@ -150,6 +207,11 @@ bool b2ChainShape::RayCast(b2RayCastOutput* output, const b2RayCastInput& input,
 {
 	b2Assert(childIndex < m_count);
 
+	if (m_segmentTree)
+	{
+		return RayCastSegments(output, input, xf, false);
+	}
+
 	b2EdgeShape edgeShape;
 
 	int32 i1 = childIndex;
@@ -165,10 +227,172 @@ bool b2ChainShape::RayCast(b2RayCastOutput* output, const b2RayCastInput& input,
 	return edgeShape.RayCast(output, input, xf, 0);
 }
 
+bool b2ChainShape::TestSegment(const b2RayCastInput& input,
+							const b2Transform& xf, int32 childIndex) const
+{
+	b2Assert(childIndex < m_count);
+
+	if (m_segmentTree)
+	{
+		b2RayCastOutput output;
+		return RayCastSegments(&output, input, xf, true);
+	}
+
+	b2EdgeShape edgeShape;
+
+	int32 i1 = childIndex;
+	int32 i2 = childIndex + 1;
+	if (i2 == m_count)
+	{
+		i2 = 0;
+	}
+
+	edgeShape.m_vertex1 = m_vertices[i1];
+	edgeShape.m_vertex2 = m_vertices[i2];
+
+	return edgeShape.TestSegment(input, xf, 0);
+}
+
+// Does the ray p + t * d, 0 <= t <= maxFraction, touch the box? Slab test.
+static bool b2RayTouchesAABB(const b2AABB& aabb, const b2Vec2& p, const b2Vec2& d, float32 maxFraction)
+{
+	float32 tmin = 0.0f;
+	float32 tmax = maxFraction;
+
+	for (int32 i = 0; i < 2; ++i)
+	{
+		if (b2Abs(d(i)) < b2_epsilon)
+		{
+			// Parallel to the slab.
+			if (p(i) < aabb.lowerBound(i) || aabb.upperBound(i) < p(i))
+			{
+				return false;
+			}
+		}
+		else
+		{
+			float32 inv_d = 1.0f / d(i);
+			float32 t1 = (aabb.lowerBound(i) - p(i)) * inv_d;
+			float32 t2 = (aabb.upperBound(i) - p(i)) * inv_d;
+			if (t1 > t2)
+			{
+				b2Swap(t1, t2);
+			}
+
+			tmin = b2Max(tmin, t1);
+			tmax = b2Min(tmax, t2);
+			if (tmin > tmax)
+			{
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+// Ray cast the segments in the tree, in the chain's frame. Finds the closest hit, or
+// any hit if anyHit is set.
+bool b2ChainShape::RayCastSegments(b2RayCastOutput* output, const b2RayCastInput& input,
+								   const b2Transform& xf, bool anyHit) const
+{
+	b2RayCastInput localInput;
+	localInput.p1 = b2MulT(xf.q, input.p1 - xf.p);
+	localInput.p2 = b2MulT(xf.q, input.p2 - xf.p);
+	localInput.maxFraction = input.maxFraction;
+	b2Vec2 d = localInput.p2 - localInput.p1;
+
+	b2Transform identity;
+	identity.SetIdentity();
+
+	b2EdgeShape edgeShape;
+	bool hit = false;
+
+	b2SegmentTreeRange stack[32];
+	int32 stackCount = 0;
+
+	b2SegmentTreeRange root;
+	root.node = 0;
+	root.first = 0;
+	root.count = m_count - 1;
+	stack[stackCount++] = root;
+
+	while (stackCount > 0)
+	{
+		b2SegmentTreeRange range = stack[--stackCount];
+		if (b2RayTouchesAABB(m_segmentTree[range.node], localInput.p1, d, localInput.maxFraction) == false)
+		{
+			continue;
+		}
+
+		if (range.count <= b2_segmentTreeLeafSize)
+		{
+			for (int32 i = range.first; i < range.first + range.count; ++i)
+			{
+				edgeShape.m_vertex1 = m_vertices[i];
+				edgeShape.m_vertex2 = m_vertices[i + 1];
+
+				if (anyHit)
+				{
+					if (edgeShape.TestSegment(localInput, identity, 0))
+					{
+						return true;
+					}
+					continue;
+				}
+
+				b2RayCastOutput edgeOutput;
+				if (edgeShape.RayCast(&edgeOutput, localInput, identity, 0))
+				{
+					// Only closer hits are accepted from now on.
+					localInput.maxFraction = edgeOutput.fraction;
+					output->fraction = edgeOutput.fraction;
+					output->normal = edgeOutput.normal;
+					hit = true;
+				}
+			}
+			continue;
+		}
+
+		b2SegmentTreeRange child1;
+		child1.node = 2 * range.node + 1;
+		child1.first = range.first;
+		child1.count = range.count / 2;
+
+		b2SegmentTreeRange child2;
+		child2.node = 2 * range.node + 2;
+		child2.first = range.first + child1.count;
+		child2.count = range.count - child1.count;
+
+		b2Assert(stackCount + 2 <= 32);
+		stack[stackCount++] = child1;
+		stack[stackCount++] = child2;
+	}
+
+	if (hit)
+	{
+		output->normal = b2Mul(xf.q, output->normal);
+	}
+	return hit;
+}
+
 void b2ChainShape::ComputeAABB(b2AABB* aabb, const b2Transform& xf, int32 childIndex) const
 {
 	b2Assert(childIndex < m_count);
 
+	if (m_segmentTree)
+	{
+		// Bound the corners of the root box. This is exact for unrotated chains.
+		const b2AABB& root = m_segmentTree[0];
+		b2Vec2 v1 = b2Mul(xf, root.lowerBound);
+		b2Vec2 v2 = b2Mul(xf, b2Vec2(root.upperBound.x, root.lowerBound.y));
+		b2Vec2 v3 = b2Mul(xf, root.upperBound);
+		b2Vec2 v4 = b2Mul(xf, b2Vec2(root.lowerBound.x, root.upperBound.y));
+		aabb->lowerBound = b2Min(b2Min(v1, v2), b2Min(v3, v4));
+		aabb->upperBound = b2Max(b2Max(v1, v2), b2Max(v3, v4));
+		return;
+	}
+
 	int32 i1 = childIndex;
 	int32 i2 = childIndex + 1;
 	if (i2 == m_count)
@@ -23,12 +23,27 @@
 
 class b2EdgeShape;
 
+/// Chains with a segment tree keep up to this many segments in each leaf.
+#define b2_segmentTreeLeafSize 4
+
+/// A node of a segment tree together with the range of segments it covers.
+struct b2SegmentTreeRange
+{
+	int32 node;
+	int32 first;
+	int32 count;
+};
+
 /// A chain shape is a free form sequence of line segments.
 /// The chain has two-sided collision, so you can use inside and outside collision.
 /// Therefore, you may use any winding order.
 /// Since there may be many vertices, they are allocated using b2Alloc.
 /// Connectivity information is used to create smooth collisions.
 /// WARNING: The chain will not collide properly if there are self-intersections.
+///
+/// By default every segment is a child with its own broad-phase proxy. A chain with a
+/// segment tree is instead a single child covering all of its segments, and ray casts
+/// and contacts find the segments they need in the tree.
 class b2ChainShape : public b2Shape
 {
 public:
@@ -58,6 +73,23 @@ public:
 	/// Don't call this for loops.
 	void SetNextVertex(const b2Vec2& nextVertex);
 
+	/// Build a tree over the segments so the whole chain is a single child with a single
+	/// broad-phase proxy. This keeps long outlines from bloating the broad-phase and
+	/// resolves ray casts against the chain in one pass. Call this after CreateLoop or
+	/// CreateChain and before creating a fixture with the chain.
+	/// Contacts with such a chain only use the most penetrating segment, so it suits
+	/// outlines that bodies slide along better than pockets that bodies rest in.
+	void CreateSegmentTree();
+
+	/// Does this chain have a segment tree?
+	bool HasSegmentTree() const;
+
+	/// Query the segment tree for segments whose bounds overlap the provided AABB,
+	/// given in the chain's frame. The callback class implements
+	/// bool QuerySegment(int32 index) and returns false to stop the query.
+	template <typename T>
+	void QuerySegments(T* callback, const b2AABB& aabb) const;
+
 	/// Implement b2Shape. Vertices are cloned using b2Alloc.
 	b2Shape* Clone(b2BlockAllocator* allocator) const;
 
@@ -75,6 +107,10 @@ public:
 	bool RayCast(b2RayCastOutput* output, const b2RayCastInput& input,
 					const b2Transform& transform, int32 childIndex) const;
 
+	/// @see b2Shape::TestSegment
+	bool TestSegment(const b2RayCastInput& input,
+				const b2Transform& transform, int32 childIndex) const;
+
 	/// @see b2Shape::ComputeAABB
 	void ComputeAABB(b2AABB* aabb, const b2Transform& transform, int32 childIndex) const;
 
@@ -90,6 +126,18 @@ public:
 
 	b2Vec2 m_prevVertex, m_nextVertex;
 	bool m_hasPrevVertex, m_hasNextVertex;
+
+	/// The segment tree bounds, or NULL. Owned by this class. The tree is implicit:
+	/// the children of node i are 2i+1 and 2i+2, and each child covers one half of
+	/// its parent's segments, so only the bounds are stored.
+	b2AABB* m_segmentTree;
+	int32 m_segmentTreeCount;
+
+private:
+
+	void BuildSegmentTree(int32 node, int32 first, int32 count);
+	bool RayCastSegments(b2RayCastOutput* output, const b2RayCastInput& input,
+						 const b2Transform& transform, bool anyHit) const;
 };
 
 inline b2ChainShape::b2ChainShape()
@@ -100,6 +148,73 @@ inline b2ChainShape::b2ChainShape()
 	m_count = 0;
 	m_hasPrevVertex = false;
 	m_hasNextVertex = false;
+	m_segmentTree = NULL;
+	m_segmentTreeCount = 0;
+}
+
+inline bool b2ChainShape::HasSegmentTree() const
+{
+	return m_segmentTree != NULL;
+}
+
+template <typename T>
+inline void b2ChainShape::QuerySegments(T* callback, const b2AABB& aabb) const
+{
+	b2Assert(m_segmentTree != NULL);
+
+	// Each level halves the segment count, so the stack never gets deep.
+	b2SegmentTreeRange stack[32];
+	int32 stackCount = 0;
+
+	b2SegmentTreeRange root;
+	root.node = 0;
+	root.first = 0;
+	root.count = m_count - 1;
+	stack[stackCount++] = root;
+
+	while (stackCount > 0)
+	{
+		b2SegmentTreeRange range = stack[--stackCount];
+		if (b2TestOverlap(m_segmentTree[range.node], aabb) == false)
+		{
+			continue;
+		}
+
+		if (range.count <= b2_segmentTreeLeafSize)
+		{
+			for (int32 i = range.first; i < range.first + range.count; ++i)
+			{
+				b2AABB segment;
+				segment.lowerBound = b2Min(m_vertices[i], m_vertices[i + 1]);
+				segment.upperBound = b2Max(m_vertices[i], m_vertices[i + 1]);
+				if (b2TestOverlap(segment, aabb) == false)
+				{
+					continue;
+				}
+
+				bool proceed = callback->QuerySegment(i);
+				if (proceed == false)
+				{
+					return;
+				}
+			}
+			continue;
+		}
+
+		b2SegmentTreeRange child1;
+		child1.node = 2 * range.node + 1;
+		child1.first = range.first;
+		child1.count = range.count / 2;
+
+		b2SegmentTreeRange child2;
+		child2.node = 2 * range.node + 2;
+		child2.first = range.first + child1.count;
+		child2.count = range.count - child1.count;
+
+		b2Assert(stackCount + 2 <= 32);
+		stack[stackCount++] = child1;
+		stack[stackCount++] = child2;
+	}
 }
 
 #endif
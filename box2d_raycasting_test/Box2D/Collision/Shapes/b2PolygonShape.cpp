@@ -336,6 +336,57 @@ bool b2PolygonShape::RayCast(b2RayCastOutput* output, const b2RayCastInput& inpu
 	return false;
 }
 
+bool b2PolygonShape::TestSegment(const b2RayCastInput& input,
+								const b2Transform& xf, int32 childIndex) const
+{
+	B2_NOT_USED(childIndex);
+
+	// Put the ray into the polygon's frame of reference.
+	b2Vec2 p1 = b2MulT(xf.q, input.p1 - xf.p);
+	b2Vec2 p2 = b2MulT(xf.q, input.p2 - xf.p);
+	b2Vec2 d = p2 - p1;
+
+	float32 lower = 0.0f, upper = input.maxFraction;
+
+	// Like RayCast, only segments entering the polygon count as hits.
+	bool enters = false;
+
+	for (int32 i = 0; i < m_count; ++i)
+	{
+		float32 numerator = b2Dot(m_normals[i], m_vertices[i] - p1);
+		float32 denominator = b2Dot(m_normals[i], d);
+
+		if (denominator == 0.0f)
+		{	
+			if (numerator < 0.0f)
+			{
+				return false;
+			}
+		}
+		else
+		{
+			if (denominator < 0.0f && numerator < lower * denominator)
+			{
+				// The segment enters this half-space.
+				lower = numerator / denominator;
+				enters = true;
+			}
+			else if (denominator > 0.0f && numerator < upper * denominator)
+			{
+				// The segment exits this half-space.
+				upper = numerator / denominator;
+			}
+		}
+
+		if (upper < lower)
+		{
+			return false;
+		}
+	}
+
+	return enters;
+}
+
 void b2PolygonShape::ComputeAABB(b2AABB* aabb, const b2Transform& xf, int32 childIndex) const
 {
 	B2_NOT_USED(childIndex);
@@ -62,6 +62,10 @@ public:
 	bool RayCast(b2RayCastOutput* output, const b2RayCastInput& input,
 					const b2Transform& transform, int32 childIndex) const;
 
+	/// @see b2Shape::TestSegment
+	bool TestSegment(const b2RayCastInput& input,
+				const b2Transform& transform, int32 childIndex) const;
+
 	/// @see b2Shape::ComputeAABB
 	void ComputeAABB(b2AABB* aabb, const b2Transform& transform, int32 childIndex) const;
 
@@ -77,6 +77,14 @@ public:
 	virtual bool RayCast(b2RayCastOutput* output, const b2RayCastInput& input,
 						const b2Transform& transform, int32 childIndex) const = 0;
 
+	/// Test if a segment hits a child shape. This gives the same answer as RayCast
+	/// but skips computing the hit fraction and normal.
+	/// @param input the segment, from p1 to p1 + maxFraction * (p2 - p1).
+	/// @param transform the transform to be applied to the shape.
+	/// @param childIndex the child shape index
+	virtual bool TestSegment(const b2RayCastInput& input,
+						const b2Transform& transform, int32 childIndex) const = 0;
+
 	/// Given a transform, compute the associated axis aligned bounding box for a child shape.
 	/// @param aabb returns the axis aligned box.
 	/// @param xf the world transform of the shape.
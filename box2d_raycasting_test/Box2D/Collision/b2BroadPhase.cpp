@@ -18,45 +18,176 @@
 
 #include <Box2D/Collision/b2BroadPhase.h>
 
-b2BroadPhase::b2BroadPhase()
+b2BroadPhase::b2BroadPhase(const b2Allocator& allocator)
+	: m_allocator(allocator)
+	, m_tree(allocator)
+	, m_staticTree(allocator)
+	, m_compressedTree(allocator)
 {
 	m_proxyCount = 0;
 
 	m_pairCapacity = 16;
 	m_pairCount = 0;
-	m_pairBuffer = (b2Pair*)b2Alloc(m_pairCapacity * sizeof(b2Pair));
+	m_pairBuffer = (b2Pair*)m_allocator.Allocate(m_pairCapacity * sizeof(b2Pair), b2_broadPhaseMemory);
 
 	m_moveCapacity = 16;
 	m_moveCount = 0;
-	m_moveBuffer = (int32*)b2Alloc(m_moveCapacity * sizeof(int32));
+	m_moveBuffer = (int32*)m_allocator.Allocate(m_moveCapacity * sizeof(int32), b2_broadPhaseMemory);
+
+	m_queryTree = e_dynamicTree;
+
+	m_compressStaticTree = false;
+
+	m_adaptiveMargins = false;
+	m_proxySpeedCapacity = 16;
+	m_proxySpeeds = (float32*)m_allocator.Allocate(m_proxySpeedCapacity * sizeof(float32), b2_broadPhaseMemory);
+
+	ResetMoveStats();
 }
 
 b2BroadPhase::~b2BroadPhase()
 {
-	b2Free(m_moveBuffer);
-	b2Free(m_pairBuffer);
+	m_allocator.Free(m_moveBuffer, m_moveCapacity * sizeof(int32), b2_broadPhaseMemory);
+	m_allocator.Free(m_pairBuffer, m_pairCapacity * sizeof(b2Pair), b2_broadPhaseMemory);
+	m_allocator.Free(m_proxySpeeds, m_proxySpeedCapacity * sizeof(float32), b2_broadPhaseMemory);
 }
 
-int32 b2BroadPhase::CreateProxy(const b2AABB& aabb, void* userData)
+void b2BroadPhase::Clear()
 {
-	int32 proxyId = m_tree.CreateProxy(aabb, userData);
+	m_tree.Clear();
+	m_staticTree.Clear();
+	m_proxyCount = 0;
+	m_moveCount = 0;
+	m_pairCount = 0;
+	UpdateCompressedTree();
+}
+
+int32 b2BroadPhase::CreateProxy(const b2AABB& aabb, void* userData, bool isStatic, uint16 categoryBits)
+{
+	b2DynamicTree& tree = isStatic ? m_staticTree : m_tree;
+	int32 nodeId = tree.CreateProxy(aabb, userData, categoryBits);
+	int32 proxyId = GetProxyId(nodeId, isStatic ? e_staticTree : e_dynamicTree);
 	++m_proxyCount;
 	BufferMove(proxyId);
+
+	ReserveProxySpeeds(proxyId);
+	m_proxySpeeds[proxyId] = 0.0f;
+
 	return proxyId;
 }
 
+// Buffers the dynamic proxies that overlap a batch of new static proxies.
+struct b2StaticBatchCallback
+{
+	bool QueryCallback(int32 nodeId)
+	{
+		broadPhase->BufferMove(b2BroadPhase::GetProxyId(nodeId, b2BroadPhase::e_dynamicTree));
+		return true;
+	}
+
+	b2BroadPhase* broadPhase;
+};
+
+void b2BroadPhase::CreateStaticProxies(const b2AABB* aabbs, void* const* userData, const uint16* categoryBits,
+									   int32 count, int32* proxyIds)
+{
+	if (count == 0)
+	{
+		return;
+	}
+
+	m_staticTree.CreateProxies(aabbs, userData, categoryBits, count, proxyIds);
+	m_proxyCount += count;
+
+	b2AABB bounds = aabbs[0];
+	for (int32 i = 0; i < count; ++i)
+	{
+		proxyIds[i] = GetProxyId(proxyIds[i], e_staticTree);
+		ReserveProxySpeeds(proxyIds[i]);
+		m_proxySpeeds[proxyIds[i]] = 0.0f;
+		bounds.Combine(aabbs[i]);
+	}
+
+	// Static proxies only pair with dynamic proxies, so re-query the few dynamic
+	// proxies near the batch rather than every new static proxy.
+	b2StaticBatchCallback callback;
+	callback.broadPhase = this;
+	m_tree.Query(&callback, bounds);
+
+	UpdateCompressedTree();
+}
+
+void b2BroadPhase::SetStaticTreeCompression(bool flag)
+{
+	m_compressStaticTree = flag;
+	if (flag)
+	{
+		m_compressedTree.Build(&m_staticTree);
+	}
+	else
+	{
+		m_compressedTree.Clear();
+	}
+}
+
+void b2BroadPhase::UpdateCompressedTree()
+{
+	if (m_compressStaticTree && m_compressedTree.GetModifyCount() != m_staticTree.GetModifyCount())
+	{
+		m_compressedTree.Build(&m_staticTree);
+	}
+}
+
+// Grow the speed history as needed.
+void b2BroadPhase::ReserveProxySpeeds(int32 proxyId)
+{
+	if (proxyId < m_proxySpeedCapacity)
+	{
+		return;
+	}
+
+	float32* oldSpeeds = m_proxySpeeds;
+	int32 oldCapacity = m_proxySpeedCapacity;
+	while (m_proxySpeedCapacity <= proxyId)
+	{
+		m_proxySpeedCapacity *= 2;
+	}
+	m_proxySpeeds = (float32*)m_allocator.Allocate(m_proxySpeedCapacity * sizeof(float32), b2_broadPhaseMemory);
+	memcpy(m_proxySpeeds, oldSpeeds, oldCapacity * sizeof(float32));
+	m_allocator.Free(oldSpeeds, oldCapacity * sizeof(float32), b2_broadPhaseMemory);
+}
+
 void b2BroadPhase::DestroyProxy(int32 proxyId)
 {
 	UnBufferMove(proxyId);
 	--m_proxyCount;
-	m_tree.DestroyProxy(proxyId);
+	GetTree(proxyId).DestroyProxy(GetNodeId(proxyId));
 }
 
 void b2BroadPhase::MoveProxy(int32 proxyId, const b2AABB& aabb, const b2Vec2& displacement)
 {
-	bool buffer = m_tree.MoveProxy(proxyId, aabb, displacement);
+	++m_moveStats.moveCount;
+
+	b2DynamicTree& tree = GetTree(proxyId);
+	int32 nodeId = GetNodeId(proxyId);
+
+	bool buffer;
+	if (m_adaptiveMargins)
+	{
+		// Size the margin from the proxy's displacement history.
+		float32 speed = b2_aabbMarginSmoothing * m_proxySpeeds[proxyId] + (1.0f - b2_aabbMarginSmoothing) * displacement.Length();
+		m_proxySpeeds[proxyId] = speed;
+		float32 margin = b2Clamp(b2_aabbMarginScale * speed, b2_minAABBMargin, b2_maxAABBMargin);
+		buffer = tree.MoveProxy(nodeId, aabb, displacement, margin);
+	}
+	else
+	{
+		buffer = tree.MoveProxy(nodeId, aabb, displacement);
+	}
+
 	if (buffer)
 	{
+		++m_moveStats.reinsertCount;
 		BufferMove(proxyId);
 	}
 }
@@ -71,10 +202,11 @@ void b2BroadPhase::BufferMove(int32 proxyId)
 	if (m_moveCount == m_moveCapacity)
 	{
 		int32* oldBuffer = m_moveBuffer;
+		int32 oldCapacity = m_moveCapacity;
 		m_moveCapacity *= 2;
-		m_moveBuffer = (int32*)b2Alloc(m_moveCapacity * sizeof(int32));
+		m_moveBuffer = (int32*)m_allocator.Allocate(m_moveCapacity * sizeof(int32), b2_broadPhaseMemory);
 		memcpy(m_moveBuffer, oldBuffer, m_moveCount * sizeof(int32));
-		b2Free(oldBuffer);
+		m_allocator.Free(oldBuffer, oldCapacity * sizeof(int32), b2_broadPhaseMemory);
 	}
 
 	m_moveBuffer[m_moveCount] = proxyId;
@@ -93,8 +225,10 @@ void b2BroadPhase::UnBufferMove(int32 proxyId)
 }
 
 // This is called from b2DynamicTree::Query when we are gathering pairs.
-bool b2BroadPhase::QueryCallback(int32 proxyId)
+bool b2BroadPhase::QueryCallback(int32 nodeId)
 {
+	int32 proxyId = GetProxyId(nodeId, m_queryTree);
+
 	// A proxy cannot form a pair with itself.
 	if (proxyId == m_queryProxyId)
 	{
@@ -105,10 +239,11 @@ bool b2BroadPhase::QueryCallback(int32 proxyId)
 	if (m_pairCount == m_pairCapacity)
 	{
 		b2Pair* oldBuffer = m_pairBuffer;
+		int32 oldCapacity = m_pairCapacity;
 		m_pairCapacity *= 2;
-		m_pairBuffer = (b2Pair*)b2Alloc(m_pairCapacity * sizeof(b2Pair));
+		m_pairBuffer = (b2Pair*)m_allocator.Allocate(m_pairCapacity * sizeof(b2Pair), b2_broadPhaseMemory);
 		memcpy(m_pairBuffer, oldBuffer, m_pairCount * sizeof(b2Pair));
-		b2Free(oldBuffer);
+		m_allocator.Free(oldBuffer, oldCapacity * sizeof(b2Pair), b2_broadPhaseMemory);
 	}
 
 	m_pairBuffer[m_pairCount].proxyIdA = b2Min(proxyId, m_queryProxyId);
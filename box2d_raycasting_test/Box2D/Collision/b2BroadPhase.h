@@ -21,7 +21,9 @@
 
 #include <Box2D/Common/b2Settings.h>
 #include <Box2D/Collision/b2Collision.h>
+#include <Box2D/Collision/b2CompressedTree.h>
 #include <Box2D/Collision/b2DynamicTree.h>
+#include <Box2D/Common/b2Profiler.h>
 #include <algorithm>
 
 struct b2Pair
@@ -30,9 +32,19 @@ struct b2Pair
 	int32 proxyIdB;
 };
 
+/// Proxy movement counters. The re-insertion rate is reinsertCount / moveCount.
+struct b2ProxyMoveStats
+{
+	int32 moveCount;		///< calls to MoveProxy
+	int32 reinsertCount;	///< moves that left the fat AABB and updated the tree
+};
+
 /// The broad-phase is used for computing pairs and performing volume queries and ray casts.
 /// This broad-phase does not persist pairs. Instead, this reports potentially new pairs.
 /// It is up to the client to consume the new pairs and to track subsequent overlap.
+/// Static proxies live in their own tree. Static proxies never pair with each other,
+/// so pair finding never has to descend into the static tree for them, and the static
+/// tree keeps its quality while the dynamic tree churns.
 class b2BroadPhase
 {
 public:
@@ -42,12 +54,29 @@ public:
 		e_nullProxy = -1
 	};
 
-	b2BroadPhase();
+	/// The tree a proxy lives in is stored in the low bit of its id.
+	enum
+	{
+		e_dynamicTree = 0,
+		e_staticTree = 1
+	};
+
+	/// The trees and the move, pair and proxy speed buffers use the allocator.
+	explicit b2BroadPhase(const b2Allocator& allocator = b2Allocator());
 	~b2BroadPhase();
 
 	/// Create a proxy with an initial AABB. Pairs are not reported until
-	/// UpdatePairs is called.
-	int32 CreateProxy(const b2AABB& aabb, void* userData);
+	/// UpdatePairs is called. Static proxies are put in the static tree.
+	/// The category bits are used to prune masked queries and ray casts.
+	int32 CreateProxy(const b2AABB& aabb, void* userData, bool isStatic, uint16 categoryBits);
+
+	/// Create many static proxies at once. They are built into a sub-tree of the static
+	/// tree in one top-down pass and are not added to the move buffer, since pairs
+	/// between static proxies are never reported. Dynamic proxies that overlap the new
+	/// proxies are buffered instead, so their pairs are found by the next UpdatePairs.
+	/// @param proxyIds receives the new proxy ids, in the order of the inputs.
+	void CreateStaticProxies(const b2AABB* aabbs, void* const* userData, const uint16* categoryBits,
+							 int32 count, int32* proxyIds);
 
 	/// Destroy a proxy. It is up to the client to remove any pairs.
 	void DestroyProxy(int32 proxyId);
@@ -59,6 +88,21 @@ public:
 	/// Call to trigger a re-processing of it's pairs on the next call to UpdatePairs.
 	void TouchProxy(int32 proxyId);
 
+	/// Change the category bits of a proxy.
+	void SetCategoryBits(int32 proxyId, uint16 categoryBits);
+
+	/// Enable/disable adaptive margins. When enabled each proxy's fat AABB margin
+	/// follows its smoothed displacement, so fast proxies get room to move and slow
+	/// proxies get tight boxes. Otherwise b2_aabbExtension is used for every proxy.
+	void SetAdaptiveMargins(bool flag);
+	bool GetAdaptiveMargins() const;
+
+	/// Get the proxy movement counters.
+	const b2ProxyMoveStats& GetMoveStats() const;
+
+	/// Reset the proxy movement counters.
+	void ResetMoveStats();
+
 	/// Get the fat AABB for a proxy.
 	const b2AABB& GetFatAABB(int32 proxyId) const;
 
@@ -71,6 +115,9 @@ public:
 	/// Get the number of proxies.
 	int32 GetProxyCount() const;
 
+	/// Is this proxy in the static tree?
+	bool IsStaticProxy(int32 proxyId) const;
+
 	/// Update the pairs. This results in pair callbacks. This can only add pairs.
 	template <typename T>
 	void UpdatePairs(T* callback);
@@ -80,6 +127,10 @@ public:
 	template <typename T>
 	void Query(T* callback, const b2AABB& aabb) const;
 
+	/// Query an AABB for overlapping proxies whose category bits match the mask.
+	template <typename T>
+	void Query(T* callback, const b2AABB& aabb, uint16 maskBits) const;
+
 	/// Ray-cast against the proxies in the tree. This relies on the callback
 	/// to perform a exact ray-cast in the case were the proxy contains a shape.
 	/// The callback also performs the any collision filtering. This has performance
@@ -87,18 +138,55 @@ public:
 	/// number of proxies in the tree.
 	/// @param input the ray-cast input data. The ray extends from p1 to p1 + maxFraction * (p2 - p1).
 	/// @param callback a callback class that is called for each proxy that is hit by the ray.
+	/// @return how many nodes and leaves the ray visited in both trees.
+	template <typename T>
+	b2TreeStats RayCast(T* callback, const b2RayCastInput& input) const;
+
+	/// Ray-cast against the proxies whose category bits match the mask.
+	/// @param nodeCallback optionally told about every node the ray visits.
 	template <typename T>
-	void RayCast(T* callback, const b2RayCastInput& input) const;
+	b2TreeStats RayCast(T* callback, const b2RayCastInput& input, uint16 maskBits,
+						b2TreeNodeCallback* nodeCallback = NULL) const;
 
-	/// Get the height of the embedded tree.
+	/// Get the height of the taller embedded tree.
 	int32 GetTreeHeight() const;
 
-	/// Get the balance of the embedded tree.
+	/// Get the worse balance of the embedded trees.
 	int32 GetTreeBalance() const;
 
-	/// Get the quality metric of the embedded tree.
+	/// Get the worse quality metric of the embedded trees.
 	float32 GetTreeQuality() const;
 
+	/// Enable/disable refit mode on the dynamic tree. See b2DynamicTree::SetRefitEnabled.
+	void SetTreeRefitEnabled(bool flag);
+	bool IsTreeRefitEnabled() const;
+
+	/// Set the refit rebuild ratio of the dynamic tree.
+	void SetTreeRebuildRatio(float32 ratio);
+
+	/// Rebuild the static tree top-down. Call this after creating static geometry.
+	void RebuildStaticTree();
+
+	/// Destroy every proxy at once. The buffers and tree node pools are kept.
+	void Clear();
+
+	/// Enable/disable a compressed copy of the static tree. While enabled, queries and
+	/// ray casts traverse the copy, which is a fraction of the size. The copy is rebuilt
+	/// by UpdatePairs when the static tree has changed and the full tree is used until
+	/// then, so this suits static trees that rarely change.
+	void SetStaticTreeCompression(bool flag);
+	bool GetStaticTreeCompression() const;
+
+	/// Get the size of the compressed static tree in bytes, or 0 if it isn't enabled.
+	int32 GetCompressedTreeByteCount() const;
+
+	/// Enable/disable change tracking on both trees. See b2DynamicTree::SetChangeTracking.
+	void SetTreeChangeTracking(bool flag);
+
+	/// Start a new change generation in both trees, dropping the changes every copy has seen.
+	/// @param oldestGenerations the oldest generation still needed, indexed by tree.
+	void AdvanceTreeGenerations(const uint32 oldestGenerations[2]);
+
 	/// Shift the world origin. Useful for large worlds.
 	/// The shift formula is: position -= newOrigin
 	/// @param newOrigin the new origin with respect to the old origin
@@ -107,16 +195,43 @@ public:
 private:
 
 	friend class b2DynamicTree;
+	friend class b2World;
+	friend class b2QuerySnapshot;
+	friend struct b2StaticBatchCallback;
+	template <typename T> friend struct b2BroadPhaseQueryWrapper;
+	template <typename T> friend struct b2BroadPhaseRayCastWrapper;
 
 	void BufferMove(int32 proxyId);
 	void UnBufferMove(int32 proxyId);
+	void ReserveProxySpeeds(int32 proxyId);
+	void UpdateCompressedTree();
+	bool IsCompressedTreeCurrent() const;
+
+	bool QueryCallback(int32 nodeId);
+
+	static int32 GetProxyId(int32 nodeId, int32 tree);
+	static int32 GetNodeId(int32 proxyId);
+	const b2DynamicTree& GetTree(int32 proxyId) const;
+	b2DynamicTree& GetTree(int32 proxyId);
 
-	bool QueryCallback(int32 proxyId);
+	b2Allocator m_allocator;
 
 	b2DynamicTree m_tree;
+	b2DynamicTree m_staticTree;
+
+	bool m_compressStaticTree;
+	b2CompressedTree m_compressedTree;
 
 	int32 m_proxyCount;
 
+	bool m_adaptiveMargins;
+
+	// Smoothed per-step displacement length, indexed by proxy id.
+	float32* m_proxySpeeds;
+	int32 m_proxySpeedCapacity;
+
+	b2ProxyMoveStats m_moveStats;
+
 	int32* m_moveBuffer;
 	int32 m_moveCapacity;
 	int32 m_moveCount;
@@ -126,6 +241,47 @@ private:
 	int32 m_pairCount;
 
 	int32 m_queryProxyId;
+	int32 m_queryTree;
+};
+
+/// This translates tree node ids to proxy ids for client query callbacks.
+template <typename T>
+struct b2BroadPhaseQueryWrapper
+{
+	bool QueryCallback(int32 nodeId)
+	{
+		proceed = callback->QueryCallback(b2BroadPhase::GetProxyId(nodeId, tree));
+		return proceed;
+	}
+
+	T* callback;
+	int32 tree;
+	bool proceed;
+};
+
+/// This translates tree node ids to proxy ids for client ray-cast callbacks
+/// and tracks the clipped ray so it can be carried over to the next tree.
+template <typename T>
+struct b2BroadPhaseRayCastWrapper
+{
+	float32 RayCastCallback(const b2RayCastInput& input, int32 nodeId)
+	{
+		float32 value = callback->RayCastCallback(input, b2BroadPhase::GetProxyId(nodeId, tree));
+		if (value == 0.0f)
+		{
+			terminated = true;
+		}
+		else if (value > 0.0f)
+		{
+			maxFraction = value;
+		}
+		return value;
+	}
+
+	T* callback;
+	int32 tree;
+	float32 maxFraction;
+	bool terminated;
 };
 
 /// This is used to sort pairs.
@@ -144,21 +300,51 @@ inline bool b2PairLessThan(const b2Pair& pair1, const b2Pair& pair2)
 	return false;
 }
 
+inline int32 b2BroadPhase::GetProxyId(int32 nodeId, int32 tree)
+{
+	return 2 * nodeId + tree;
+}
+
+inline int32 b2BroadPhase::GetNodeId(int32 proxyId)
+{
+	return proxyId >> 1;
+}
+
+inline bool b2BroadPhase::IsStaticProxy(int32 proxyId) const
+{
+	return (proxyId & 1) == e_staticTree;
+}
+
+inline const b2DynamicTree& b2BroadPhase::GetTree(int32 proxyId) const
+{
+	return IsStaticProxy(proxyId) ? m_staticTree : m_tree;
+}
+
+inline b2DynamicTree& b2BroadPhase::GetTree(int32 proxyId)
+{
+	return IsStaticProxy(proxyId) ? m_staticTree : m_tree;
+}
+
 inline void* b2BroadPhase::GetUserData(int32 proxyId) const
 {
-	return m_tree.GetUserData(proxyId);
+	return GetTree(proxyId).GetUserData(GetNodeId(proxyId));
+}
+
+inline void b2BroadPhase::SetCategoryBits(int32 proxyId, uint16 categoryBits)
+{
+	GetTree(proxyId).SetCategoryBits(GetNodeId(proxyId), categoryBits);
 }
 
 inline bool b2BroadPhase::TestOverlap(int32 proxyIdA, int32 proxyIdB) const
 {
-	const b2AABB& aabbA = m_tree.GetFatAABB(proxyIdA);
-	const b2AABB& aabbB = m_tree.GetFatAABB(proxyIdB);
+	const b2AABB& aabbA = GetFatAABB(proxyIdA);
+	const b2AABB& aabbB = GetFatAABB(proxyIdB);
 	return b2TestOverlap(aabbA, aabbB);
 }
 
 inline const b2AABB& b2BroadPhase::GetFatAABB(int32 proxyId) const
 {
-	return m_tree.GetFatAABB(proxyId);
+	return GetTree(proxyId).GetFatAABB(GetNodeId(proxyId));
 }
 
 inline int32 b2BroadPhase::GetProxyCount() const
@@ -166,27 +352,101 @@ inline int32 b2BroadPhase::GetProxyCount() const
 	return m_proxyCount;
 }
 
+inline void b2BroadPhase::SetAdaptiveMargins(bool flag)
+{
+	m_adaptiveMargins = flag;
+}
+
+inline bool b2BroadPhase::GetAdaptiveMargins() const
+{
+	return m_adaptiveMargins;
+}
+
+inline const b2ProxyMoveStats& b2BroadPhase::GetMoveStats() const
+{
+	return m_moveStats;
+}
+
+inline void b2BroadPhase::ResetMoveStats()
+{
+	m_moveStats.moveCount = 0;
+	m_moveStats.reinsertCount = 0;
+}
+
 inline int32 b2BroadPhase::GetTreeHeight() const
 {
-	return m_tree.GetHeight();
+	return b2Max(m_tree.GetHeight(), m_staticTree.GetHeight());
 }
 
 inline int32 b2BroadPhase::GetTreeBalance() const
 {
-	return m_tree.GetMaxBalance();
+	return b2Max(m_tree.GetMaxBalance(), m_staticTree.GetMaxBalance());
 }
 
 inline float32 b2BroadPhase::GetTreeQuality() const
 {
-	return m_tree.GetAreaRatio();
+	return b2Max(m_tree.GetAreaRatio(), m_staticTree.GetAreaRatio());
+}
+
+inline void b2BroadPhase::SetTreeRefitEnabled(bool flag)
+{
+	m_tree.SetRefitEnabled(flag);
+}
+
+inline bool b2BroadPhase::IsTreeRefitEnabled() const
+{
+	return m_tree.IsRefitEnabled();
+}
+
+inline void b2BroadPhase::SetTreeRebuildRatio(float32 ratio)
+{
+	m_tree.SetRebuildRatio(ratio);
+}
+
+inline void b2BroadPhase::SetTreeChangeTracking(bool flag)
+{
+	m_tree.SetChangeTracking(flag);
+	m_staticTree.SetChangeTracking(flag);
+}
+
+inline void b2BroadPhase::AdvanceTreeGenerations(const uint32 oldestGenerations[2])
+{
+	m_tree.AdvanceGeneration(oldestGenerations[e_dynamicTree]);
+	m_staticTree.AdvanceGeneration(oldestGenerations[e_staticTree]);
+}
+
+inline void b2BroadPhase::RebuildStaticTree()
+{
+	m_staticTree.RebuildTopDown();
+	UpdateCompressedTree();
+}
+
+inline bool b2BroadPhase::GetStaticTreeCompression() const
+{
+	return m_compressStaticTree;
+}
+
+inline int32 b2BroadPhase::GetCompressedTreeByteCount() const
+{
+	return m_compressStaticTree ? m_compressedTree.GetByteCount() : 0;
+}
+
+inline bool b2BroadPhase::IsCompressedTreeCurrent() const
+{
+	return m_compressStaticTree && m_compressedTree.GetModifyCount() == m_staticTree.GetModifyCount();
 }
 
 template <typename T>
 void b2BroadPhase::UpdatePairs(T* callback)
 {
+	b2ProfileScope("b2BroadPhase::UpdatePairs");
+
 	// Reset pair buffer
 	m_pairCount = 0;
 
+	// Tighten the tree around proxies moved in place.
+	m_tree.Refit();
+
 	// Perform tree queries for all moving proxies.
 	for (int32 i = 0; i < m_moveCount; ++i)
 	{
@@ -198,15 +458,26 @@ void b2BroadPhase::UpdatePairs(T* callback)
 
 		// We have to query the tree with the fat AABB so that
 		// we don't fail to create a pair that may touch later.
-		const b2AABB& fatAABB = m_tree.GetFatAABB(m_queryProxyId);
+		const b2AABB& fatAABB = GetFatAABB(m_queryProxyId);
+
+		// Query trees, create pairs and add them pair buffer.
+		// Static proxies never pair with each other.
+		if (IsStaticProxy(m_queryProxyId) == false)
+		{
+			m_queryTree = e_staticTree;
+			m_staticTree.Query(this, fatAABB);
+		}
 
-		// Query tree, create pairs and add them pair buffer.
+		m_queryTree = e_dynamicTree;
 		m_tree.Query(this, fatAABB);
 	}
 
 	// Reset move buffer
 	m_moveCount = 0;
 
+	// Static proxies may have been created, moved or destroyed since the last update.
+	UpdateCompressedTree();
+
 	// Sort the pair buffer to expose duplicates.
 	std::sort(m_pairBuffer, m_pairBuffer + m_pairCount, b2PairLessThan);
 
@@ -215,8 +486,8 @@ void b2BroadPhase::UpdatePairs(T* callback)
 	while (i < m_pairCount)
 	{
 		b2Pair* primaryPair = m_pairBuffer + i;
-		void* userDataA = m_tree.GetUserData(primaryPair->proxyIdA);
-		void* userDataB = m_tree.GetUserData(primaryPair->proxyIdB);
+		void* userDataA = GetUserData(primaryPair->proxyIdA);
+		void* userDataB = GetUserData(primaryPair->proxyIdB);
 
 		callback->AddPair(userDataA, userDataB);
 		++i;
@@ -240,18 +511,78 @@ void b2BroadPhase::UpdatePairs(T* callback)
 template <typename T>
 inline void b2BroadPhase::Query(T* callback, const b2AABB& aabb) const
 {
-	m_tree.Query(callback, aabb);
+	Query(callback, aabb, b2_allCategories);
 }
 
 template <typename T>
-inline void b2BroadPhase::RayCast(T* callback, const b2RayCastInput& input) const
+inline void b2BroadPhase::Query(T* callback, const b2AABB& aabb, uint16 maskBits) const
 {
-	m_tree.RayCast(callback, input);
+	b2BroadPhaseQueryWrapper<T> wrapper;
+	wrapper.callback = callback;
+	wrapper.proceed = true;
+
+	wrapper.tree = e_staticTree;
+	if (IsCompressedTreeCurrent())
+	{
+		m_compressedTree.Query(&wrapper, aabb, maskBits);
+	}
+	else
+	{
+		m_staticTree.Query(&wrapper, aabb, maskBits);
+	}
+	if (wrapper.proceed == false)
+	{
+		return;
+	}
+
+	wrapper.tree = e_dynamicTree;
+	m_tree.Query(&wrapper, aabb, maskBits);
+}
+
+template <typename T>
+inline b2TreeStats b2BroadPhase::RayCast(T* callback, const b2RayCastInput& input) const
+{
+	return RayCast(callback, input, b2_allCategories);
+}
+
+template <typename T>
+inline b2TreeStats b2BroadPhase::RayCast(T* callback, const b2RayCastInput& input, uint16 maskBits,
+										 b2TreeNodeCallback* nodeCallback) const
+{
+	b2BroadPhaseRayCastWrapper<T> wrapper;
+	wrapper.callback = callback;
+	wrapper.maxFraction = input.maxFraction;
+	wrapper.terminated = false;
+
+	// Static geometry usually blocks rays, so cast against it first to clip the ray.
+	b2TreeStats stats;
+	wrapper.tree = e_staticTree;
+	if (IsCompressedTreeCurrent())
+	{
+		stats = m_compressedTree.RayCast(&wrapper, input, maskBits, nodeCallback);
+	}
+	else
+	{
+		stats = m_staticTree.RayCast(&wrapper, input, maskBits, nodeCallback);
+	}
+	if (wrapper.terminated)
+	{
+		return stats;
+	}
+
+	b2RayCastInput subInput = input;
+	subInput.maxFraction = wrapper.maxFraction;
+	wrapper.tree = e_dynamicTree;
+	b2TreeStats dynamicStats = m_tree.RayCast(&wrapper, subInput, maskBits, nodeCallback);
+	stats.nodeVisits += dynamicStats.nodeVisits;
+	stats.leafVisits += dynamicStats.leafVisits;
+	return stats;
 }
 
 inline void b2BroadPhase::ShiftOrigin(const b2Vec2& newOrigin)
 {
 	m_tree.ShiftOrigin(newOrigin);
+	m_staticTree.ShiftOrigin(newOrigin);
 }
 
 #endif
@@ -0,0 +1,160 @@
+/*
+ * Copyright (c) 2007-2009 Erin Catto http://www.box2d.org
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty.  In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ * 1. The origin of this software must not be misrepresented; you must not
+ * claim that you wrote the original software. If you use this software
+ * in a product, an acknowledgment in the product documentation would be
+ * appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ * misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+#include <Box2D/Collision/b2Collision.h>
+#include <Box2D/Collision/Shapes/b2ChainShape.h>
+#include <Box2D/Collision/Shapes/b2CircleShape.h>
+#include <Box2D/Collision/Shapes/b2EdgeShape.h>
+#include <Box2D/Collision/Shapes/b2PolygonShape.h>
+
+// Collides each segment the shape touches and keeps the manifold with the deepest point.
+template <typename T>
+struct b2DeepestSegmentCallback
+{
+	typedef void CollideFcn(b2Manifold*, const b2EdgeShape*, const b2Transform&, const T*, const b2Transform&);
+
+	bool QuerySegment(int32 index)
+	{
+		b2EdgeShape edge;
+		chain->GetChildEdge(&edge, index);
+
+		b2Manifold segmentManifold;
+		collide(&segmentManifold, &edge, *xfA, shape, *xfB);
+		if (segmentManifold.pointCount == 0)
+		{
+			return true;
+		}
+
+		b2WorldManifold worldManifold;
+		worldManifold.Initialize(&segmentManifold, *xfA, chain->m_radius, *xfB, shape->m_radius);
+
+		float32 separation = worldManifold.separations[0];
+		for (int32 i = 1; i < segmentManifold.pointCount; ++i)
+		{
+			separation = b2Min(separation, worldManifold.separations[i]);
+		}
+
+		if (separation < minSeparation)
+		{
+			minSeparation = separation;
+			*manifold = segmentManifold;
+
+			// The edge colliders number features within their segment only, so points
+			// from different segments would share ids and be warm started with each
+			// other's impulses when the deepest segment changes. Fold the segment index
+			// into the high nibbles of the feature indices, which are at most
+			// b2_maxPolygonVertices - 1, so nearby segments never share an id.
+			for (int32 i = 0; i < manifold->pointCount; ++i)
+			{
+				b2ContactFeature& cf = manifold->points[i].id.cf;
+				cf.indexA = uint8(cf.indexA | ((index & 0x0F) << 4));
+				cf.indexB = uint8(cf.indexB | (((index >> 4) & 0x0F) << 4));
+			}
+		}
+
+		return true;
+	}
+
+	b2Manifold* manifold;
+	const b2ChainShape* chain;
+	const T* shape;
+	const b2Transform* xfA;
+	const b2Transform* xfB;
+	CollideFcn* collide;
+	float32 minSeparation;
+};
+
+// Stops at the first segment that overlaps the shape.
+struct b2OverlapSegmentCallback
+{
+	bool QuerySegment(int32 index)
+	{
+		b2EdgeShape edge;
+		chain->GetChildEdge(&edge, index);
+		overlap = b2TestOverlap(&edge, 0, shape, shapeIndex, *xfA, *xfB);
+		return overlap == false;
+	}
+
+	const b2ChainShape* chain;
+	const b2Shape* shape;
+	int32 shapeIndex;
+	const b2Transform* xfA;
+	const b2Transform* xfB;
+	bool overlap;
+};
+
+template <typename T>
+static void b2CollideDeepestSegment(b2Manifold* manifold,
+									const b2ChainShape* chainA, const b2Transform& xfA,
+									const T* shapeB, const b2Transform& xfB,
+									typename b2DeepestSegmentCallback<T>::CollideFcn* collide)
+{
+	manifold->pointCount = 0;
+
+	// Bound the shape in the frame of the chain. The chain radius is added so the
+	// query finds every segment the edge collider could report points for.
+	b2AABB aabb;
+	shapeB->ComputeAABB(&aabb, b2MulT(xfA, xfB), 0);
+	b2Vec2 r(chainA->m_radius, chainA->m_radius);
+	aabb.lowerBound -= r;
+	aabb.upperBound += r;
+
+	b2DeepestSegmentCallback<T> callback;
+	callback.manifold = manifold;
+	callback.chain = chainA;
+	callback.shape = shapeB;
+	callback.xfA = &xfA;
+	callback.xfB = &xfB;
+	callback.collide = collide;
+	callback.minSeparation = b2_maxFloat;
+	chainA->QuerySegments(&callback, aabb);
+}
+
+void b2CollideChainAndCircle(b2Manifold* manifold,
+							 const b2ChainShape* chainA, const b2Transform& xfA,
+							 const b2CircleShape* circleB, const b2Transform& xfB)
+{
+	b2CollideDeepestSegment(manifold, chainA, xfA, circleB, xfB, b2CollideEdgeAndCircle);
+}
+
+void b2CollideChainAndPolygon(b2Manifold* manifold,
+							  const b2ChainShape* chainA, const b2Transform& xfA,
+							  const b2PolygonShape* polygonB, const b2Transform& xfB)
+{
+	b2CollideDeepestSegment(manifold, chainA, xfA, polygonB, xfB, b2CollideEdgeAndPolygon);
+}
+
+bool b2TestChainOverlap(const b2ChainShape* chainA, const b2Transform& xfA,
+						const b2Shape* shapeB, int32 indexB, const b2Transform& xfB)
+{
+	b2AABB aabb;
+	shapeB->ComputeAABB(&aabb, b2MulT(xfA, xfB), indexB);
+	b2Vec2 r(chainA->m_radius, chainA->m_radius);
+	aabb.lowerBound -= r;
+	aabb.upperBound += r;
+
+	b2OverlapSegmentCallback callback;
+	callback.chain = chainA;
+	callback.shape = shapeB;
+	callback.shapeIndex = indexB;
+	callback.xfA = &xfA;
+	callback.xfB = &xfB;
+	callback.overlap = false;
+	chainA->QuerySegments(&callback, aabb);
+	return callback.overlap;
+}
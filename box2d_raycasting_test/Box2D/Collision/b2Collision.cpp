@@ -18,6 +18,7 @@
 
 #include <Box2D/Collision/b2Collision.h>
 #include <Box2D/Collision/b2Distance.h>
+#include <Box2D/Collision/Shapes/b2ChainShape.h>
 
 void b2WorldManifold::Initialize(const b2Manifold* manifold,
 						  const b2Transform& xfA, float32 radiusA,
@@ -234,6 +235,18 @@ bool b2TestOverlap(	const b2Shape* shapeA, int32 indexA,
 					const b2Shape* shapeB, int32 indexB,
 					const b2Transform& xfA, const b2Transform& xfB)
 {
+	// A chain with a segment tree is a single child, which the distance proxy can't
+	// represent. Test the segments under the other shape instead.
+	if (shapeA->GetType() == b2Shape::e_chain && ((const b2ChainShape*)shapeA)->HasSegmentTree())
+	{
+		return b2TestChainOverlap((const b2ChainShape*)shapeA, xfA, shapeB, indexB, xfB);
+	}
+
+	if (shapeB->GetType() == b2Shape::e_chain && ((const b2ChainShape*)shapeB)->HasSegmentTree())
+	{
+		return b2TestChainOverlap((const b2ChainShape*)shapeB, xfB, shapeA, indexA, xfA);
+	}
+
 	b2DistanceInput input;
 	input.proxyA.Set(shapeA, indexA);
 	input.proxyB.Set(shapeB, indexB);
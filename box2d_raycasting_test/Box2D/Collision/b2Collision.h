@@ -27,6 +27,7 @@
 /// queries, and TOI queries.
 
 class b2Shape;
+class b2ChainShape;
 class b2CircleShape;
 class b2EdgeShape;
 class b2PolygonShape;
@@ -240,6 +241,18 @@ void b2CollideEdgeAndPolygon(b2Manifold* manifold,
 							   const b2EdgeShape* edgeA, const b2Transform& xfA,
 							   const b2PolygonShape* circleB, const b2Transform& xfB);
 
+/// Compute the collision manifold between a chain with a segment tree and a circle.
+/// This uses the most penetrating segment the circle touches.
+void b2CollideChainAndCircle(b2Manifold* manifold,
+							 const b2ChainShape* chainA, const b2Transform& xfA,
+							 const b2CircleShape* circleB, const b2Transform& xfB);
+
+/// Compute the collision manifold between a chain with a segment tree and a polygon.
+/// This uses the most penetrating segment the polygon touches.
+void b2CollideChainAndPolygon(b2Manifold* manifold,
+							  const b2ChainShape* chainA, const b2Transform& xfA,
+							  const b2PolygonShape* polygonB, const b2Transform& xfB);
+
 /// Clipping for contact manifolds.
 int32 b2ClipSegmentToLine(b2ClipVertex vOut[2], const b2ClipVertex vIn[2],
 							const b2Vec2& normal, float32 offset, int32 vertexIndexA);
@@ -249,6 +262,11 @@ bool b2TestOverlap(	const b2Shape* shapeA, int32 indexA,
 					const b2Shape* shapeB, int32 indexB,
 					const b2Transform& xfA, const b2Transform& xfB);
 
+/// Determine if a chain with a segment tree overlaps a shape. This tests each segment
+/// that the shape's bounds touch.
+bool b2TestChainOverlap(const b2ChainShape* chainA, const b2Transform& xfA,
+						const b2Shape* shapeB, int32 indexB, const b2Transform& xfB);
+
 // ---------------- Inline Functions ------------------------------------------
 
 inline bool b2AABB::IsValid() const
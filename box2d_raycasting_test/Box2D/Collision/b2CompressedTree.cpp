@@ -0,0 +1,210 @@
+/*
+* Copyright (c) 2009 Erin Catto http://www.box2d.org
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include <Box2D/Collision/b2CompressedTree.h>
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+
+b2CompressedTree::b2CompressedTree(const b2Allocator& allocator)
+	: m_allocator(allocator)
+{
+	m_nodes = NULL;
+	m_nodeCount = 0;
+	m_leaves = NULL;
+	m_leafCount = 0;
+	m_farOffsets = NULL;
+	m_farCount = 0;
+	m_farCapacity = 0;
+	m_rootCategoryBits = 0;
+	m_modifyCount = 0;
+}
+
+b2CompressedTree::~b2CompressedTree()
+{
+	Clear();
+}
+
+void b2CompressedTree::Clear()
+{
+	// The leaves share the node block.
+	m_allocator.Free(m_nodes, m_nodeCount * sizeof(b2CompressedNode) + m_leafCount * sizeof(int32), b2_treeMemory);
+	m_allocator.Free(m_farOffsets, m_farCapacity * sizeof(b2CompressedFarOffset), b2_treeMemory);
+	m_nodes = NULL;
+	m_leaves = NULL;
+	m_nodeCount = 0;
+	m_leafCount = 0;
+	m_farOffsets = NULL;
+	m_farCount = 0;
+	m_farCapacity = 0;
+}
+
+int32 b2CompressedTree::GetByteCount() const
+{
+	return m_nodeCount * sizeof(b2CompressedNode) + m_leafCount * sizeof(int32) +
+		m_farCapacity * sizeof(b2CompressedFarOffset);
+}
+
+static bool b2FarOffsetLess(const b2CompressedFarOffset& a, const b2CompressedFarOffset& b)
+{
+	return a.node < b.node;
+}
+
+void b2CompressedTree::Build(const b2DynamicTree* tree)
+{
+	Clear();
+	m_modifyCount = tree->GetModifyCount();
+
+	if (tree->m_root == b2_nullNode)
+	{
+		return;
+	}
+
+	// A full binary tree with n leaves has n - 1 internal nodes. The leaves go right
+	// after the nodes in the same block.
+	int32 leafCount = (tree->m_nodeCount + 1) / 2;
+	int32 nodeCount = leafCount - 1;
+	void* memory = m_allocator.Allocate(nodeCount * sizeof(b2CompressedNode) + leafCount * sizeof(int32), b2_treeMemory);
+	m_nodes = (b2CompressedNode*)memory;
+	m_leaves = (int32*)(m_nodes + nodeCount);
+
+	m_rootAABB = tree->m_nodes[tree->m_root].aabb;
+	m_rootCategoryBits = tree->m_nodes[tree->m_root].categoryBits;
+
+	if (tree->m_nodes[tree->m_root].IsLeaf())
+	{
+		m_leaves[0] = tree->m_root;
+		m_leafCount = 1;
+		return;
+	}
+
+	Encode(tree, tree->m_root, m_rootAABB);
+	b2Assert(m_nodeCount == nodeCount && m_leafCount == leafCount);
+
+	std::sort(m_farOffsets, m_farOffsets + m_farCount, b2FarOffsetLess);
+}
+
+// Quantize a lower bound so that the decoded value is at or below it.
+static uint8 b2QuantizeLower(float32 parentLower, float32 step, float32 lower)
+{
+	if (step <= 0.0f)
+	{
+		return 0;
+	}
+
+	int32 q = b2Clamp(int32(floorf((lower - parentLower) / step)), 0, 255);
+	while (q > 0 && parentLower + float32(q) * step > lower)
+	{
+		--q;
+	}
+	return uint8(q);
+}
+
+// Quantize an upper bound so that the decoded value is at or above it.
+static uint8 b2QuantizeUpper(float32 parentUpper, float32 step, float32 upper)
+{
+	if (step <= 0.0f)
+	{
+		return 0;
+	}
+
+	int32 q = b2Clamp(int32(floorf((parentUpper - upper) / step)), 0, 255);
+	while (q > 0 && parentUpper - float32(q) * step < upper)
+	{
+		--q;
+	}
+	return uint8(q);
+}
+
+// Encode the sub-tree under an internal node, given the node's decoded bounds. The
+// children are quantized against the decoded bounds rather than the exact ones, so
+// every decoded box contains the exact box. Returns the number of nodes written.
+int32 b2CompressedTree::Encode(const b2DynamicTree* tree, int32 sourceId, const b2AABB& aabb)
+{
+	const b2TreeNode* source = tree->m_nodes + sourceId;
+	int32 index = m_nodeCount++;
+	b2CompressedNode* node = m_nodes + index;
+	node->flags = 0;
+	node->padding = 0;
+
+	b2Vec2 step = (1.0f / 255.0f) * (aabb.upperBound - aabb.lowerBound);
+	b2AABB childAABBs[2];
+	int32 children[2] = { source->child1, source->child2 };
+	for (int32 i = 0; i < 2; ++i)
+	{
+		const b2TreeNode* child = tree->m_nodes + children[i];
+		node->bounds[i][0] = b2QuantizeLower(aabb.lowerBound.x, step.x, child->aabb.lowerBound.x);
+		node->bounds[i][1] = b2QuantizeLower(aabb.lowerBound.y, step.y, child->aabb.lowerBound.y);
+		node->bounds[i][2] = b2QuantizeUpper(aabb.upperBound.x, step.x, child->aabb.upperBound.x);
+		node->bounds[i][3] = b2QuantizeUpper(aabb.upperBound.y, step.y, child->aabb.upperBound.y);
+		node->categoryBits[i] = child->categoryBits;
+		Decode(childAABBs + i, aabb, step, node->bounds[i]);
+	}
+
+	int32 count1 = 0;
+	if (tree->m_nodes[children[0]].IsLeaf())
+	{
+		node->flags |= b2CompressedNode::e_leaf1;
+		m_leaves[m_leafCount++] = children[0];
+	}
+	else
+	{
+		count1 = Encode(tree, children[0], childAABBs[0]);
+	}
+
+	// The node pointer may not be used past the recursion above, so index the array.
+	int32 offset = count1 + 1;
+	if (offset < b2_compressedFarOffset)
+	{
+		m_nodes[index].offset = uint16(offset);
+	}
+	else
+	{
+		m_nodes[index].offset = b2_compressedFarOffset;
+
+		if (m_farCount == m_farCapacity)
+		{
+			b2CompressedFarOffset* oldFarOffsets = m_farOffsets;
+			int32 oldCapacity = m_farCapacity;
+			m_farCapacity = b2Max(2 * m_farCapacity, 16);
+			m_farOffsets = (b2CompressedFarOffset*)m_allocator.Allocate(m_farCapacity * sizeof(b2CompressedFarOffset), b2_treeMemory);
+			if (oldFarOffsets)
+			{
+				memcpy(m_farOffsets, oldFarOffsets, m_farCount * sizeof(b2CompressedFarOffset));
+				m_allocator.Free(oldFarOffsets, oldCapacity * sizeof(b2CompressedFarOffset), b2_treeMemory);
+			}
+		}
+
+		m_farOffsets[m_farCount].node = index;
+		m_farOffsets[m_farCount].offset = offset;
+		++m_farCount;
+	}
+
+	int32 count2 = 0;
+	if (tree->m_nodes[children[1]].IsLeaf())
+	{
+		m_nodes[index].flags |= b2CompressedNode::e_leaf2;
+		m_leaves[m_leafCount++] = children[1];
+	}
+	else
+	{
+		count2 = Encode(tree, children[1], childAABBs[1]);
+	}
+
+	return 1 + count1 + count2;
+}
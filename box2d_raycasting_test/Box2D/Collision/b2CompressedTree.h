@@ -0,0 +1,356 @@
+/*
+* Copyright (c) 2009 Erin Catto http://www.box2d.org
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef B2_COMPRESSED_TREE_H
+#define B2_COMPRESSED_TREE_H
+
+#include <Box2D/Collision/b2DynamicTree.h>
+
+/// Child offsets at or above this value are looked up in the far table.
+#define b2_compressedFarOffset 0xFFFF
+
+/// An internal node of a compressed tree. It holds the bounds of both children,
+/// quantized to 8 bits relative to the node's own bounds.
+struct b2CompressedNode
+{
+	enum
+	{
+		e_leaf1 = 0x01,
+		e_leaf2 = 0x02
+	};
+
+	/// Per child: lower x, lower y, upper x, upper y. Lower bounds count up from the
+	/// parent's lower bound and upper bounds count down from its upper bound, in steps
+	/// of 1/255 of the parent's extents.
+	uint8 bounds[2][4];
+	uint16 categoryBits[2];
+
+	/// Nodes are in depth first order, so child1 is the next node. child2 is this many
+	/// nodes further, which is also the number of leaves under child1.
+	uint16 offset;
+	uint8 flags;
+	uint8 padding;
+};
+
+/// A child offset that doesn't fit in 16 bits.
+struct b2CompressedFarOffset
+{
+	int32 node;
+	int32 offset;
+};
+
+/// A read-only copy of a dynamic tree that takes a fraction of the memory. Internal
+/// nodes are 16 bytes and leaves are 4, against 48 bytes for every node of the
+/// dynamic tree, so traversals touch far fewer cache lines.
+///
+/// The quantized bounds are rounded outwards, so queries and ray casts may report a
+/// few extra leaves near the edges of the query but never miss one. Leaves are
+/// reported by their node id in the source tree.
+///
+/// The copy doesn't follow changes to the source tree. Build it again when
+/// b2DynamicTree::GetModifyCount has changed.
+class b2CompressedTree
+{
+public:
+	explicit b2CompressedTree(const b2Allocator& allocator = b2Allocator());
+	~b2CompressedTree();
+
+	/// Build a copy of the tree, replacing the current one.
+	void Build(const b2DynamicTree* tree);
+
+	/// Free the copy.
+	void Clear();
+
+	/// Has the copy been built?
+	bool IsBuilt() const { return m_leafCount > 0; }
+
+	/// Get the modify count of the source tree when the copy was built.
+	uint32 GetModifyCount() const { return m_modifyCount; }
+
+	/// Get the number of bytes used by the nodes, leaves and far offsets.
+	int32 GetByteCount() const;
+
+	/// Query an AABB for leaves whose quantized bounds overlap it and whose category
+	/// bits match the mask. Works like b2DynamicTree::Query.
+	template <typename T>
+	void Query(T* callback, const b2AABB& aabb, uint16 maskBits) const;
+
+	/// Ray-cast against the leaves whose category bits match the mask. Works like
+	/// b2DynamicTree::RayCast.
+	template <typename T>
+	b2TreeStats RayCast(T* callback, const b2RayCastInput& input, uint16 maskBits,
+						b2TreeNodeCallback* nodeCallback = NULL) const;
+
+private:
+
+	// A node waiting to be visited, with its decoded bounds.
+	struct StackEntry
+	{
+		b2AABB aabb;
+		int32 node;
+		int32 firstLeaf;
+	};
+
+	b2CompressedTree(const b2CompressedTree&);
+	b2CompressedTree& operator=(const b2CompressedTree&);
+
+	int32 Encode(const b2DynamicTree* tree, int32 sourceId, const b2AABB& aabb);
+	int32 GetOffset(int32 node) const;
+
+	static void Decode(b2AABB* child, const b2AABB& parent, const b2Vec2& step, const uint8 q[4]);
+
+	b2Allocator m_allocator;
+
+	b2CompressedNode* m_nodes;
+	int32 m_nodeCount;
+
+	int32* m_leaves;
+	int32 m_leafCount;
+
+	b2CompressedFarOffset* m_farOffsets;
+	int32 m_farCount;
+	int32 m_farCapacity;
+
+	// The root bounds, unquantized.
+	b2AABB m_rootAABB;
+	uint16 m_rootCategoryBits;
+
+	uint32 m_modifyCount;
+};
+
+inline void b2CompressedTree::Decode(b2AABB* child, const b2AABB& parent, const b2Vec2& step, const uint8 q[4])
+{
+	child->lowerBound.x = parent.lowerBound.x + float32(q[0]) * step.x;
+	child->lowerBound.y = parent.lowerBound.y + float32(q[1]) * step.y;
+	child->upperBound.x = parent.upperBound.x - float32(q[2]) * step.x;
+	child->upperBound.y = parent.upperBound.y - float32(q[3]) * step.y;
+}
+
+inline int32 b2CompressedTree::GetOffset(int32 node) const
+{
+	int32 offset = m_nodes[node].offset;
+	if (offset != b2_compressedFarOffset)
+	{
+		return offset;
+	}
+
+	// There are only a few far offsets, near the root. Binary search them.
+	int32 low = 0;
+	int32 high = m_farCount - 1;
+	while (low < high)
+	{
+		int32 mid = (low + high) / 2;
+		if (m_farOffsets[mid].node < node)
+		{
+			low = mid + 1;
+		}
+		else
+		{
+			high = mid;
+		}
+	}
+
+	b2Assert(m_farOffsets[low].node == node);
+	return m_farOffsets[low].offset;
+}
+
+template <typename T>
+inline void b2CompressedTree::Query(T* callback, const b2AABB& aabb, uint16 maskBits) const
+{
+	if (m_leafCount == 0 || b2MaskExcludes(m_rootCategoryBits, maskBits) || b2TestOverlap(m_rootAABB, aabb) == false)
+	{
+		return;
+	}
+
+	if (m_leafCount == 1)
+	{
+		callback->QueryCallback(m_leaves[0]);
+		return;
+	}
+
+	b2GrowableStack<StackEntry, 64> stack;
+	StackEntry root;
+	root.aabb = m_rootAABB;
+	root.node = 0;
+	root.firstLeaf = 0;
+	stack.Push(root);
+
+	while (stack.GetCount() > 0)
+	{
+		StackEntry entry = stack.Pop();
+		const b2CompressedNode* node = m_nodes + entry.node;
+		int32 offset = GetOffset(entry.node);
+		b2Vec2 step = (1.0f / 255.0f) * (entry.aabb.upperBound - entry.aabb.lowerBound);
+
+		for (int32 i = 0; i < 2; ++i)
+		{
+			if (b2MaskExcludes(node->categoryBits[i], maskBits))
+			{
+				continue;
+			}
+
+			StackEntry child;
+			Decode(&child.aabb, entry.aabb, step, node->bounds[i]);
+			if (b2TestOverlap(child.aabb, aabb) == false)
+			{
+				continue;
+			}
+
+			child.node = entry.node + (i == 0 ? 1 : offset);
+			child.firstLeaf = entry.firstLeaf + (i == 0 ? 0 : offset);
+
+			if (node->flags & (i == 0 ? b2CompressedNode::e_leaf1 : b2CompressedNode::e_leaf2))
+			{
+				bool proceed = callback->QueryCallback(m_leaves[child.firstLeaf]);
+				if (proceed == false)
+				{
+					return;
+				}
+			}
+			else
+			{
+				stack.Push(child);
+			}
+		}
+	}
+}
+
+template <typename T>
+inline b2TreeStats b2CompressedTree::RayCast(T* callback, const b2RayCastInput& input, uint16 maskBits,
+											 b2TreeNodeCallback* nodeCallback) const
+{
+	b2TreeStats stats = { 0, 0 };
+
+	if (m_leafCount == 0 || b2MaskExcludes(m_rootCategoryBits, maskBits))
+	{
+		return stats;
+	}
+
+	b2Vec2 p1 = input.p1;
+	b2Vec2 p2 = input.p2;
+	b2Vec2 r = p2 - p1;
+	b2Assert(r.LengthSquared() > 0.0f);
+	r.Normalize();
+
+	// v is perpendicular to the segment.
+	b2Vec2 v = b2Cross(1.0f, r);
+	b2Vec2 abs_v = b2Abs(v);
+
+	float32 maxFraction = input.maxFraction;
+
+	// Build a bounding box for the segment.
+	b2AABB segmentAABB;
+	{
+		b2Vec2 t = p1 + maxFraction * (p2 - p1);
+		segmentAABB.lowerBound = b2Min(p1, t);
+		segmentAABB.upperBound = b2Max(p1, t);
+	}
+
+	// The root is tested like a child so a single leaf needs no special case.
+	b2GrowableStack<StackEntry, 64> stack;
+	StackEntry root;
+	root.aabb = m_rootAABB;
+	root.node = m_leafCount == 1 ? b2_nullNode : 0;
+	root.firstLeaf = 0;
+	stack.Push(root);
+
+	while (stack.GetCount() > 0)
+	{
+		StackEntry entry = stack.Pop();
+
+		++stats.nodeVisits;
+		if (nodeCallback)
+		{
+			nodeCallback->ReportNode(entry.aabb);
+		}
+
+		if (b2TestOverlap(entry.aabb, segmentAABB) == false)
+		{
+			continue;
+		}
+
+		// Separating axis for segment (Gino, p80).
+		// |dot(v, p1 - c)| > dot(|v|, h)
+		b2Vec2 c = entry.aabb.GetCenter();
+		b2Vec2 h = entry.aabb.GetExtents();
+		float32 separation = b2Abs(b2Dot(v, p1 - c)) - b2Dot(abs_v, h);
+		if (separation > 0.0f)
+		{
+			continue;
+		}
+
+		if (entry.node == b2_nullNode)
+		{
+			b2RayCastInput subInput;
+			subInput.p1 = input.p1;
+			subInput.p2 = input.p2;
+			subInput.maxFraction = maxFraction;
+
+			++stats.leafVisits;
+			float32 value = callback->RayCastCallback(subInput, m_leaves[entry.firstLeaf]);
+
+			if (value == 0.0f)
+			{
+				// The client has terminated the ray cast.
+				return stats;
+			}
+
+			if (value > 0.0f)
+			{
+				// Update segment bounding box.
+				maxFraction = value;
+				b2Vec2 t = p1 + maxFraction * (p2 - p1);
+				segmentAABB.lowerBound = b2Min(p1, t);
+				segmentAABB.upperBound = b2Max(p1, t);
+			}
+			continue;
+		}
+
+		// Push both children. Leaves are pushed with a null node and tested when popped.
+		const b2CompressedNode* node = m_nodes + entry.node;
+		int32 offset = GetOffset(entry.node);
+		b2Vec2 step = (1.0f / 255.0f) * (entry.aabb.upperBound - entry.aabb.lowerBound);
+
+		for (int32 i = 0; i < 2; ++i)
+		{
+			if (b2MaskExcludes(node->categoryBits[i], maskBits))
+			{
+				continue;
+			}
+
+			StackEntry child;
+			Decode(&child.aabb, entry.aabb, step, node->bounds[i]);
+			child.firstLeaf = entry.firstLeaf + (i == 0 ? 0 : offset);
+
+			if (node->flags & (i == 0 ? b2CompressedNode::e_leaf1 : b2CompressedNode::e_leaf2))
+			{
+				child.node = b2_nullNode;
+			}
+			else
+			{
+				child.node = entry.node + (i == 0 ? 1 : offset);
+			}
+
+			stack.Push(child);
+		}
+	}
+
+	return stats;
+}
+
+#endif
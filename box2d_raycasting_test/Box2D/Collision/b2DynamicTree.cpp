@@ -18,14 +18,45 @@
 
 #include <Box2D/Collision/b2DynamicTree.h>
 #include <string.h>
+#include <algorithm>
 
-b2DynamicTree::b2DynamicTree()
+// Orders refit nodes so that children are refit before their parents.
+struct b2RefitHeightLess
+{
+	bool operator()(int32 a, int32 b) const
+	{
+		return nodes[a].height < nodes[b].height;
+	}
+
+	const b2TreeNode* nodes;
+};
+
+// Orders leaves by the center of their AABB along one axis.
+struct b2LeafCenterLess
+{
+	bool operator()(int32 a, int32 b) const
+	{
+		const b2AABB& aabbA = nodes[a].aabb;
+		const b2AABB& aabbB = nodes[b].aabb;
+		if (axis == 0)
+		{
+			return aabbA.lowerBound.x + aabbA.upperBound.x < aabbB.lowerBound.x + aabbB.upperBound.x;
+		}
+		return aabbA.lowerBound.y + aabbA.upperBound.y < aabbB.lowerBound.y + aabbB.upperBound.y;
+	}
+
+	const b2TreeNode* nodes;
+	int32 axis;
+};
+
+b2DynamicTree::b2DynamicTree(const b2Allocator& allocator)
+	: m_allocator(allocator)
 {
 	m_root = b2_nullNode;
 
 	m_nodeCapacity = 16;
 	m_nodeCount = 0;
-	m_nodes = (b2TreeNode*)b2Alloc(m_nodeCapacity * sizeof(b2TreeNode));
+	m_nodes = (b2TreeNode*)m_allocator.Allocate(m_nodeCapacity * sizeof(b2TreeNode), b2_treeMemory);
 	memset(m_nodes, 0, m_nodeCapacity * sizeof(b2TreeNode));
 
 	// Build a linked list for the free list.
@@ -41,12 +72,55 @@ b2DynamicTree::b2DynamicTree()
 	m_path = 0;
 
 	m_insertionCount = 0;
+
+	m_refitEnabled = false;
+	m_refitCapacity = 16;
+	m_refitCount = 0;
+	m_refitBuffer = (int32*)m_allocator.Allocate(m_refitCapacity * sizeof(int32), b2_treeMemory);
+
+	m_rebuildRatio = b2_treeRebuildRatio;
+	m_basePerimeter = 0.0f;
+	m_perimeterGrowth = 0.0f;
+
+	m_trackChanges = false;
+	m_generation = 1;
+	m_modifyCount = 0;
+	m_fullChangeGeneration = 1;
+	m_changeCapacity = 16;
+	m_changeCount = 0;
+	m_changeLog = (b2TreeChange*)m_allocator.Allocate(m_changeCapacity * sizeof(b2TreeChange), b2_treeMemory);
 }
 
 b2DynamicTree::~b2DynamicTree()
 {
 	// This frees the entire tree in one shot.
-	b2Free(m_nodes);
+	m_allocator.Free(m_nodes, m_nodeCapacity * sizeof(b2TreeNode), b2_treeMemory);
+	m_allocator.Free(m_refitBuffer, m_refitCapacity * sizeof(int32), b2_treeMemory);
+	m_allocator.Free(m_changeLog, m_changeCapacity * sizeof(b2TreeChange), b2_treeMemory);
+}
+
+void b2DynamicTree::Clear()
+{
+	MarkAllChanged();
+
+	m_root = b2_nullNode;
+	m_nodeCount = 0;
+
+	// Rebuild the free list over the whole pool.
+	for (int32 i = 0; i < m_nodeCapacity - 1; ++i)
+	{
+		m_nodes[i].next = i + 1;
+		m_nodes[i].height = -1;
+	}
+	m_nodes[m_nodeCapacity-1].next = b2_nullNode;
+	m_nodes[m_nodeCapacity-1].height = -1;
+	m_freeList = 0;
+
+	m_path = 0;
+	m_insertionCount = 0;
+	m_refitCount = 0;
+	m_basePerimeter = 0.0f;
+	m_perimeterGrowth = 0.0f;
 }
 
 // Allocate a node from the pool. Grow the pool if necessary.
@@ -59,10 +133,11 @@ int32 b2DynamicTree::AllocateNode()
 
 		// The free list is empty. Rebuild a bigger pool.
 		b2TreeNode* oldNodes = m_nodes;
+		int32 oldCapacity = m_nodeCapacity;
 		m_nodeCapacity *= 2;
-		m_nodes = (b2TreeNode*)b2Alloc(m_nodeCapacity * sizeof(b2TreeNode));
+		m_nodes = (b2TreeNode*)m_allocator.Allocate(m_nodeCapacity * sizeof(b2TreeNode), b2_treeMemory);
 		memcpy(m_nodes, oldNodes, m_nodeCount * sizeof(b2TreeNode));
-		b2Free(oldNodes);
+		m_allocator.Free(oldNodes, oldCapacity * sizeof(b2TreeNode), b2_treeMemory);
 
 		// Build a linked list for the free list. The parent
 		// pointer becomes the "next" pointer.
@@ -70,9 +145,11 @@ int32 b2DynamicTree::AllocateNode()
 		{
 			m_nodes[i].next = i + 1;
 			m_nodes[i].height = -1;
+			m_nodes[i].generation = 0;
 		}
 		m_nodes[m_nodeCapacity-1].next = b2_nullNode;
 		m_nodes[m_nodeCapacity-1].height = -1;
+		m_nodes[m_nodeCapacity-1].generation = 0;
 		m_freeList = m_nodeCount;
 	}
 
@@ -84,6 +161,9 @@ int32 b2DynamicTree::AllocateNode()
 	m_nodes[nodeId].child2 = b2_nullNode;
 	m_nodes[nodeId].height = 0;
 	m_nodes[nodeId].userData = NULL;
+	m_nodes[nodeId].categoryBits = 0;
+	m_nodes[nodeId].refit = false;
+	MarkChanged(nodeId);
 	++m_nodeCount;
 	return nodeId;
 }
@@ -95,14 +175,21 @@ void b2DynamicTree::FreeNode(int32 nodeId)
 	b2Assert(0 < m_nodeCount);
 	m_nodes[nodeId].next = m_freeList;
 	m_nodes[nodeId].height = -1;
+	m_nodes[nodeId].refit = false;
 	m_freeList = nodeId;
 	--m_nodeCount;
+	++m_modifyCount;
 }
 
 // Create a proxy in the tree as a leaf node. We return the index
 // of the node instead of a pointer so that we can grow
 // the node pool.
 int32 b2DynamicTree::CreateProxy(const b2AABB& aabb, void* userData)
+{
+	return CreateProxy(aabb, userData, 0xFFFF);
+}
+
+int32 b2DynamicTree::CreateProxy(const b2AABB& aabb, void* userData, uint16 categoryBits)
 {
 	int32 proxyId = AllocateNode();
 
@@ -112,12 +199,86 @@ int32 b2DynamicTree::CreateProxy(const b2AABB& aabb, void* userData)
 	m_nodes[proxyId].aabb.upperBound = aabb.upperBound + r;
 	m_nodes[proxyId].userData = userData;
 	m_nodes[proxyId].height = 0;
+	m_nodes[proxyId].categoryBits = categoryBits;
 
 	InsertLeaf(proxyId);
 
 	return proxyId;
 }
 
+void b2DynamicTree::CreateProxies(const b2AABB* aabbs, void* const* userData, const uint16* categoryBits,
+								  int32 count, int32* proxyIds)
+{
+	if (count == 0)
+	{
+		return;
+	}
+
+	b2Vec2 r(b2_aabbExtension, b2_aabbExtension);
+	for (int32 i = 0; i < count; ++i)
+	{
+		int32 proxyId = AllocateNode();
+		m_nodes[proxyId].aabb.lowerBound = aabbs[i].lowerBound - r;
+		m_nodes[proxyId].aabb.upperBound = aabbs[i].upperBound + r;
+		m_nodes[proxyId].userData = userData[i];
+		m_nodes[proxyId].height = 0;
+		m_nodes[proxyId].categoryBits = categoryBits[i];
+		proxyIds[i] = proxyId;
+	}
+	m_insertionCount += count;
+
+	// The builder reorders its input, so give it a copy of the ids.
+	int32* leaves = (int32*)m_allocator.Allocate(count * sizeof(int32), b2_treeMemory);
+	memcpy(leaves, proxyIds, count * sizeof(int32));
+	int32 subTree = BuildTopDown(leaves, count, 0);
+	m_allocator.Free(leaves, count * sizeof(int32), b2_treeMemory);
+
+	if (m_root == b2_nullNode)
+	{
+		m_root = subTree;
+		m_nodes[m_root].parent = b2_nullNode;
+		return;
+	}
+
+	int32 oldRoot = m_root;
+	int32 newRoot = AllocateNode();
+	m_nodes[newRoot].child1 = oldRoot;
+	m_nodes[newRoot].child2 = subTree;
+	m_nodes[newRoot].height = 1 + b2Max(m_nodes[oldRoot].height, m_nodes[subTree].height);
+	m_nodes[newRoot].aabb.Combine(m_nodes[oldRoot].aabb, m_nodes[subTree].aabb);
+	m_nodes[newRoot].categoryBits = m_nodes[oldRoot].categoryBits | m_nodes[subTree].categoryBits;
+	m_nodes[oldRoot].parent = newRoot;
+	m_nodes[subTree].parent = newRoot;
+	MarkChanged(oldRoot);
+	MarkChanged(subTree);
+	m_root = newRoot;
+}
+
+void b2DynamicTree::SetCategoryBits(int32 proxyId, uint16 categoryBits)
+{
+	b2Assert(0 <= proxyId && proxyId < m_nodeCapacity);
+	b2Assert(m_nodes[proxyId].IsLeaf());
+
+	m_nodes[proxyId].categoryBits = categoryBits;
+	MarkChanged(proxyId);
+
+	// Walk up until an ancestor's union is unchanged.
+	int32 index = m_nodes[proxyId].parent;
+	while (index != b2_nullNode)
+	{
+		b2TreeNode* node = m_nodes + index;
+		uint16 bits = m_nodes[node->child1].categoryBits | m_nodes[node->child2].categoryBits;
+		if (bits == node->categoryBits)
+		{
+			break;
+		}
+
+		node->categoryBits = bits;
+		MarkChanged(index);
+		index = node->parent;
+	}
+}
+
 void b2DynamicTree::DestroyProxy(int32 proxyId)
 {
 	b2Assert(0 <= proxyId && proxyId < m_nodeCapacity);
@@ -133,16 +294,46 @@ bool b2DynamicTree::MoveProxy(int32 proxyId, const b2AABB& aabb, const b2Vec2& d
 
 	b2Assert(m_nodes[proxyId].IsLeaf());
 
+	// The proxy's user has moved even if its fat AABB stays put.
+	MarkChanged(proxyId);
+
 	if (m_nodes[proxyId].aabb.Contains(aabb))
 	{
 		return false;
 	}
 
-	RemoveLeaf(proxyId);
+	b2AABB b;
+	ComputeFatAABB(&b, aabb, displacement, b2_aabbExtension);
+	UpdateLeaf(proxyId, b);
+	return true;
+}
+
+bool b2DynamicTree::MoveProxy(int32 proxyId, const b2AABB& aabb, const b2Vec2& displacement, float32 extension)
+{
+	b2Assert(0 <= proxyId && proxyId < m_nodeCapacity);
 
+	b2Assert(m_nodes[proxyId].IsLeaf());
+
+	MarkChanged(proxyId);
+
+	b2AABB b;
+	ComputeFatAABB(&b, aabb, displacement, extension);
+
+	const b2AABB& fatAABB = m_nodes[proxyId].aabb;
+	if (fatAABB.Contains(aabb) && fatAABB.GetPerimeter() <= b2_aabbShrinkRatio * b.GetPerimeter())
+	{
+		return false;
+	}
+
+	UpdateLeaf(proxyId, b);
+	return true;
+}
+
+void b2DynamicTree::ComputeFatAABB(b2AABB* fatAABB, const b2AABB& aabb, const b2Vec2& displacement, float32 extension) const
+{
 	// Extend AABB.
 	b2AABB b = aabb;
-	b2Vec2 r(b2_aabbExtension, b2_aabbExtension);
+	b2Vec2 r(extension, extension);
 	b.lowerBound = b.lowerBound - r;
 	b.upperBound = b.upperBound + r;
 
@@ -167,10 +358,198 @@ bool b2DynamicTree::MoveProxy(int32 proxyId, const b2AABB& aabb, const b2Vec2& d
 		b.upperBound.y += d.y;
 	}
 
-	m_nodes[proxyId].aabb = b;
+	*fatAABB = b;
+}
 
-	InsertLeaf(proxyId);
-	return true;
+// Give a leaf a new fat AABB, either by re-inserting it or by updating it in place.
+void b2DynamicTree::UpdateLeaf(int32 leaf, const b2AABB& fatAABB)
+{
+	if (m_refitEnabled == false)
+	{
+		RemoveLeaf(leaf);
+		m_nodes[leaf].aabb = fatAABB;
+		InsertLeaf(leaf);
+		return;
+	}
+
+	m_nodes[leaf].aabb = fatAABB;
+
+	// Enlarge the ancestors so queries stay correct until the next refit.
+	int32 index = m_nodes[leaf].parent;
+	while (index != b2_nullNode && m_nodes[index].aabb.Contains(fatAABB) == false)
+	{
+		float32 oldPerimeter = m_nodes[index].aabb.GetPerimeter();
+		m_nodes[index].aabb.Combine(fatAABB);
+		m_perimeterGrowth += m_nodes[index].aabb.GetPerimeter() - oldPerimeter;
+		MarkChanged(index);
+		index = m_nodes[index].parent;
+	}
+
+	if (m_nodes[leaf].refit == false)
+	{
+		m_nodes[leaf].refit = true;
+		BufferRefit(leaf);
+	}
+}
+
+void b2DynamicTree::SetChangeTracking(bool flag)
+{
+	m_trackChanges = flag;
+	m_changeCount = 0;
+
+	// Nothing was logged before now.
+	++m_generation;
+	m_fullChangeGeneration = m_generation;
+}
+
+void b2DynamicTree::AdvanceGeneration(uint32 oldestGeneration)
+{
+	// The log is in generation order, so drop the entries from the front.
+	int32 keep = 0;
+	while (keep < m_changeCount && m_changeLog[keep].generation <= oldestGeneration)
+	{
+		++keep;
+	}
+
+	m_changeCount -= keep;
+	memmove(m_changeLog, m_changeLog + keep, m_changeCount * sizeof(b2TreeChange));
+
+	++m_generation;
+}
+
+void b2DynamicTree::MarkChanged(int32 nodeId)
+{
+	++m_modifyCount;
+
+	b2TreeNode* node = m_nodes + nodeId;
+	if (m_trackChanges == false || node->generation == m_generation)
+	{
+		return;
+	}
+
+	node->generation = m_generation;
+
+	// Grow the log as needed.
+	if (m_changeCount == m_changeCapacity)
+	{
+		b2TreeChange* oldLog = m_changeLog;
+		int32 oldCapacity = m_changeCapacity;
+		m_changeCapacity *= 2;
+		m_changeLog = (b2TreeChange*)m_allocator.Allocate(m_changeCapacity * sizeof(b2TreeChange), b2_treeMemory);
+		memcpy(m_changeLog, oldLog, m_changeCount * sizeof(b2TreeChange));
+		m_allocator.Free(oldLog, oldCapacity * sizeof(b2TreeChange), b2_treeMemory);
+	}
+
+	m_changeLog[m_changeCount].nodeId = nodeId;
+	m_changeLog[m_changeCount].generation = m_generation;
+	++m_changeCount;
+}
+
+// Called when too much of the tree changes to be worth logging.
+void b2DynamicTree::MarkAllChanged()
+{
+	++m_modifyCount;
+
+	if (m_trackChanges)
+	{
+		m_changeCount = 0;
+		m_fullChangeGeneration = m_generation;
+	}
+}
+
+void b2DynamicTree::SetRefitEnabled(bool flag)
+{
+	if (flag == m_refitEnabled)
+	{
+		return;
+	}
+
+	if (flag == false)
+	{
+		// Leave the tree tight for incremental updates.
+		Refit();
+	}
+
+	m_refitEnabled = flag;
+	m_basePerimeter = ComputeInternalPerimeter();
+	m_perimeterGrowth = 0.0f;
+}
+
+void b2DynamicTree::SetRebuildRatio(float32 ratio)
+{
+	b2Assert(ratio > 0.0f);
+	m_rebuildRatio = ratio;
+}
+
+void b2DynamicTree::BufferRefit(int32 nodeId)
+{
+	if (m_refitCount == m_refitCapacity)
+	{
+		int32* oldBuffer = m_refitBuffer;
+		int32 oldCapacity = m_refitCapacity;
+		m_refitCapacity *= 2;
+		m_refitBuffer = (int32*)m_allocator.Allocate(m_refitCapacity * sizeof(int32), b2_treeMemory);
+		memcpy(m_refitBuffer, oldBuffer, m_refitCount * sizeof(int32));
+		m_allocator.Free(oldBuffer, oldCapacity * sizeof(int32), b2_treeMemory);
+	}
+
+	m_refitBuffer[m_refitCount] = nodeId;
+	++m_refitCount;
+}
+
+void b2DynamicTree::Refit()
+{
+	if (m_refitCount == 0)
+	{
+		return;
+	}
+
+	// Gather the ancestors of the moved leaves behind them in the buffer. Each
+	// ancestor is gathered once, so shared ancestors are only refit once.
+	int32 leafCount = m_refitCount;
+	for (int32 i = 0; i < leafCount; ++i)
+	{
+		int32 leaf = m_refitBuffer[i];
+		if (m_nodes[leaf].refit == false)
+		{
+			// Destroyed or already handled.
+			continue;
+		}
+
+		m_nodes[leaf].refit = false;
+
+		int32 index = m_nodes[leaf].parent;
+		while (index != b2_nullNode && m_nodes[index].refit == false)
+		{
+			m_nodes[index].refit = true;
+			BufferRefit(index);
+			index = m_nodes[index].parent;
+		}
+	}
+
+	// A parent is always higher than its children.
+	b2RefitHeightLess less;
+	less.nodes = m_nodes;
+	std::sort(m_refitBuffer + leafCount, m_refitBuffer + m_refitCount, less);
+
+	for (int32 i = leafCount; i < m_refitCount; ++i)
+	{
+		b2TreeNode* node = m_nodes + m_refitBuffer[i];
+		b2Assert(node->IsLeaf() == false);
+
+		float32 oldPerimeter = node->aabb.GetPerimeter();
+		node->aabb.Combine(m_nodes[node->child1].aabb, m_nodes[node->child2].aabb);
+		m_perimeterGrowth += node->aabb.GetPerimeter() - oldPerimeter;
+		node->refit = false;
+		MarkChanged(m_refitBuffer[i]);
+	}
+
+	m_refitCount = 0;
+
+	if (m_perimeterGrowth > m_rebuildRatio * m_basePerimeter)
+	{
+		RebuildTopDown();
+	}
 }
 
 void b2DynamicTree::InsertLeaf(int32 leaf)
@@ -264,10 +643,12 @@ void b2DynamicTree::InsertLeaf(int32 leaf)
 	m_nodes[newParent].userData = NULL;
 	m_nodes[newParent].aabb.Combine(leafAABB, m_nodes[sibling].aabb);
 	m_nodes[newParent].height = m_nodes[sibling].height + 1;
+	m_nodes[newParent].categoryBits = m_nodes[leaf].categoryBits | m_nodes[sibling].categoryBits;
 
 	if (oldParent != b2_nullNode)
 	{
 		// The sibling was not the root.
+		MarkChanged(oldParent);
 		if (m_nodes[oldParent].child1 == sibling)
 		{
 			m_nodes[oldParent].child1 = newParent;
@@ -306,6 +687,8 @@ void b2DynamicTree::InsertLeaf(int32 leaf)
 
 		m_nodes[index].height = 1 + b2Max(m_nodes[child1].height, m_nodes[child2].height);
 		m_nodes[index].aabb.Combine(m_nodes[child1].aabb, m_nodes[child2].aabb);
+		m_nodes[index].categoryBits = m_nodes[child1].categoryBits | m_nodes[child2].categoryBits;
+		MarkChanged(index);
 
 		index = m_nodes[index].parent;
 	}
@@ -358,6 +741,8 @@ void b2DynamicTree::RemoveLeaf(int32 leaf)
 
 			m_nodes[index].aabb.Combine(m_nodes[child1].aabb, m_nodes[child2].aabb);
 			m_nodes[index].height = 1 + b2Max(m_nodes[child1].height, m_nodes[child2].height);
+			m_nodes[index].categoryBits = m_nodes[child1].categoryBits | m_nodes[child2].categoryBits;
+			MarkChanged(index);
 
 			index = m_nodes[index].parent;
 		}
@@ -397,6 +782,9 @@ int32 b2DynamicTree::Balance(int32 iA)
 	// Rotate C up
 	if (balance > 1)
 	{
+		MarkChanged(iA);
+		MarkChanged(iC);
+
 		int32 iF = C->child1;
 		int32 iG = C->child2;
 		b2TreeNode* F = m_nodes + iF;
@@ -435,6 +823,8 @@ int32 b2DynamicTree::Balance(int32 iA)
 			G->parent = iA;
 			A->aabb.Combine(B->aabb, G->aabb);
 			C->aabb.Combine(A->aabb, F->aabb);
+			A->categoryBits = B->categoryBits | G->categoryBits;
+			C->categoryBits = A->categoryBits | F->categoryBits;
 
 			A->height = 1 + b2Max(B->height, G->height);
 			C->height = 1 + b2Max(A->height, F->height);
@@ -446,6 +836,8 @@ int32 b2DynamicTree::Balance(int32 iA)
 			F->parent = iA;
 			A->aabb.Combine(B->aabb, F->aabb);
 			C->aabb.Combine(A->aabb, G->aabb);
+			A->categoryBits = B->categoryBits | F->categoryBits;
+			C->categoryBits = A->categoryBits | G->categoryBits;
 
 			A->height = 1 + b2Max(B->height, F->height);
 			C->height = 1 + b2Max(A->height, G->height);
@@ -457,6 +849,9 @@ int32 b2DynamicTree::Balance(int32 iA)
 	// Rotate B up
 	if (balance < -1)
 	{
+		MarkChanged(iA);
+		MarkChanged(iB);
+
 		int32 iD = B->child1;
 		int32 iE = B->child2;
 		b2TreeNode* D = m_nodes + iD;
@@ -495,6 +890,8 @@ int32 b2DynamicTree::Balance(int32 iA)
 			E->parent = iA;
 			A->aabb.Combine(C->aabb, E->aabb);
 			B->aabb.Combine(A->aabb, D->aabb);
+			A->categoryBits = C->categoryBits | E->categoryBits;
+			B->categoryBits = A->categoryBits | D->categoryBits;
 
 			A->height = 1 + b2Max(C->height, E->height);
 			B->height = 1 + b2Max(A->height, D->height);
@@ -506,6 +903,8 @@ int32 b2DynamicTree::Balance(int32 iA)
 			D->parent = iA;
 			A->aabb.Combine(C->aabb, D->aabb);
 			B->aabb.Combine(A->aabb, E->aabb);
+			A->categoryBits = C->categoryBits | D->categoryBits;
+			B->categoryBits = A->categoryBits | E->categoryBits;
 
 			A->height = 1 + b2Max(C->height, D->height);
 			B->height = 1 + b2Max(A->height, E->height);
@@ -646,6 +1045,8 @@ void b2DynamicTree::ValidateMetrics(int32 index) const
 	b2Assert(aabb.lowerBound == node->aabb.lowerBound);
 	b2Assert(aabb.upperBound == node->aabb.upperBound);
 
+	b2Assert(node->categoryBits == (m_nodes[child1].categoryBits | m_nodes[child2].categoryBits));
+
 	ValidateMetrics(child1);
 	ValidateMetrics(child2);
 }
@@ -693,7 +1094,10 @@ int32 b2DynamicTree::GetMaxBalance() const
 
 void b2DynamicTree::RebuildBottomUp()
 {
-	int32* nodes = (int32*)b2Alloc(m_nodeCount * sizeof(int32));
+	MarkAllChanged();
+
+	int32 bufferSize = m_nodeCount * sizeof(int32);
+	int32* nodes = (int32*)m_allocator.Allocate(bufferSize, b2_treeMemory);
 	int32 count = 0;
 
 	// Build array of leaves. Free the rest.
@@ -751,6 +1155,7 @@ void b2DynamicTree::RebuildBottomUp()
 		parent->child2 = index2;
 		parent->height = 1 + b2Max(child1->height, child2->height);
 		parent->aabb.Combine(child1->aabb, child2->aabb);
+		parent->categoryBits = child1->categoryBits | child2->categoryBits;
 		parent->parent = b2_nullNode;
 
 		child1->parent = parentIndex;
@@ -762,13 +1167,246 @@ void b2DynamicTree::RebuildBottomUp()
 	}
 
 	m_root = nodes[0];
-	b2Free(nodes);
+	m_allocator.Free(nodes, bufferSize, b2_treeMemory);
 
 	Validate();
 }
 
+void b2DynamicTree::RebuildTopDown()
+{
+	if (m_root == b2_nullNode)
+	{
+		return;
+	}
+
+	MarkAllChanged();
+
+	int32 bufferSize = m_nodeCount * sizeof(int32);
+	int32* leaves = (int32*)m_allocator.Allocate(bufferSize, b2_treeMemory);
+	int32 count = 0;
+
+	// Build array of leaves. Free the rest.
+	for (int32 i = 0; i < m_nodeCapacity; ++i)
+	{
+		if (m_nodes[i].height < 0)
+		{
+			// free node in pool
+			continue;
+		}
+
+		if (m_nodes[i].IsLeaf())
+		{
+			m_nodes[i].parent = b2_nullNode;
+			m_nodes[i].refit = false;
+			leaves[count] = i;
+			++count;
+		}
+		else
+		{
+			FreeNode(i);
+		}
+	}
+
+	m_root = BuildTopDown(leaves, count, 0);
+	m_nodes[m_root].parent = b2_nullNode;
+	m_allocator.Free(leaves, bufferSize, b2_treeMemory);
+
+	// Internal nodes were freed, so there is nothing left to refit.
+	m_refitCount = 0;
+	m_basePerimeter = ComputeInternalPerimeter();
+	m_perimeterGrowth = 0.0f;
+}
+
+// Build a sub-tree over the given leaves and return its root.
+int32 b2DynamicTree::BuildTopDown(int32* leaves, int32 count, int32 depth)
+{
+	b2Assert(count > 0);
+	if (count == 1)
+	{
+		return leaves[0];
+	}
+
+	const int32 binCount = 16;
+
+	// Bound the leaf centers and split along the longest axis.
+	b2Vec2 lower = m_nodes[leaves[0]].aabb.GetCenter();
+	b2Vec2 upper = lower;
+	for (int32 i = 1; i < count; ++i)
+	{
+		b2Vec2 c = m_nodes[leaves[i]].aabb.GetCenter();
+		lower = b2Min(lower, c);
+		upper = b2Max(upper, c);
+	}
+
+	b2Vec2 extent = upper - lower;
+	int32 axis = extent.x > extent.y ? 0 : 1;
+	float32 axisLower = axis == 0 ? lower.x : lower.y;
+	float32 axisExtent = axis == 0 ? extent.x : extent.y;
+
+	int32 split = 0;
+
+	// Deep sub-trees fall back to median splits to bound the recursion.
+	if (axisExtent > b2_epsilon && depth < 32)
+	{
+		// Bin the leaves by center.
+		b2AABB binAABBs[binCount];
+		int32 binCounts[binCount];
+		for (int32 i = 0; i < binCount; ++i)
+		{
+			binCounts[i] = 0;
+		}
+
+		float32 binScale = binCount / axisExtent;
+		for (int32 i = 0; i < count; ++i)
+		{
+			const b2AABB& aabb = m_nodes[leaves[i]].aabb;
+			b2Vec2 c = aabb.GetCenter();
+			int32 bin = int32(((axis == 0 ? c.x : c.y) - axisLower) * binScale);
+			bin = b2Clamp(bin, 0, binCount - 1);
+			if (binCounts[bin] == 0)
+			{
+				binAABBs[bin] = aabb;
+			}
+			else
+			{
+				binAABBs[bin].Combine(aabb);
+			}
+			++binCounts[bin];
+		}
+
+		// Sweep from the right to get the cost of each right side.
+		float32 rightCosts[binCount];
+		b2AABB right;
+		right.lowerBound.SetZero();
+		right.upperBound.SetZero();
+		int32 rightCount = 0;
+		for (int32 i = binCount - 1; i > 0; --i)
+		{
+			if (binCounts[i] > 0)
+			{
+				if (rightCount == 0)
+				{
+					right = binAABBs[i];
+				}
+				else
+				{
+					right.Combine(binAABBs[i]);
+				}
+				rightCount += binCounts[i];
+			}
+			rightCosts[i] = rightCount > 0 ? rightCount * right.GetPerimeter() : 0.0f;
+		}
+
+		// Sweep from the left and find the cheapest split plane.
+		float32 minCost = b2_maxFloat;
+		int32 bestBin = -1;
+		b2AABB left;
+		left.lowerBound.SetZero();
+		left.upperBound.SetZero();
+		int32 leftCount = 0;
+		for (int32 i = 0; i < binCount - 1; ++i)
+		{
+			if (binCounts[i] > 0)
+			{
+				if (leftCount == 0)
+				{
+					left = binAABBs[i];
+				}
+				else
+				{
+					left.Combine(binAABBs[i]);
+				}
+				leftCount += binCounts[i];
+			}
+
+			if (leftCount == 0 || leftCount == count)
+			{
+				continue;
+			}
+
+			float32 cost = leftCount * left.GetPerimeter() + rightCosts[i + 1];
+			if (cost < minCost)
+			{
+				minCost = cost;
+				bestBin = i;
+			}
+		}
+
+		// Partition the leaves around the split plane.
+		if (bestBin >= 0)
+		{
+			int32 i = 0;
+			int32 j = count - 1;
+			while (i <= j)
+			{
+				b2Vec2 c = m_nodes[leaves[i]].aabb.GetCenter();
+				int32 bin = int32(((axis == 0 ? c.x : c.y) - axisLower) * binScale);
+				bin = b2Clamp(bin, 0, binCount - 1);
+				if (bin <= bestBin)
+				{
+					++i;
+				}
+				else
+				{
+					b2Swap(leaves[i], leaves[j]);
+					--j;
+				}
+			}
+			split = i;
+		}
+	}
+
+	if (split == 0 || split == count)
+	{
+		// Median split.
+		split = count / 2;
+		b2LeafCenterLess less;
+		less.nodes = m_nodes;
+		less.axis = axis;
+		std::nth_element(leaves, leaves + split, leaves + count, less);
+	}
+
+	int32 child1 = BuildTopDown(leaves, split, depth + 1);
+	int32 child2 = BuildTopDown(leaves + split, count - split, depth + 1);
+
+	int32 parentIndex = AllocateNode();
+	b2TreeNode* parent = m_nodes + parentIndex;
+	parent->child1 = child1;
+	parent->child2 = child2;
+	parent->height = 1 + b2Max(m_nodes[child1].height, m_nodes[child2].height);
+	parent->aabb.Combine(m_nodes[child1].aabb, m_nodes[child2].aabb);
+	parent->categoryBits = m_nodes[child1].categoryBits | m_nodes[child2].categoryBits;
+	parent->parent = b2_nullNode;
+
+	m_nodes[child1].parent = parentIndex;
+	m_nodes[child2].parent = parentIndex;
+
+	return parentIndex;
+}
+
+// Sum the perimeters of the internal nodes. This is the refit quality baseline.
+float32 b2DynamicTree::ComputeInternalPerimeter() const
+{
+	float32 perimeter = 0.0f;
+	for (int32 i = 0; i < m_nodeCapacity; ++i)
+	{
+		const b2TreeNode* node = m_nodes + i;
+		if (node->height <= 0)
+		{
+			// Free node or leaf
+			continue;
+		}
+
+		perimeter += node->aabb.GetPerimeter();
+	}
+
+	return perimeter;
+}
+
 void b2DynamicTree::ShiftOrigin(const b2Vec2& newOrigin)
 {
+	MarkAllChanged();
+
 	// Build array of leaves. Free the rest.
 	for (int32 i = 0; i < m_nodeCapacity; ++i)
 	{
@@ -20,10 +20,41 @@
 #define B2_DYNAMIC_TREE_H
 
 #include <Box2D/Collision/b2Collision.h>
+#include <Box2D/Common/b2Allocator.h>
 #include <Box2D/Common/b2GrowableStack.h>
 
 #define b2_nullNode (-1)
 
+/// A category mask that matches every proxy, including proxies whose category bits
+/// are zero. Queries without a mask use it, so they never look at category bits.
+#define b2_allCategories 0xFFFF
+
+/// Can a sub-tree whose proxies have these category bits be skipped by a query
+/// with this mask?
+inline bool b2MaskExcludes(uint16 categoryBits, uint16 maskBits)
+{
+	return maskBits != b2_allCategories && (categoryBits & maskBits) == 0;
+}
+
+/// How much work a tree query did. Ray-casts return these so the cost of a ray can
+/// be measured without a profiler.
+struct b2TreeStats
+{
+	int32 nodeVisits;	///< nodes whose bounds were tested
+	int32 leafVisits;	///< leaves passed to the callback
+};
+
+/// Implement this class to see which nodes a ray-cast tests, e.g. to debug draw the
+/// parts of a tree that a ray pays for.
+class b2TreeNodeCallback
+{
+public:
+	virtual ~b2TreeNodeCallback() {}
+
+	/// Called with the bounds of each node as its bounds are tested.
+	virtual void ReportNode(const b2AABB& aabb) = 0;
+};
+
 /// A node in the dynamic tree. The client does not interact with this directly.
 struct b2TreeNode
 {
@@ -48,6 +79,22 @@ struct b2TreeNode
 
 	// leaf = 0, free node = -1
 	int32 height;
+
+	/// The union of the category bits in this sub-tree.
+	uint16 categoryBits;
+
+	// Set while the node is waiting to be refit.
+	bool refit;
+
+	// The change tracking generation in which the node last changed.
+	uint32 generation;
+};
+
+/// An entry in the change log of a dynamic tree.
+struct b2TreeChange
+{
+	int32 nodeId;
+	uint32 generation;
 };
 
 /// A dynamic AABB tree broad-phase, inspired by Nathanael Presson's btDbvt.
@@ -61,24 +108,88 @@ struct b2TreeNode
 class b2DynamicTree
 {
 public:
-	/// Constructing the tree initializes the node pool.
-	b2DynamicTree();
+	/// Constructing the tree initializes the node pool. The pool and the tree's buffers
+	/// come from the allocator.
+	explicit b2DynamicTree(const b2Allocator& allocator = b2Allocator());
 
 	/// Destroy the tree, freeing the node pool.
 	~b2DynamicTree();
 
+	/// Remove every proxy at once. The node pool is kept for reuse.
+	void Clear();
+
 	/// Create a proxy. Provide a tight fitting AABB and a userData pointer.
+	/// The proxy matches any query mask.
 	int32 CreateProxy(const b2AABB& aabb, void* userData);
 
+	/// Create a proxy with collision category bits. Masked queries and ray casts
+	/// skip proxies and whole sub-trees whose category bits miss the mask.
+	int32 CreateProxy(const b2AABB& aabb, void* userData, uint16 categoryBits);
+
+	/// Create many proxies at once. The new leaves are built into a sub-tree top-down
+	/// and the sub-tree is joined to the tree under a new root, so this is O(n log n)
+	/// in the number of new proxies and doesn't touch the existing nodes.
+	/// Batches that overlap existing proxies make the tree worse than inserting them
+	/// one by one; call RebuildTopDown after loading several such batches.
+	/// @param proxyIds receives the new proxy ids, in the order of the inputs.
+	void CreateProxies(const b2AABB* aabbs, void* const* userData, const uint16* categoryBits,
+					   int32 count, int32* proxyIds);
+
 	/// Destroy a proxy. This asserts if the id is invalid.
 	void DestroyProxy(int32 proxyId);
 
 	/// Move a proxy with a swepted AABB. If the proxy has moved outside of its fattened AABB,
 	/// then the proxy is removed from the tree and re-inserted. Otherwise
-	/// the function returns immediately.
-	/// @return true if the proxy was re-inserted.
+	/// the function returns immediately. In refit mode the proxy is updated in place
+	/// instead and its ancestors are enlarged to contain it.
+	/// @return true if the proxy was re-inserted or updated.
 	bool MoveProxy(int32 proxyId, const b2AABB& aabb1, const b2Vec2& displacement);
 
+	/// Move a proxy using a custom fattening margin instead of b2_aabbExtension. The proxy
+	/// is also updated when its fat AABB has grown b2_aabbShrinkRatio times larger
+	/// than the margin requires, so proxies that slow down get tighter boxes.
+	/// @return true if the proxy was re-inserted or updated.
+	bool MoveProxy(int32 proxyId, const b2AABB& aabb1, const b2Vec2& displacement, float32 extension);
+
+	/// Enable/disable refit mode. In refit mode moved proxies keep their place in the
+	/// tree and Refit tightens their ancestors in one bottom-up pass. This avoids
+	/// remove/insert churn when many proxies move by small amounts.
+	void SetRefitEnabled(bool flag);
+	bool IsRefitEnabled() const { return m_refitEnabled; }
+
+	/// Set the ratio of internal node perimeter growth that triggers a rebuild in refit mode.
+	/// The default is b2_treeRebuildRatio.
+	void SetRebuildRatio(float32 ratio);
+	float32 GetRebuildRatio() const { return m_rebuildRatio; }
+
+	/// Refit the ancestors of the proxies moved since the last call. If the refits
+	/// have degraded the tree past the rebuild ratio the tree is rebuilt top-down.
+	/// The tree must be refit before it is queried for pairs.
+	void Refit();
+
+	/// Enable/disable change tracking. While enabled every node that changes is logged
+	/// once per generation, so a copy of the tree can be brought up to date by copying
+	/// only the logged nodes. Moving a proxy always logs it.
+	void SetChangeTracking(bool flag);
+	bool IsChangeTracking() const { return m_trackChanges; }
+
+	/// Get the current change tracking generation.
+	uint32 GetGeneration() const { return m_generation; }
+
+	/// Start a new generation of changes. Log entries from the oldest generation any
+	/// copy still needs and earlier are dropped.
+	void AdvanceGeneration(uint32 oldestGeneration);
+
+	/// Get a counter that changes whenever the tree changes. Copies of the tree can
+	/// compare it to know when they are out of date.
+	uint32 GetModifyCount() const { return m_modifyCount; }
+
+	/// Get the size of the node pool.
+	int32 GetNodeCapacity() const { return m_nodeCapacity; }
+
+	/// Get the bytes held by the node pool and the refit and change buffers.
+	int32 GetByteCount() const;
+
 	/// Get proxy user data.
 	/// @return the proxy user data or 0 if the id is invalid.
 	void* GetUserData(int32 proxyId) const;
@@ -86,11 +197,22 @@ public:
 	/// Get the fat AABB for a proxy.
 	const b2AABB& GetFatAABB(int32 proxyId) const;
 
+	/// Set the category bits of a proxy and update its ancestors.
+	void SetCategoryBits(int32 proxyId, uint16 categoryBits);
+
+	/// Get the category bits of a proxy.
+	uint16 GetCategoryBits(int32 proxyId) const;
+
 	/// Query an AABB for overlapping proxies. The callback class
 	/// is called for each proxy that overlaps the supplied AABB.
 	template <typename T>
 	void Query(T* callback, const b2AABB& aabb) const;
 
+	/// Query an AABB for overlapping proxies whose category bits match the mask.
+	/// b2_allCategories matches every proxy.
+	template <typename T>
+	void Query(T* callback, const b2AABB& aabb, uint16 maskBits) const;
+
 	/// Ray-cast against the proxies in the tree. This relies on the callback
 	/// to perform a exact ray-cast in the case were the proxy contains a shape.
 	/// The callback also performs the any collision filtering. This has performance
@@ -98,8 +220,16 @@ public:
 	/// number of proxies in the tree.
 	/// @param input the ray-cast input data. The ray extends from p1 to p1 + maxFraction * (p2 - p1).
 	/// @param callback a callback class that is called for each proxy that is hit by the ray.
+	/// @return how many nodes and leaves the ray visited.
+	template <typename T>
+	b2TreeStats RayCast(T* callback, const b2RayCastInput& input) const;
+
+	/// Ray-cast against the proxies whose category bits match the mask.
+	/// Sub-trees without a matching proxy are skipped.
+	/// @param nodeCallback optionally told about every node the ray visits.
 	template <typename T>
-	void RayCast(T* callback, const b2RayCastInput& input) const;
+	b2TreeStats RayCast(T* callback, const b2RayCastInput& input, uint16 maskBits,
+						b2TreeNodeCallback* nodeCallback = NULL) const;
 
 	/// Validate this tree. For testing.
 	void Validate() const;
@@ -118,6 +248,10 @@ public:
 	/// Build an optimal tree. Very expensive. For testing.
 	void RebuildBottomUp();
 
+	/// Build a good tree top-down using binned surface area heuristic splits.
+	/// This is O(n log n) and is used to recover from refit degradation.
+	void RebuildTopDown();
+
 	/// Shift the world origin. Useful for large worlds.
 	/// The shift formula is: position -= newOrigin
 	/// @param newOrigin the new origin with respect to the old origin
@@ -125,20 +259,36 @@ public:
 
 private:
 
+	friend class b2CompressedTree;
+	friend class b2QuerySnapshot;
+	friend class b2World;
+
 	int32 AllocateNode();
 	void FreeNode(int32 node);
 
+	void MarkChanged(int32 nodeId);
+	void MarkAllChanged();
+
 	void InsertLeaf(int32 node);
 	void RemoveLeaf(int32 node);
 
+	void ComputeFatAABB(b2AABB* fatAABB, const b2AABB& aabb, const b2Vec2& displacement, float32 extension) const;
+	void UpdateLeaf(int32 leaf, const b2AABB& fatAABB);
+
 	int32 Balance(int32 index);
 
+	int32 BuildTopDown(int32* leaves, int32 count, int32 depth);
+	void BufferRefit(int32 nodeId);
+	float32 ComputeInternalPerimeter() const;
+
 	int32 ComputeHeight() const;
 	int32 ComputeHeight(int32 nodeId) const;
 
 	void ValidateStructure(int32 index) const;
 	void ValidateMetrics(int32 index) const;
 
+	b2Allocator m_allocator;
+
 	int32 m_root;
 
 	b2TreeNode* m_nodes;
@@ -151,8 +301,35 @@ private:
 	uint32 m_path;
 
 	int32 m_insertionCount;
+
+	bool m_refitEnabled;
+	int32* m_refitBuffer;
+	int32 m_refitCapacity;
+	int32 m_refitCount;
+
+	/// The rebuild ratio compares the perimeter growth since the last rebuild
+	/// to the summed perimeter of the internal nodes at that rebuild.
+	float32 m_rebuildRatio;
+	float32 m_basePerimeter;
+	float32 m_perimeterGrowth;
+
+	bool m_trackChanges;
+	uint32 m_generation;
+	/// Copies from before this generation can't be updated from the log.
+	uint32 m_fullChangeGeneration;
+	b2TreeChange* m_changeLog;
+	int32 m_changeCount;
+	int32 m_changeCapacity;
+
+	uint32 m_modifyCount;
 };
 
+inline int32 b2DynamicTree::GetByteCount() const
+{
+	return m_nodeCapacity * sizeof(b2TreeNode) + m_refitCapacity * sizeof(int32) +
+		m_changeCapacity * sizeof(b2TreeChange);
+}
+
 inline void* b2DynamicTree::GetUserData(int32 proxyId) const
 {
 	b2Assert(0 <= proxyId && proxyId < m_nodeCapacity);
@@ -165,8 +342,20 @@ inline const b2AABB& b2DynamicTree::GetFatAABB(int32 proxyId) const
 	return m_nodes[proxyId].aabb;
 }
 
+inline uint16 b2DynamicTree::GetCategoryBits(int32 proxyId) const
+{
+	b2Assert(0 <= proxyId && proxyId < m_nodeCapacity);
+	return m_nodes[proxyId].categoryBits;
+}
+
 template <typename T>
 inline void b2DynamicTree::Query(T* callback, const b2AABB& aabb) const
+{
+	Query(callback, aabb, b2_allCategories);
+}
+
+template <typename T>
+inline void b2DynamicTree::Query(T* callback, const b2AABB& aabb, uint16 maskBits) const
 {
 	b2GrowableStack<int32, 256> stack;
 	stack.Push(m_root);
@@ -181,6 +370,11 @@ inline void b2DynamicTree::Query(T* callback, const b2AABB& aabb) const
 
 		const b2TreeNode* node = m_nodes + nodeId;
 
+		if (b2MaskExcludes(node->categoryBits, maskBits))
+		{
+			continue;
+		}
+
 		if (b2TestOverlap(node->aabb, aabb))
 		{
 			if (node->IsLeaf())
@@ -201,8 +395,17 @@ inline void b2DynamicTree::Query(T* callback, const b2AABB& aabb) const
 }
 
 template <typename T>
-inline void b2DynamicTree::RayCast(T* callback, const b2RayCastInput& input) const
+inline b2TreeStats b2DynamicTree::RayCast(T* callback, const b2RayCastInput& input) const
+{
+	return RayCast(callback, input, b2_allCategories);
+}
+
+template <typename T>
+inline b2TreeStats b2DynamicTree::RayCast(T* callback, const b2RayCastInput& input, uint16 maskBits,
+										  b2TreeNodeCallback* nodeCallback) const
 {
+	b2TreeStats stats = { 0, 0 };
+
 	b2Vec2 p1 = input.p1;
 	b2Vec2 p2 = input.p2;
 	b2Vec2 r = p2 - p1;
@@ -239,6 +442,17 @@ inline void b2DynamicTree::RayCast(T* callback, const b2RayCastInput& input) con
 
 		const b2TreeNode* node = m_nodes + nodeId;
 
+		if (b2MaskExcludes(node->categoryBits, maskBits))
+		{
+			continue;
+		}
+
+		++stats.nodeVisits;
+		if (nodeCallback)
+		{
+			nodeCallback->ReportNode(node->aabb);
+		}
+
 		if (b2TestOverlap(node->aabb, segmentAABB) == false)
 		{
 			continue;
@@ -261,12 +475,13 @@ inline void b2DynamicTree::RayCast(T* callback, const b2RayCastInput& input) con
 			subInput.p2 = input.p2;
 			subInput.maxFraction = maxFraction;
 
+			++stats.leafVisits;
 			float32 value = callback->RayCastCallback(subInput, nodeId);
 
 			if (value == 0.0f)
 			{
 				// The client has terminated the ray cast.
-				return;
+				return stats;
 			}
 
 			if (value > 0.0f)
@@ -284,6 +499,8 @@ inline void b2DynamicTree::RayCast(T* callback, const b2RayCastInput& input) con
 			stack.Push(node->child2);
 		}
 	}
+
+	return stats;
 }
 
 #endif
@@ -19,7 +19,9 @@
 #include <Box2D/Collision/b2Collision.h>
 #include <Box2D/Collision/b2Distance.h>
 #include <Box2D/Collision/b2TimeOfImpact.h>
+#include <Box2D/Collision/Shapes/b2ChainShape.h>
 #include <Box2D/Collision/Shapes/b2CircleShape.h>
+#include <Box2D/Collision/Shapes/b2EdgeShape.h>
 #include <Box2D/Collision/Shapes/b2PolygonShape.h>
 #include <Box2D/Common/b2Timer.h>
 
@@ -484,3 +486,72 @@ void b2TimeOfImpact(b2TOIOutput* output, const b2TOIInput* input)
 	b2_toiMaxTime = b2Max(b2_toiMaxTime, time);
 	b2_toiTime += time;
 }
+
+// Computes the time of impact with each segment the shape can reach and keeps the earliest.
+struct b2SegmentTOICallback
+{
+	bool QuerySegment(int32 index)
+	{
+		b2EdgeShape edge;
+		chain->GetChildEdge(&edge, index);
+		input->proxyA.Set(&edge, 0);
+
+		b2TOIOutput segmentOutput;
+		b2TimeOfImpact(&segmentOutput, input);
+
+		if (segmentOutput.state == b2TOIOutput::e_touching &&
+			(output->state != b2TOIOutput::e_touching || segmentOutput.t < output->t))
+		{
+			*output = segmentOutput;
+		}
+
+		return true;
+	}
+
+	const b2ChainShape* chain;
+	b2TOIInput* input;
+	b2TOIOutput* output;
+};
+
+void b2TimeOfImpact(b2TOIOutput* output,
+					const b2ChainShape* chainA, const b2Sweep& sweepA,
+					const b2Shape* shapeB, int32 indexB, const b2Sweep& sweepB,
+					float32 tMax)
+{
+	output->state = b2TOIOutput::e_separated;
+	output->t = tMax;
+
+	// The shape stays within its bounding radius of its center of mass.
+	b2Transform identity;
+	identity.SetIdentity();
+	b2AABB localAABB;
+	shapeB->ComputeAABB(&localAABB, identity, indexB);
+	b2Vec2 extents = b2Max(b2Abs(localAABB.lowerBound - sweepB.localCenter),
+						   b2Abs(localAABB.upperBound - sweepB.localCenter));
+	float32 radius = extents.Length() + chainA->m_radius + b2_linearSlop;
+
+	// Bound the path of the center in the frame of the chain.
+	b2Transform xfA1, xfA2, xfB1, xfB2;
+	sweepA.GetTransform(&xfA1, 0.0f);
+	sweepA.GetTransform(&xfA2, tMax);
+	sweepB.GetTransform(&xfB1, 0.0f);
+	sweepB.GetTransform(&xfB2, tMax);
+	b2Vec2 c1 = b2MulT(xfA1, b2Mul(xfB1, sweepB.localCenter));
+	b2Vec2 c2 = b2MulT(xfA2, b2Mul(xfB2, sweepB.localCenter));
+
+	b2AABB aabb;
+	aabb.lowerBound = b2Min(c1, c2) - b2Vec2(radius, radius);
+	aabb.upperBound = b2Max(c1, c2) + b2Vec2(radius, radius);
+
+	b2TOIInput input;
+	input.proxyB.Set(shapeB, indexB);
+	input.sweepA = sweepA;
+	input.sweepB = sweepB;
+	input.tMax = tMax;
+
+	b2SegmentTOICallback callback;
+	callback.chain = chainA;
+	callback.input = &input;
+	callback.output = output;
+	chainA->QuerySegments(&callback, aabb);
+}
@@ -22,6 +22,8 @@
 #include <Box2D/Common/b2Math.h>
 #include <Box2D/Collision/b2Distance.h>
 
+class b2ChainShape;
+
 /// Input parameters for b2TimeOfImpact
 struct b2TOIInput
 {
@@ -55,4 +57,12 @@ struct b2TOIOutput
 /// Note: use b2Distance to compute the contact point and normal at the time of impact.
 void b2TimeOfImpact(b2TOIOutput* output, const b2TOIInput* input);
 
+/// Compute the time of impact between a chain with a segment tree and a child of another
+/// shape. This is the earliest impact with any segment the shape can reach during the
+/// sweeps, assuming the chain doesn't rotate much over the interval.
+void b2TimeOfImpact(b2TOIOutput* output,
+					const b2ChainShape* chainA, const b2Sweep& sweepA,
+					const b2Shape* shapeB, int32 indexB, const b2Sweep& sweepB,
+					float32 tMax);
+
 #endif
@@ -0,0 +1,57 @@
+/*
+* Copyright (c) 2006-2011 Erin Catto http://www.box2d.org
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include <Box2D/Common/b2Allocator.h>
+#include <stddef.h>
+
+// The default callbacks over-allocate through b2Alloc and keep the address it returned
+// just below the aligned block, so any alignment works with any b2Alloc.
+static void* b2DefaultAlloc(int32 size, int32 alignment, b2MemoryTag tag, void* context)
+{
+	B2_NOT_USED(tag);
+	B2_NOT_USED(context);
+
+	int8* mem = (int8*)b2Alloc(size + alignment + (int32)sizeof(void*));
+	if (mem == NULL)
+	{
+		return NULL;
+	}
+
+	size_t address = (size_t)(mem + sizeof(void*));
+	address = (address + alignment - 1) & ~(size_t)(alignment - 1);
+	void** aligned = (void**)address;
+	aligned[-1] = mem;
+	return aligned;
+}
+
+static void b2DefaultFree(void* mem, int32 size, int32 alignment, b2MemoryTag tag, void* context)
+{
+	B2_NOT_USED(size);
+	B2_NOT_USED(alignment);
+	B2_NOT_USED(tag);
+	B2_NOT_USED(context);
+
+	b2Free(((void**)mem)[-1]);
+}
+
+b2Allocator::b2Allocator()
+{
+	allocFcn = b2DefaultAlloc;
+	freeFcn = b2DefaultFree;
+	context = NULL;
+}
@@ -0,0 +1,86 @@
+/*
+* Copyright (c) 2006-2011 Erin Catto http://www.box2d.org
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef B2_ALLOCATOR_H
+#define B2_ALLOCATOR_H
+
+#include <Box2D/Common/b2Settings.h>
+
+/// The parts of a world that allocate memory through its b2Allocator. Every allocation
+/// is tagged so the allocator can attribute bytes or serve each part from its own pool.
+enum b2MemoryTag
+{
+	b2_blockMemory = 0,		///< block allocator chunks and large blocks
+	b2_stackMemory,			///< stack allocator segments
+	b2_treeMemory,			///< broad-phase tree nodes and buffers
+	b2_broadPhaseMemory,	///< broad-phase move, pair and proxy speed buffers
+	b2_snapshotMemory,		///< query snapshots
+	b2_worldMemory,			///< temporary world buffers
+	b2_memoryTagCount
+};
+
+/// The alignment of allocations that don't ask for one.
+#define b2_allocAlignment	16
+
+/// Allocation callback. Must return at least size bytes aligned to alignment, which
+/// is a power of two.
+typedef void* b2AllocFcn(int32 size, int32 alignment, b2MemoryTag tag, void* context);
+
+/// Free callback. Receives the size, alignment and tag the memory was allocated with.
+typedef void b2FreeFcn(void* mem, int32 size, int32 alignment, b2MemoryTag tag, void* context);
+
+/// The memory callbacks of a world. A world passes them on to its block and stack
+/// allocators, its broad-phase and trees, and its query snapshots, so several worlds
+/// in one process can each use their own arenas or pools. The callbacks are copied;
+/// only the context must outlive the world.
+/// The default callbacks use b2Alloc and b2Free.
+/// Shapes, ropes and the query stacks still use b2Alloc directly.
+struct b2Allocator
+{
+	/// Set up the default callbacks.
+	b2Allocator();
+
+	/// Allocate memory through the callbacks.
+	void* Allocate(int32 size, b2MemoryTag tag, int32 alignment = b2_allocAlignment) const;
+
+	/// Free memory through the callbacks. The size, tag and alignment must match the
+	/// allocation. Freeing NULL does nothing.
+	void Free(void* mem, int32 size, b2MemoryTag tag, int32 alignment = b2_allocAlignment) const;
+
+	b2AllocFcn* allocFcn;
+	b2FreeFcn* freeFcn;
+	void* context;
+};
+
+inline void* b2Allocator::Allocate(int32 size, b2MemoryTag tag, int32 alignment) const
+{
+	b2Assert(0 < alignment && (alignment & (alignment - 1)) == 0);
+	void* mem = allocFcn(size, alignment, tag, context);
+	b2Assert(((size_t)mem & (alignment - 1)) == 0);
+	return mem;
+}
+
+inline void b2Allocator::Free(void* mem, int32 size, b2MemoryTag tag, int32 alignment) const
+{
+	if (mem)
+	{
+		freeFcn(mem, size, alignment, tag, context);
+	}
+}
+
+#endif
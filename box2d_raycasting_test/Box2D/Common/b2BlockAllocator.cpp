@@ -20,6 +20,16 @@
 #include <limits.h>
 #include <string.h>
 #include <stddef.h>
+#include <new>
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+#if defined(_MSC_VER) && _MSC_VER < 1900
+#define b2_threadLocal __declspec(thread)
+#else
+#define b2_threadLocal thread_local
+#endif
 
 int32 b2BlockAllocator::s_blockSizes[b2_blockSizes] = 
 {
@@ -52,16 +62,81 @@ struct b2Block
 	b2Block* next;
 };
 
-b2BlockAllocator::b2BlockAllocator()
+// The header of a block larger than b2_maxBlockSize. The block follows it.
+struct b2LargeBlock
+{
+	b2LargeBlock* prev;
+	b2LargeBlock* next;
+	int32 size;
+};
+
+// Keeps the block after the header aligned.
+static const int32 b2_largeBlockHeaderSize = (sizeof(b2LargeBlock) + b2_allocAlignment - 1) & ~(b2_allocAlignment - 1);
+
+// A thread's private free lists.
+struct b2BlockCache
+{
+	b2Block* freeLists[b2_blockSizes];
+	int32 counts[b2_blockSizes];
+	std::thread::id thread;
+	b2BlockCache* next;
+};
+
+// A batch of b2_blockBatchSize blocks on a return list. The blocks are linked through
+// b2Block::next and the first block also links the batches. The smallest block
+// has room for both.
+struct b2BlockBatch
+{
+	b2Block* next;
+	b2BlockBatch* nextBatch;
+};
+
+// The state shared by the thread caches of an allocator.
+struct b2BlockPool
+{
+	// Guards the allocator's own free lists, chunks and large blocks, and the cache list.
+	std::mutex mutex;
+
+	// Batches freed by the caches, waiting for any cache to take them. Batches are only
+	// ever pushed one chain at a time or taken all at once, so there is no ABA problem.
+	std::atomic<b2BlockBatch*> returnLists[b2_blockSizes];
+
+	b2BlockCache* caches;
+
+	// Tells a thread's cached lookup which pool it belongs to.
+	uint32 serial;
+};
+
+static std::atomic<uint32> b2_blockPoolSerial(0);
+
+// The calling thread's cache for the pool with the matching serial.
+static b2_threadLocal uint32 t_cacheSerial;
+static b2_threadLocal b2BlockCache* t_cache;
+
+b2BlockAllocator::b2BlockAllocator(const b2Allocator& allocator)
+	: m_allocator(allocator)
 {
 	b2Assert(b2_blockSizes < UCHAR_MAX);
 
 	m_chunkSpace = b2_chunkArrayIncrement;
 	m_chunkCount = 0;
-	m_chunks = (b2Chunk*)b2Alloc(m_chunkSpace * sizeof(b2Chunk));
+	m_chunks = (b2Chunk*)m_allocator.Allocate(m_chunkSpace * sizeof(b2Chunk), b2_blockMemory);
 	
 	memset(m_chunks, 0, m_chunkSpace * sizeof(b2Chunk));
 	memset(m_freeLists, 0, sizeof(m_freeLists));
+	memset(m_chunkCounts, 0, sizeof(m_chunkCounts));
+
+	m_largeBlocks = NULL;
+	m_largeBlockCount = 0;
+	m_largeBlockBytes = 0;
+	m_pool = NULL;
+
+	m_arenaMode = false;
+	m_regions = NULL;
+	m_regionCount = 0;
+	m_regionSpace = 0;
+	m_regionIndex = -1;
+	m_regionChunkCount = 0;
 
 	if (s_blockSizeLookupInitialized == false)
 	{
@@ -86,29 +161,91 @@ b2BlockAllocator::b2BlockAllocator()
 
 b2BlockAllocator::~b2BlockAllocator()
 {
-	for (int32 i = 0; i < m_chunkCount; ++i)
+	DestroyPool();
+	FreeChunks();
+	FreeRegions();
+	m_allocator.Free(m_chunks, m_chunkSpace * sizeof(b2Chunk), b2_blockMemory);
+}
+
+void* b2BlockAllocator::Allocate(int32 size)
+{
+	if (size == 0)
+		return NULL;
+
+	b2Assert(0 < size);
+
+	if (m_pool)
 	{
-		b2Free(m_chunks[i].blocks);
+		return AllocateCached(size);
 	}
 
-	b2Free(m_chunks);
+	if (size > b2_maxBlockSize)
+	{
+		return AllocateLarge(size);
+	}
+
+	int32 index = s_blockSizeLookup[size];
+	b2Assert(0 <= index && index < b2_blockSizes);
+	return AllocateBlock(index);
 }
 
-void* b2BlockAllocator::Allocate(int32 size)
+void b2BlockAllocator::Free(void* p, int32 size)
 {
 	if (size == 0)
-		return NULL;
+	{
+		return;
+	}
 
 	b2Assert(0 < size);
 
+	if (m_pool)
+	{
+		FreeCached(p, size);
+		return;
+	}
+
 	if (size > b2_maxBlockSize)
 	{
-		return b2Alloc(size);
+		FreeLarge(p, size);
+		return;
 	}
 
 	int32 index = s_blockSizeLookup[size];
 	b2Assert(0 <= index && index < b2_blockSizes);
 
+#ifdef _DEBUG
+	// Verify the memory address and size is valid.
+	int32 blockSize = s_blockSizes[index];
+	bool found = false;
+	for (int32 i = 0; i < m_chunkCount; ++i)
+	{
+		b2Chunk* chunk = m_chunks + i;
+		if (chunk->blockSize != blockSize)
+		{
+			b2Assert(	(int8*)p + blockSize <= (int8*)chunk->blocks ||
+						(int8*)chunk->blocks + b2_chunkSize <= (int8*)p);
+		}
+		else
+		{
+			if ((int8*)chunk->blocks <= (int8*)p && (int8*)p + blockSize <= (int8*)chunk->blocks + b2_chunkSize)
+			{
+				found = true;
+			}
+		}
+	}
+
+	b2Assert(found);
+
+	memset(p, 0xfd, blockSize);
+#endif
+
+	b2Block* block = (b2Block*)p;
+	block->next = m_freeLists[index];
+	m_freeLists[index] = block;
+}
+
+b2Block* b2BlockAllocator::AllocateBlock(int32 index)
+{
 	if (m_freeLists[index])
 	{
 		b2Block* block = m_freeLists[index];
@@ -120,15 +257,16 @@ void* b2BlockAllocator::Allocate(int32 size)
 		if (m_chunkCount == m_chunkSpace)
 		{
 			b2Chunk* oldChunks = m_chunks;
+			int32 oldSpace = m_chunkSpace;
 			m_chunkSpace += b2_chunkArrayIncrement;
-			m_chunks = (b2Chunk*)b2Alloc(m_chunkSpace * sizeof(b2Chunk));
+			m_chunks = (b2Chunk*)m_allocator.Allocate(m_chunkSpace * sizeof(b2Chunk), b2_blockMemory);
 			memcpy(m_chunks, oldChunks, m_chunkCount * sizeof(b2Chunk));
 			memset(m_chunks + m_chunkCount, 0, b2_chunkArrayIncrement * sizeof(b2Chunk));
-			b2Free(oldChunks);
+			m_allocator.Free(oldChunks, oldSpace * sizeof(b2Chunk), b2_blockMemory);
 		}
 
 		b2Chunk* chunk = m_chunks + m_chunkCount;
-		chunk->blocks = (b2Block*)b2Alloc(b2_chunkSize);
+		chunk->blocks = (b2Block*)AllocateChunk();
 #if defined(_DEBUG)
 		memset(chunk->blocks, 0xcd, b2_chunkSize);
 #endif
@@ -147,69 +285,417 @@ void* b2BlockAllocator::Allocate(int32 size)
 
 		m_freeLists[index] = chunk->blocks->next;
 		++m_chunkCount;
+		++m_chunkCounts[index];
 
 		return chunk->blocks;
 	}
 }
 
-void b2BlockAllocator::Free(void* p, int32 size)
+void* b2BlockAllocator::AllocateLarge(int32 size)
 {
-	if (size == 0)
+	b2LargeBlock* large = (b2LargeBlock*)m_allocator.Allocate(b2_largeBlockHeaderSize + size, b2_blockMemory);
+	large->prev = NULL;
+	large->next = m_largeBlocks;
+	large->size = size;
+	if (m_largeBlocks)
 	{
-		return;
+		m_largeBlocks->prev = large;
 	}
+	m_largeBlocks = large;
+	++m_largeBlockCount;
+	m_largeBlockBytes += size;
+	return (int8*)large + b2_largeBlockHeaderSize;
+}
 
-	b2Assert(0 < size);
+void b2BlockAllocator::FreeLarge(void* p, int32 size)
+{
+	b2LargeBlock* large = (b2LargeBlock*)((int8*)p - b2_largeBlockHeaderSize);
+	b2Assert(large->size == size);
+	if (large->prev)
+	{
+		large->prev->next = large->next;
+	}
+	else
+	{
+		m_largeBlocks = large->next;
+	}
 
-	if (size > b2_maxBlockSize)
+	if (large->next)
+	{
+		large->next->prev = large->prev;
+	}
+
+	--m_largeBlockCount;
+	m_largeBlockBytes -= size;
+	m_allocator.Free(large, b2_largeBlockHeaderSize + size, b2_blockMemory);
+}
+
+void b2BlockAllocator::Clear()
+{
+	if (m_pool)
+	{
+		for (b2BlockCache* cache = m_pool->caches; cache; cache = cache->next)
+		{
+			memset(cache->freeLists, 0, sizeof(cache->freeLists));
+			memset(cache->counts, 0, sizeof(cache->counts));
+		}
+
+		for (int32 i = 0; i < b2_blockSizes; ++i)
+		{
+			m_pool->returnLists[i].store(NULL, std::memory_order_relaxed);
+		}
+	}
+
+	FreeChunks();
+
+	m_chunkCount = 0;
+	memset(m_chunks, 0, m_chunkSpace * sizeof(b2Chunk));
+
+	memset(m_freeLists, 0, sizeof(m_freeLists));
+	memset(m_chunkCounts, 0, sizeof(m_chunkCounts));
+}
+
+void b2BlockAllocator::GetStats(b2BlockAllocatorStats* stats) const
+{
+	memcpy(stats->chunkCount, m_chunkCounts, sizeof(m_chunkCounts));
+	stats->largeBlockCount = m_largeBlockCount;
+	stats->largeBlockBytes = m_largeBlockBytes;
+	stats->regionCount = m_regionCount;
+
+	int32 capacity = m_chunkSpace * sizeof(b2Chunk);
+	if (m_arenaMode)
+	{
+		capacity += m_regionCount * b2_arenaRegionChunks * b2_chunkSize + m_regionSpace * sizeof(int8*);
+	}
+	else
+	{
+		capacity += m_chunkCount * b2_chunkSize;
+	}
+
+	capacity += m_largeBlockCount * b2_largeBlockHeaderSize + m_largeBlockBytes;
+
+	if (m_pool)
+	{
+		capacity += sizeof(b2BlockPool);
+		for (const b2BlockCache* cache = m_pool->caches; cache; cache = cache->next)
+		{
+			capacity += sizeof(b2BlockCache);
+		}
+	}
+
+	stats->capacity = capacity;
+}
+
+void b2BlockAllocator::SetArenaMode(bool flag)
+{
+	b2Assert(m_chunkCount == 0 && m_largeBlocks == NULL);
+	if (flag == m_arenaMode)
 	{
-		b2Free(p);
 		return;
 	}
 
-	int32 index = s_blockSizeLookup[size];
-	b2Assert(0 <= index && index < b2_blockSizes);
+	FreeRegions();
+	m_arenaMode = flag;
+}
 
-#ifdef _DEBUG
-	// Verify the memory address and size is valid.
-	int32 blockSize = s_blockSizes[index];
-	bool found = false;
-	for (int32 i = 0; i < m_chunkCount; ++i)
+int8* b2BlockAllocator::AllocateChunk()
+{
+	if (m_arenaMode == false)
 	{
-		b2Chunk* chunk = m_chunks + i;
-		if (chunk->blockSize != blockSize)
+		return (int8*)m_allocator.Allocate(b2_chunkSize, b2_blockMemory, b2_chunkAlignment);
+	}
+
+	if (m_regionIndex < 0 || m_regionChunkCount == b2_arenaRegionChunks)
+	{
+		// Move on to the next region, reusing one kept by Clear if there is one.
+		++m_regionIndex;
+		m_regionChunkCount = 0;
+
+		if (m_regionIndex == m_regionCount)
 		{
-			b2Assert(	(int8*)p + blockSize <= (int8*)chunk->blocks ||
-						(int8*)chunk->blocks + b2_chunkSize <= (int8*)p);
+			if (m_regionCount == m_regionSpace)
+			{
+				int8** oldRegions = m_regions;
+				int32 oldSpace = m_regionSpace;
+				m_regionSpace += b2_regionArrayIncrement;
+				m_regions = (int8**)m_allocator.Allocate(m_regionSpace * sizeof(int8*), b2_blockMemory);
+				if (oldRegions)
+				{
+					memcpy(m_regions, oldRegions, m_regionCount * sizeof(int8*));
+					m_allocator.Free(oldRegions, oldSpace * sizeof(int8*), b2_blockMemory);
+				}
+			}
+
+			m_regions[m_regionCount] = (int8*)m_allocator.Allocate(b2_arenaRegionChunks * b2_chunkSize, b2_blockMemory, b2_chunkAlignment);
+			++m_regionCount;
 		}
-		else
+	}
+
+	int8* chunk = m_regions[m_regionIndex] + m_regionChunkCount * b2_chunkSize;
+	++m_regionChunkCount;
+	return chunk;
+}
+
+// Release the chunks and the large blocks. Arena regions are rewound, not released.
+void b2BlockAllocator::FreeChunks()
+{
+	if (m_arenaMode)
+	{
+		m_regionIndex = -1;
+		m_regionChunkCount = 0;
+	}
+	else
+	{
+		for (int32 i = 0; i < m_chunkCount; ++i)
 		{
-			if ((int8*)chunk->blocks <= (int8*)p && (int8*)p + blockSize <= (int8*)chunk->blocks + b2_chunkSize)
+			m_allocator.Free(m_chunks[i].blocks, b2_chunkSize, b2_blockMemory, b2_chunkAlignment);
+		}
+	}
+
+	while (m_largeBlocks)
+	{
+		b2LargeBlock* next = m_largeBlocks->next;
+		m_allocator.Free(m_largeBlocks, b2_largeBlockHeaderSize + m_largeBlocks->size, b2_blockMemory);
+		m_largeBlocks = next;
+	}
+	m_largeBlockCount = 0;
+	m_largeBlockBytes = 0;
+}
+
+void b2BlockAllocator::FreeRegions()
+{
+	for (int32 i = 0; i < m_regionCount; ++i)
+	{
+		m_allocator.Free(m_regions[i], b2_arenaRegionChunks * b2_chunkSize, b2_blockMemory, b2_chunkAlignment);
+	}
+
+	m_allocator.Free(m_regions, m_regionSpace * sizeof(int8*), b2_blockMemory);
+	m_regions = NULL;
+	m_regionCount = 0;
+	m_regionSpace = 0;
+	m_regionIndex = -1;
+	m_regionChunkCount = 0;
+}
+
+void b2BlockAllocator::SetThreadCaching(bool flag)
+{
+	if (flag == (m_pool != NULL))
+	{
+		return;
+	}
+
+	if (flag)
+	{
+		void* mem = m_allocator.Allocate(sizeof(b2BlockPool), b2_blockMemory);
+		m_pool = new (mem) b2BlockPool;
+		for (int32 i = 0; i < b2_blockSizes; ++i)
+		{
+			m_pool->returnLists[i].store(NULL, std::memory_order_relaxed);
+		}
+		m_pool->caches = NULL;
+		m_pool->serial = ++b2_blockPoolSerial;
+	}
+	else
+	{
+		// Give every cached block back to the allocator's own free lists.
+		for (int32 i = 0; i < b2_blockSizes; ++i)
+		{
+			b2BlockBatch* batch = m_pool->returnLists[i].load(std::memory_order_relaxed);
+			while (batch)
 			{
-				found = true;
+				b2BlockBatch* nextBatch = batch->nextBatch;
+				PushFreeList(i, (b2Block*)batch);
+				batch = nextBatch;
+			}
+
+			for (b2BlockCache* cache = m_pool->caches; cache; cache = cache->next)
+			{
+				PushFreeList(i, cache->freeLists[i]);
 			}
 		}
+
+		DestroyPool();
 	}
+}
 
-	b2Assert(found);
+void b2BlockAllocator::DestroyPool()
+{
+	if (m_pool == NULL)
+	{
+		return;
+	}
 
-	memset(p, 0xfd, blockSize);
+	b2BlockCache* cache = m_pool->caches;
+	while (cache)
+	{
+		b2BlockCache* next = cache->next;
+		cache->~b2BlockCache();
+		m_allocator.Free(cache, sizeof(b2BlockCache), b2_blockMemory);
+		cache = next;
+	}
+
+	m_pool->~b2BlockPool();
+	m_allocator.Free(m_pool, sizeof(b2BlockPool), b2_blockMemory);
+	m_pool = NULL;
+}
+
+// Put a NULL terminated list of blocks on the allocator's own free list.
+void b2BlockAllocator::PushFreeList(int32 index, b2Block* list)
+{
+	while (list)
+	{
+		b2Block* next = list->next;
+		list->next = m_freeLists[index];
+		m_freeLists[index] = list;
+		list = next;
+	}
+}
+
+b2BlockCache* b2BlockAllocator::GetCache()
+{
+	if (t_cacheSerial == m_pool->serial)
+	{
+		return t_cache;
+	}
+
+	// First use from this thread, or the thread last used another allocator.
+	std::thread::id thread = std::this_thread::get_id();
+	std::lock_guard<std::mutex> lock(m_pool->mutex);
+
+	b2BlockCache* cache = m_pool->caches;
+	while (cache && cache->thread != thread)
+	{
+		cache = cache->next;
+	}
+
+	if (cache == NULL)
+	{
+		void* mem = m_allocator.Allocate(sizeof(b2BlockCache), b2_blockMemory);
+		cache = new (mem) b2BlockCache;
+		memset(cache->freeLists, 0, sizeof(cache->freeLists));
+		memset(cache->counts, 0, sizeof(cache->counts));
+		cache->thread = thread;
+		cache->next = m_pool->caches;
+		m_pool->caches = cache;
+	}
+
+	t_cacheSerial = m_pool->serial;
+	t_cache = cache;
+	return cache;
+}
+
+void* b2BlockAllocator::AllocateCached(int32 size)
+{
+	if (size > b2_maxBlockSize)
+	{
+		std::lock_guard<std::mutex> lock(m_pool->mutex);
+		return AllocateLarge(size);
+	}
+
+	int32 index = s_blockSizeLookup[size];
+	b2Assert(0 <= index && index < b2_blockSizes);
+
+	b2BlockCache* cache = GetCache();
+	if (cache->freeLists[index] == NULL)
+	{
+		RefillCache(cache, index);
+	}
+
+	b2Block* block = cache->freeLists[index];
+	cache->freeLists[index] = block->next;
+	--cache->counts[index];
+	return block;
+}
+
+void b2BlockAllocator::FreeCached(void* p, int32 size)
+{
+	if (size > b2_maxBlockSize)
+	{
+		std::lock_guard<std::mutex> lock(m_pool->mutex);
+		FreeLarge(p, size);
+		return;
+	}
+
+	int32 index = s_blockSizeLookup[size];
+	b2Assert(0 <= index && index < b2_blockSizes);
+
+#ifdef _DEBUG
+	memset(p, 0xfd, s_blockSizes[index]);
 #endif
 
+	b2BlockCache* cache = GetCache();
 	b2Block* block = (b2Block*)p;
-	block->next = m_freeLists[index];
-	m_freeLists[index] = block;
+	block->next = cache->freeLists[index];
+	cache->freeLists[index] = block;
+	++cache->counts[index];
+
+	// Keep a batch for this thread and hand the one before it to the other threads.
+	// This is how blocks freed on another thread than the one that allocated them
+	// find their way back.
+	if (cache->counts[index] == 2 * b2_blockBatchSize)
+	{
+		b2Block* first = cache->freeLists[index];
+		b2Block* last = first;
+		for (int32 i = 1; i < b2_blockBatchSize; ++i)
+		{
+			last = last->next;
+		}
+
+		cache->freeLists[index] = last->next;
+		cache->counts[index] -= b2_blockBatchSize;
+		last->next = NULL;
+
+		b2BlockBatch* batch = (b2BlockBatch*)first;
+		batch->nextBatch = NULL;
+		PushBatches(index, batch, batch);
+	}
 }
 
-void b2BlockAllocator::Clear()
+void b2BlockAllocator::RefillCache(b2BlockCache* cache, int32 index)
 {
-	for (int32 i = 0; i < m_chunkCount; ++i)
+	// Take a returned batch without locking. All of them have to be taken at once,
+	// so put back the ones after the first.
+	b2BlockBatch* batch = m_pool->returnLists[index].exchange(NULL, std::memory_order_acquire);
+	if (batch)
 	{
-		b2Free(m_chunks[i].blocks);
+		b2BlockBatch* rest = batch->nextBatch;
+		if (rest)
+		{
+			b2BlockBatch* last = rest;
+			while (last->nextBatch)
+			{
+				last = last->nextBatch;
+			}
+			PushBatches(index, rest, last);
+		}
+
+		cache->freeLists[index] = (b2Block*)batch;
+		cache->counts[index] = b2_blockBatchSize;
+		return;
 	}
 
-	m_chunkCount = 0;
-	memset(m_chunks, 0, m_chunkSpace * sizeof(b2Chunk));
+	// Carve a batch out of the shared free lists and chunks.
+	std::lock_guard<std::mutex> lock(m_pool->mutex);
+	b2Block* list = NULL;
+	for (int32 i = 0; i < b2_blockBatchSize; ++i)
+	{
+		b2Block* block = AllocateBlock(index);
+		block->next = list;
+		list = block;
+	}
 
-	memset(m_freeLists, 0, sizeof(m_freeLists));
+	cache->freeLists[index] = list;
+	cache->counts[index] = b2_blockBatchSize;
+}
+
+// Push a chain of batches onto a return list.
+void b2BlockAllocator::PushBatches(int32 index, b2BlockBatch* first, b2BlockBatch* last)
+{
+	std::atomic<b2BlockBatch*>& head = m_pool->returnLists[index];
+	b2BlockBatch* oldHead = head.load(std::memory_order_relaxed);
+	do
+	{
+		last->nextBatch = oldHead;
+	}
+	while (head.compare_exchange_weak(oldHead, first, std::memory_order_release, std::memory_order_relaxed) == false);
 }
@@ -19,15 +19,40 @@
 #ifndef B2_BLOCK_ALLOCATOR_H
 #define B2_BLOCK_ALLOCATOR_H
 
-#include <Box2D/Common/b2Settings.h>
+#include <Box2D/Common/b2Allocator.h>
 
 const int32 b2_chunkSize = 16 * 1024;
 const int32 b2_maxBlockSize = 640;
 const int32 b2_blockSizes = 14;
 const int32 b2_chunkArrayIncrement = 128;
 
+// Chunks are cache line aligned so blocks of 64 bytes and up don't straddle lines.
+const int32 b2_chunkAlignment = 64;
+
+// In arena mode chunks are carved out of regions of this many chunks (1 MB).
+const int32 b2_arenaRegionChunks = 64;
+const int32 b2_regionArrayIncrement = 16;
+
+// With thread caching, blocks move between the thread caches and the shared pool
+// in batches of this many.
+const int32 b2_blockBatchSize = 32;
+
 struct b2Block;
 struct b2Chunk;
+struct b2LargeBlock;
+struct b2BlockBatch;
+struct b2BlockCache;
+struct b2BlockPool;
+
+/// Block allocator memory use.
+struct b2BlockAllocatorStats
+{
+	int32 chunkCount[b2_blockSizes];	///< chunks by size class, see b2BlockAllocator::GetBlockSize
+	int32 largeBlockCount;				///< blocks larger than b2_maxBlockSize
+	int32 largeBlockBytes;
+	int32 regionCount;					///< arena regions, including ones kept by Clear
+	int32 capacity;						///< bytes held from the b2Allocator
+};
 
 /// This is a small object allocator used for allocating small
 /// objects that persist for more than one time step.
@@ -35,28 +60,113 @@ struct b2Chunk;
 class b2BlockAllocator
 {
 public:
-	b2BlockAllocator();
+	/// The chunks and the blocks larger than b2_maxBlockSize come from the allocator.
+	explicit b2BlockAllocator(const b2Allocator& allocator = b2Allocator());
 	~b2BlockAllocator();
 
-	/// Allocate memory. This will use b2Alloc if the size is larger than b2_maxBlockSize.
+	/// Allocate memory. This will use the allocator directly if the size is larger than
+	/// b2_maxBlockSize.
 	void* Allocate(int32 size);
 
-	/// Free memory. This will use b2Free if the size is larger than b2_maxBlockSize.
+	/// Free memory. This will use the allocator directly if the size is larger than
+	/// b2_maxBlockSize.
 	void Free(void* p, int32 size);
 
+	/// Release every block at once. Nothing allocated before must be used or freed
+	/// afterwards. In arena mode the regions are kept and reused.
 	void Clear();
 
+	/// Arena mode takes chunks from large contiguous regions instead of allocating
+	/// them one at a time. The regions are only released when arena mode is turned
+	/// off or the allocator is destroyed, so clearing and refilling the allocator
+	/// doesn't go back to the b2Allocator. Only change this while the allocator is
+	/// empty.
+	void SetArenaMode(bool flag);
+	bool GetArenaMode() const;
+
+	/// Enable/disable per-thread caches, so that any number of threads can allocate
+	/// and free at the same time. Each thread gets its own free lists, which it
+	/// refills from a shared pool in batches. Blocks may be freed on another thread
+	/// than the one that allocated them; overflowing free lists go back to the pool
+	/// through lock-free return lists. Large blocks and new chunks take a lock.
+	/// Only change this while no other thread is using the allocator. The b2Allocator
+	/// callbacks must be thread-safe while this is enabled. Clear must not be called
+	/// concurrently with anything else.
+	void SetThreadCaching(bool flag);
+	bool GetThreadCaching() const;
+
+	/// Get the memory use. With thread caching, other threads must not be using
+	/// the allocator.
+	void GetStats(b2BlockAllocatorStats* stats) const;
+
+	/// Get the block size of a size class.
+	static int32 GetBlockSize(int32 index);
+
 private:
 
+	b2BlockAllocator(const b2BlockAllocator&);
+	b2BlockAllocator& operator=(const b2BlockAllocator&);
+
+	b2Block* AllocateBlock(int32 index);
+	void* AllocateLarge(int32 size);
+	void FreeLarge(void* p, int32 size);
+
+	int8* AllocateChunk();
+	void FreeChunks();
+	void FreeRegions();
+
+	b2BlockCache* GetCache();
+	void* AllocateCached(int32 size);
+	void FreeCached(void* p, int32 size);
+	void RefillCache(b2BlockCache* cache, int32 index);
+	void PushBatches(int32 index, b2BlockBatch* first, b2BlockBatch* last);
+	void PushFreeList(int32 index, b2Block* list);
+	void DestroyPool();
+
+	b2Allocator m_allocator;
+
 	b2Chunk* m_chunks;
 	int32 m_chunkCount;
 	int32 m_chunkSpace;
 
 	b2Block* m_freeLists[b2_blockSizes];
+	int32 m_chunkCounts[b2_blockSizes];
+
+	// Blocks larger than b2_maxBlockSize, so Clear can release them.
+	b2LargeBlock* m_largeBlocks;
+	int32 m_largeBlockCount;
+	int32 m_largeBlockBytes;
+
+	// The thread caches, or NULL if thread caching is disabled.
+	b2BlockPool* m_pool;
+
+	// Arena regions. Regions before m_regionIndex are full.
+	bool m_arenaMode;
+	int8** m_regions;
+	int32 m_regionCount;
+	int32 m_regionSpace;
+	int32 m_regionIndex;
+	int32 m_regionChunkCount;
 
 	static int32 s_blockSizes[b2_blockSizes];
 	static uint8 s_blockSizeLookup[b2_maxBlockSize + 1];
 	static bool s_blockSizeLookupInitialized;
 };
 
+inline bool b2BlockAllocator::GetArenaMode() const
+{
+	return m_arenaMode;
+}
+
+inline bool b2BlockAllocator::GetThreadCaching() const
+{
+	return m_pool != NULL;
+}
+
+inline int32 b2BlockAllocator::GetBlockSize(int32 index)
+{
+	b2Assert(0 <= index && index < b2_blockSizes);
+	return s_blockSizes[index];
+}
+
 #endif
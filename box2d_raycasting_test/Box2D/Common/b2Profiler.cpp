@@ -0,0 +1,211 @@
+/*
+* Copyright (c) 2011 Erin Catto http://box2d.org
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include <Box2D/Common/b2Profiler.h>
+#include <Box2D/Common/b2Math.h>
+#include <Box2D/Common/b2Timer.h>
+#include <stdio.h>
+#include <string.h>
+#include <atomic>
+
+#if b2_profiler
+
+#if defined(_MSC_VER) && _MSC_VER < 1900
+#define b2_threadLocal __declspec(thread)
+#else
+#define b2_threadLocal thread_local
+#endif
+
+// A finished zone, or a frame marker if the duration is b2_frameMarker. The name is
+// stored last, so a zone without a name is still being written.
+struct b2ProfileEvent
+{
+	std::atomic<const char*> name;
+	uint64 start;
+	uint64 duration;
+	int32 threadId;
+};
+
+static const uint64 b2_frameMarker = ~0ull;
+
+// The zones live in one static array so that recording never allocates. Zones that end
+// late may still write to it after the capture, so it is never freed.
+static b2ProfileEvent s_events[b2_maxProfileZones];
+static std::atomic<int32> s_eventCount;
+static std::atomic<bool> s_capturing;
+static uint64 s_captureStart;
+static int32 s_frameCount;
+static int32 s_frameLimit;
+static char s_path[256];
+
+// Small thread ids read better in trace viewers than native ones.
+static std::atomic<int32> s_threadCount;
+static b2_threadLocal int32 t_threadId = -1;
+
+static void b2RecordEvent(const char* name, uint64 start, uint64 duration)
+{
+	int32 index = s_eventCount.fetch_add(1, std::memory_order_relaxed);
+	if (index >= b2_maxProfileZones)
+	{
+		return;
+	}
+
+	if (t_threadId < 0)
+	{
+		t_threadId = s_threadCount.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	b2ProfileEvent* event = s_events + index;
+	event->start = start;
+	event->duration = duration;
+	event->threadId = t_threadId;
+	event->name.store(name, std::memory_order_release);
+}
+
+b2ProfileZone::b2ProfileZone(const char* name)
+{
+	m_name = name;
+	m_start = s_capturing.load(std::memory_order_relaxed) ? b2Timer::GetTimestamp() : 0;
+}
+
+b2ProfileZone::~b2ProfileZone()
+{
+	if (m_start != 0 && s_capturing.load(std::memory_order_relaxed))
+	{
+		b2RecordEvent(m_name, m_start, b2Timer::GetTimestamp() - m_start);
+	}
+}
+
+bool b2BeginProfileCapture(const char* path, int32 frameCount)
+{
+	if (s_capturing.load())
+	{
+		return false;
+	}
+
+	int32 count = b2Min(s_eventCount.load(), int32(b2_maxProfileZones));
+	for (int32 i = 0; i < count; ++i)
+	{
+		s_events[i].name.store(NULL, std::memory_order_relaxed);
+	}
+
+	s_eventCount.store(0);
+	strncpy(s_path, path, sizeof(s_path) - 1);
+	s_path[sizeof(s_path) - 1] = 0;
+	s_frameCount = 0;
+	s_frameLimit = frameCount;
+	s_captureStart = b2Timer::GetTimestamp();
+	s_capturing.store(true);
+	return true;
+}
+
+void b2ProfileFrame()
+{
+	if (s_capturing.load(std::memory_order_relaxed) == false)
+	{
+		return;
+	}
+
+	b2RecordEvent("Frame", b2Timer::GetTimestamp(), b2_frameMarker);
+
+	++s_frameCount;
+	if (s_frameLimit > 0 && s_frameCount >= s_frameLimit)
+	{
+		b2EndProfileCapture();
+	}
+}
+
+bool b2EndProfileCapture()
+{
+	if (s_capturing.exchange(false) == false)
+	{
+		return false;
+	}
+
+	FILE* file = fopen(s_path, "w");
+	if (file == NULL)
+	{
+		return false;
+	}
+
+	int32 recorded = s_eventCount.load();
+	int32 count = b2Min(recorded, int32(b2_maxProfileZones));
+
+	// Time stamps are in microseconds from the start of the capture.
+	fprintf(file, "{\"displayTimeUnit\":\"ns\",\"otherData\":{\"droppedZones\":%d},\"traceEvents\":[\n",
+		b2Max(recorded - count, 0));
+
+	bool first = true;
+	for (int32 i = 0; i < count; ++i)
+	{
+		const b2ProfileEvent* event = s_events + i;
+		const char* name = event->name.load(std::memory_order_acquire);
+		if (name == NULL || event->start < s_captureStart)
+		{
+			continue;
+		}
+
+		double ts = double(event->start - s_captureStart) * 1.0e-3;
+		if (event->duration == b2_frameMarker)
+		{
+			fprintf(file, "%s{\"name\":\"%s\",\"ph\":\"i\",\"s\":\"g\",\"ts\":%.3f,\"pid\":0,\"tid\":%d}",
+				first ? "" : ",\n", name, ts, event->threadId);
+		}
+		else
+		{
+			fprintf(file, "%s{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":0,\"tid\":%d}",
+				first ? "" : ",\n", name, ts, double(event->duration) * 1.0e-3, event->threadId);
+		}
+		first = false;
+	}
+
+	fprintf(file, "\n]}\n");
+	bool ok = ferror(file) == 0;
+	ok = fclose(file) == 0 && ok;
+	return ok;
+}
+
+bool b2IsProfileCapturing()
+{
+	return s_capturing.load(std::memory_order_relaxed);
+}
+
+#else
+
+bool b2BeginProfileCapture(const char* path, int32 frameCount)
+{
+	B2_NOT_USED(path);
+	B2_NOT_USED(frameCount);
+	return false;
+}
+
+void b2ProfileFrame()
+{
+}
+
+bool b2EndProfileCapture()
+{
+	return false;
+}
+
+bool b2IsProfileCapturing()
+{
+	return false;
+}
+
+#endif
@@ -0,0 +1,80 @@
+/*
+* Copyright (c) 2011 Erin Catto http://box2d.org
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef B2_PROFILER_H
+#define B2_PROFILER_H
+
+#include <Box2D/Common/b2Settings.h>
+
+/// The zone profiler records nested, named time spans from every thread and writes
+/// them as Chrome trace event JSON, which chrome://tracing and similar viewers load.
+/// It is compiled out unless b2_profiler is defined as 1 for the whole build, in which
+/// case zones cost nothing. When it is built in, a zone costs one atomic load until a
+/// capture is started.
+#ifndef b2_profiler
+#define b2_profiler 0
+#endif
+
+/// The maximum number of zones one capture holds. Later zones are dropped.
+#define b2_maxProfileZones	(1 << 18)
+
+#if b2_profiler
+
+/// Times its own lifetime while a capture is running. Use b2ProfileScope.
+class b2ProfileZone
+{
+public:
+	explicit b2ProfileZone(const char* name);
+	~b2ProfileZone();
+
+private:
+	const char* m_name;
+	uint64 m_start;
+};
+
+#define b2_profileJoin2(a, b) a##b
+#define b2_profileJoin(a, b) b2_profileJoin2(a, b)
+
+/// Time the rest of the enclosing scope. The name must be a string literal without
+/// quotes or backslashes.
+#define b2ProfileScope(name) b2ProfileZone b2_profileJoin(b2_profileZone, __LINE__)(name)
+
+#else
+
+#define b2ProfileScope(name)
+
+#endif
+
+/// Start recording zones. The capture is written to path after frameCount calls to
+/// b2ProfileFrame, or by b2EndProfileCapture if frameCount is zero. Returns false if a
+/// capture is already running or the profiler is compiled out.
+/// Captures should begin and end where no other thread is inside a zone, such as
+/// between steps, or those zones may be missing from the capture.
+bool b2BeginProfileCapture(const char* path, int32 frameCount = 0);
+
+/// Mark the end of a frame. Frames show as markers on the timeline.
+void b2ProfileFrame();
+
+/// Stop the capture and write it. Returns false if there is no capture or the file
+/// couldn't be written.
+bool b2EndProfileCapture();
+
+/// Is a capture running?
+bool b2IsProfileCapturing();
+
+#endif
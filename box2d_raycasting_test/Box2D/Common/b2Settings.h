@@ -32,6 +32,7 @@ typedef signed int int32;
 typedef unsigned char uint8;
 typedef unsigned short uint16;
 typedef unsigned int uint32;
+typedef unsigned long long uint64;
 typedef float float32;
 typedef double float64;
 
@@ -63,6 +64,32 @@ typedef double float64;
 /// This is a dimensionless multiplier.
 #define b2_aabbMultiplier		2.0f
 
+/// Adaptive AABB margins. A proxy's margin is its smoothed per-step displacement
+/// scaled by b2_aabbMarginScale and clamped to [b2_minAABBMargin, b2_maxAABBMargin].
+/// The margins are in meters, the scale is dimensionless.
+#define b2_aabbMarginScale		4.0f
+#define b2_minAABBMargin		0.02f
+#define b2_maxAABBMargin		1.0f
+
+/// The weight given to a proxy's displacement history when smoothing it for
+/// adaptive margins. This is in [0,1).
+#define b2_aabbMarginSmoothing	0.75f
+
+/// A fat AABB whose perimeter exceeds the required perimeter by this factor is
+/// tightened. This is a dimensionless ratio.
+#define b2_aabbShrinkRatio		2.0f
+
+/// Batched world queries give each thread at least this many queries.
+#define b2_occlusionBatchSize	256
+
+/// The maximum number of threads used by a batched world query.
+#define b2_maxQueryThreads		16
+
+/// In refit mode the dynamic tree is rebuilt once refitting has grown the summed
+/// perimeter of its internal nodes by this fraction since the last rebuild.
+/// This is a dimensionless ratio.
+#define b2_treeRebuildRatio		0.5f
+
 /// A small length used as a collision and constraint tolerance. Usually it is
 /// chosen to be numerically significant, but visually insignificant.
 #define b2_linearSlop			0.005f
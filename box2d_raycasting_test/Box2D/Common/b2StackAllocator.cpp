@@ -19,18 +19,35 @@
 #include <Box2D/Common/b2StackAllocator.h>
 #include <Box2D/Common/b2Math.h>
 
-b2StackAllocator::b2StackAllocator()
+// An extra block of stack memory. The data follows the header.
+struct b2StackSegment
+{
+	b2StackSegment* next;
+	int32 capacity;
+	int32 index;
+};
+
+b2StackAllocator::b2StackAllocator(const b2Allocator& allocator)
+	: m_allocator(allocator)
 {
 	m_index = 0;
 	m_allocation = 0;
-	m_maxAllocation = 0;
+	m_segmentList = NULL;
+	m_segment = NULL;
 	m_entryCount = 0;
+
+	m_stats.spillCount = 0;
+	m_stats.segmentAllocCount = 0;
+	m_stats.segmentCount = 0;
+	m_stats.capacity = b2_stackSize;
+	m_stats.maxAllocation = 0;
 }
 
 b2StackAllocator::~b2StackAllocator()
 {
 	b2Assert(m_index == 0);
 	b2Assert(m_entryCount == 0);
+	FreeSegmentChain(m_segmentList);
 }
 
 void* b2StackAllocator::Allocate(int32 size)
@@ -39,20 +56,48 @@ void* b2StackAllocator::Allocate(int32 size)
 
 	b2StackEntry* entry = m_entries + m_entryCount;
 	entry->size = size;
-	if (m_index + size > b2_stackSize)
+	if (m_segment == NULL && m_index + size <= b2_stackSize)
 	{
-		entry->data = (char*)b2Alloc(size);
-		entry->usedMalloc = true;
+		entry->data = m_data + m_index;
+		entry->segment = NULL;
+		m_index += size;
 	}
 	else
 	{
-		entry->data = m_data + m_index;
-		entry->usedMalloc = false;
-		m_index += size;
+		++m_stats.spillCount;
+
+		if (m_segment == NULL || m_segment->index + size > m_segment->capacity)
+		{
+			// Move on to the next segment. It is empty since allocations are nested.
+			// Replace it and the ones after it if it is too small.
+			b2StackSegment** link = m_segment ? &m_segment->next : &m_segmentList;
+			if (*link == NULL || (*link)->capacity < size)
+			{
+				FreeSegmentChain(*link);
+
+				// Grow geometrically so a growing load settles after a few steps.
+				int32 capacity = b2Max(size, m_stats.capacity);
+				b2StackSegment* segment = (b2StackSegment*)m_allocator.Allocate(sizeof(b2StackSegment) + capacity, b2_stackMemory);
+				segment->next = NULL;
+				segment->capacity = capacity;
+				segment->index = 0;
+				*link = segment;
+
+				++m_stats.segmentAllocCount;
+				++m_stats.segmentCount;
+				m_stats.capacity += capacity;
+			}
+
+			m_segment = *link;
+		}
+
+		entry->data = (char*)(m_segment + 1) + m_segment->index;
+		entry->segment = m_segment;
+		m_segment->index += size;
 	}
 
 	m_allocation += size;
-	m_maxAllocation = b2Max(m_maxAllocation, m_allocation);
+	m_stats.maxAllocation = b2Max(m_stats.maxAllocation, m_allocation);
 	++m_entryCount;
 
 	return entry->data;
@@ -63,9 +108,9 @@ void b2StackAllocator::Free(void* p)
 	b2Assert(m_entryCount > 0);
 	b2StackEntry* entry = m_entries + m_entryCount - 1;
 	b2Assert(p == entry->data);
-	if (entry->usedMalloc)
+	if (entry->segment)
 	{
-		b2Free(p);
+		entry->segment->index -= entry->size;
 	}
 	else
 	{
@@ -74,10 +119,45 @@ void b2StackAllocator::Free(void* p)
 	m_allocation -= entry->size;
 	--m_entryCount;
 
+	// Go back to the segment of the allocation below, if any.
+	m_segment = m_entryCount > 0 ? m_entries[m_entryCount - 1].segment : NULL;
+
 	p = NULL;
 }
 
 int32 b2StackAllocator::GetMaxAllocation() const
 {
-	return m_maxAllocation;
+	return m_stats.maxAllocation;
+}
+
+const b2StackAllocatorStats& b2StackAllocator::GetStats() const
+{
+	return m_stats;
+}
+
+void b2StackAllocator::ResetStats()
+{
+	m_stats.spillCount = 0;
+	m_stats.segmentAllocCount = 0;
+	m_stats.maxAllocation = m_allocation;
+}
+
+void b2StackAllocator::FreeSegments()
+{
+	b2Assert(m_segment == NULL);
+	FreeSegmentChain(m_segmentList);
+	m_segmentList = NULL;
+}
+
+void b2StackAllocator::FreeSegmentChain(b2StackSegment* segment)
+{
+	while (segment)
+	{
+		b2Assert(segment->index == 0);
+		b2StackSegment* next = segment->next;
+		m_stats.capacity -= segment->capacity;
+		--m_stats.segmentCount;
+		m_allocator.Free(segment, sizeof(b2StackSegment) + segment->capacity, b2_stackMemory);
+		segment = next;
+	}
 }
@@ -19,25 +19,40 @@
 #ifndef B2_STACK_ALLOCATOR_H
 #define B2_STACK_ALLOCATOR_H
 
-#include <Box2D/Common/b2Settings.h>
+#include <Box2D/Common/b2Allocator.h>
 
 const int32 b2_stackSize = 100 * 1024;	// 100k
 const int32 b2_maxStackEntries = 32;
 
+struct b2StackSegment;
+
 struct b2StackEntry
 {
 	char* data;
 	int32 size;
-	bool usedMalloc;
+	b2StackSegment* segment;	///< NULL for the fixed buffer
+};
+
+/// Stack allocator counters. These help tune b2_stackSize.
+struct b2StackAllocatorStats
+{
+	int32 spillCount;			///< allocations that didn't fit in the fixed buffer
+	int32 segmentAllocCount;	///< extra segments allocated
+	int32 segmentCount;			///< extra segments currently kept for reuse
+	int32 capacity;				///< bytes in the fixed buffer and the extra segments
+	int32 maxAllocation;		///< the high-water mark in bytes
 };
 
 // This is a stack allocator used for fast per step allocations.
 // You must nest allocate/free pairs. The code will assert
 // if you try to interleave multiple allocate/free pairs.
+// Allocations that don't fit in the fixed buffer go to extra segments
+// allocated with the b2Allocator. The segments are kept once they are empty, so
+// steps that need more than b2_stackSize only pay for allocation once.
 class b2StackAllocator
 {
 public:
-	b2StackAllocator();
+	explicit b2StackAllocator(const b2Allocator& allocator = b2Allocator());
 	~b2StackAllocator();
 
 	void* Allocate(int32 size);
@@ -45,13 +60,35 @@ public:
 
 	int32 GetMaxAllocation() const;
 
+	/// Get the allocator counters.
+	const b2StackAllocatorStats& GetStats() const;
+
+	/// Reset the spill and segment allocation counts, and the high-water mark to the
+	/// current allocation.
+	void ResetStats();
+
+	/// Free the extra segments. There must be no allocations in them.
+	void FreeSegments();
+
 private:
 
+	b2StackAllocator(const b2StackAllocator&);
+	b2StackAllocator& operator=(const b2StackAllocator&);
+
+	void FreeSegmentChain(b2StackSegment* segment);
+
+	b2Allocator m_allocator;
+
 	char m_data[b2_stackSize];
 	int32 m_index;
 
 	int32 m_allocation;
-	int32 m_maxAllocation;
+
+	// The extra segments in the order they are filled, and the one in use.
+	b2StackSegment* m_segmentList;
+	b2StackSegment* m_segment;
+
+	b2StackAllocatorStats m_stats;
 
 	b2StackEntry m_entries[b2_maxStackEntries];
 	int32 m_entryCount;
@@ -0,0 +1,127 @@
+/*
+* Copyright (c) 2016 Erin Catto http://box2d.org
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include <Box2D/Common/b2ThreadPool.h>
+#include <Box2D/Common/b2Math.h>
+
+b2ThreadPool::b2ThreadPool()
+{
+	m_threadCount = 0;
+	m_maxRangeCount = b2Clamp(int32(std::thread::hardware_concurrency()), 1, b2_maxQueryThreads);
+
+	m_generation = 0;
+	m_pending = 0;
+	m_quit = false;
+
+	m_task = NULL;
+	m_context = NULL;
+	m_count = 0;
+	m_rangeCount = 0;
+}
+
+b2ThreadPool::~b2ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_quit = true;
+	}
+	m_wake.notify_all();
+
+	for (int32 i = 0; i < m_threadCount; ++i)
+	{
+		m_threads[i].join();
+	}
+}
+
+void b2ThreadPool::ParallelFor(b2TaskFcn* task, void* context, int32 count, int32 rangeCount)
+{
+	rangeCount = b2Min(rangeCount, m_maxRangeCount);
+	if (rangeCount <= 1)
+	{
+		task(context, 0, count);
+		return;
+	}
+
+	std::lock_guard<std::mutex> call(m_callMutex);
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		// New workers start out waiting for the generation after this one.
+		while (m_threadCount < rangeCount - 1)
+		{
+			m_threads[m_threadCount] = std::thread(&b2ThreadPool::WorkerMain, this, m_threadCount, m_generation);
+			++m_threadCount;
+		}
+
+		m_task = task;
+		m_context = context;
+		m_count = count;
+		m_rangeCount = rangeCount;
+		m_pending = rangeCount - 1;
+		++m_generation;
+	}
+	m_wake.notify_all();
+
+	task(context, (count * (rangeCount - 1)) / rangeCount, count);
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+	while (m_pending > 0)
+	{
+		m_done.wait(lock);
+	}
+}
+
+void b2ThreadPool::WorkerMain(int32 index, uint32 generation)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	for (;;)
+	{
+		while (m_quit == false && m_generation == generation)
+		{
+			m_wake.wait(lock);
+		}
+
+		if (m_quit)
+		{
+			return;
+		}
+
+		generation = m_generation;
+
+		// Workers beyond this call's ranges have nothing to do.
+		if (index >= m_rangeCount - 1)
+		{
+			continue;
+		}
+
+		b2TaskFcn* task = m_task;
+		void* context = m_context;
+		int32 begin = (m_count * index) / m_rangeCount;
+		int32 end = (m_count * (index + 1)) / m_rangeCount;
+
+		lock.unlock();
+		task(context, begin, end);
+		lock.lock();
+
+		if (--m_pending == 0)
+		{
+			m_done.notify_one();
+		}
+	}
+}
@@ -0,0 +1,76 @@
+/*
+* Copyright (c) 2016 Erin Catto http://box2d.org
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef B2_THREAD_POOL_H
+#define B2_THREAD_POOL_H
+
+#include <Box2D/Common/b2Settings.h>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+/// A task run by b2ThreadPool on the elements [begin, end) of a range.
+typedef void b2TaskFcn(void* context, int32 begin, int32 end);
+
+/// A fixed set of worker threads for splitting a loop across cores. The threads are
+/// started by the first call that needs them and then sleep between calls, so a call
+/// costs a wake-up rather than creating and joining threads.
+class b2ThreadPool
+{
+public:
+	b2ThreadPool();
+	~b2ThreadPool();
+
+	/// Get the most ranges a call can run at once, one per hardware thread up to
+	/// b2_maxQueryThreads.
+	int32 GetMaxRangeCount() const { return m_maxRangeCount; }
+
+	/// Split [0, count) into rangeCount contiguous ranges and run the task on each,
+	/// one per thread. The calling thread takes the last range. Returns once every
+	/// range is done. Calls from different threads take turns.
+	void ParallelFor(b2TaskFcn* task, void* context, int32 count, int32 rangeCount);
+
+private:
+
+	b2ThreadPool(const b2ThreadPool&);
+	b2ThreadPool& operator=(const b2ThreadPool&);
+
+	void WorkerMain(int32 index, uint32 generation);
+
+	std::thread m_threads[b2_maxQueryThreads - 1];
+	int32 m_threadCount;
+	int32 m_maxRangeCount;
+
+	// Held for the whole of a call, so only one runs at a time.
+	std::mutex m_callMutex;
+
+	// Guards everything below.
+	std::mutex m_mutex;
+	std::condition_variable m_wake;
+	std::condition_variable m_done;
+	uint32 m_generation;
+	int32 m_pending;
+	bool m_quit;
+
+	b2TaskFcn* m_task;
+	void* m_context;
+	int32 m_count;
+	int32 m_rangeCount;
+};
+
+#endif
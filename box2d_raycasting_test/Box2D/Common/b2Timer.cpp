@@ -20,82 +20,61 @@
 
 #if defined(_WIN32)
 
-float64 b2Timer::s_invFrequency = 0.0f;
-
 #define WIN32_LEAN_AND_MEAN
 #include <windows.h>
 
-b2Timer::b2Timer()
+uint64 b2Timer::GetTimestamp()
 {
-	LARGE_INTEGER largeInteger;
-
-	if (s_invFrequency == 0.0f)
+	static uint64 frequency = 0;
+	if (frequency == 0)
 	{
+		LARGE_INTEGER largeInteger;
 		QueryPerformanceFrequency(&largeInteger);
-		s_invFrequency = float64(largeInteger.QuadPart);
-		if (s_invFrequency > 0.0f)
-		{
-			s_invFrequency = 1000.0f / s_invFrequency;
-		}
+		frequency = uint64(largeInteger.QuadPart);
 	}
 
-	QueryPerformanceCounter(&largeInteger);
-	m_start = float64(largeInteger.QuadPart);
-}
-
-void b2Timer::Reset()
-{
 	LARGE_INTEGER largeInteger;
 	QueryPerformanceCounter(&largeInteger);
-	m_start = float64(largeInteger.QuadPart);
-}
+	uint64 count = uint64(largeInteger.QuadPart);
 
-float32 b2Timer::GetMilliseconds() const
-{
-	LARGE_INTEGER largeInteger;
-	QueryPerformanceCounter(&largeInteger);
-	float64 count = float64(largeInteger.QuadPart);
-	float32 ms = float32(s_invFrequency * (count - m_start));
-	return ms;
+	// Split the conversion so the count can't overflow when scaled.
+	uint64 seconds = count / frequency;
+	uint64 remainder = count % frequency;
+	return seconds * 1000000000ull + remainder * 1000000000ull / frequency;
 }
 
 #elif defined(__linux__) || defined (__APPLE__)
 
-#include <sys/time.h>
+#include <time.h>
 
-b2Timer::b2Timer()
+uint64 b2Timer::GetTimestamp()
 {
-    Reset();
+	// gettimeofday only has microsecond resolution and follows changes to the wall clock.
+	timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return uint64(t.tv_sec) * 1000000000ull + uint64(t.tv_nsec);
 }
 
-void b2Timer::Reset()
-{
-    timeval t;
-    gettimeofday(&t, 0);
-    m_start_sec = t.tv_sec;
-    m_start_usec = t.tv_usec;
-}
+#else
 
-float32 b2Timer::GetMilliseconds() const
+uint64 b2Timer::GetTimestamp()
 {
-    timeval t;
-    gettimeofday(&t, 0);
-    return 1000.0f * (t.tv_sec - m_start_sec) + 0.001f * (t.tv_usec - m_start_usec);
+	return 0;
 }
 
-#else
+#endif
 
 b2Timer::b2Timer()
 {
+	Reset();
 }
 
 void b2Timer::Reset()
 {
+	m_start = GetTimestamp();
 }
 
 float32 b2Timer::GetMilliseconds() const
 {
-	return 0.0f;
+	return float32(float64(GetTimestamp() - m_start) * 1.0e-6);
 }
-
-#endif
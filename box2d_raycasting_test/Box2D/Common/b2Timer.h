@@ -36,15 +36,13 @@ public:
 	/// Get the time since construction or the last reset.
 	float32 GetMilliseconds() const;
 
+	/// Get the time in nanoseconds from a monotonic clock. Only differences between
+	/// time stamps are meaningful.
+	static uint64 GetTimestamp();
+
 private:
 
-#if defined(_WIN32)
-	float64 m_start;
-	static float64 s_invFrequency;
-#elif defined(__linux__) || defined (__APPLE__)
-	unsigned long m_start_sec;
-	unsigned long m_start_usec;
-#endif
+	uint64 m_start;
 };
 
 #endif
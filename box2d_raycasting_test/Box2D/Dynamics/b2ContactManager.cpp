@@ -21,11 +21,13 @@
 #include <Box2D/Dynamics/b2Fixture.h>
 #include <Box2D/Dynamics/b2WorldCallbacks.h>
 #include <Box2D/Dynamics/Contacts/b2Contact.h>
+#include <Box2D/Common/b2Profiler.h>
 
 b2ContactFilter b2_defaultFilter;
 b2ContactListener b2_defaultListener;
 
-b2ContactManager::b2ContactManager()
+b2ContactManager::b2ContactManager(const b2Allocator& allocator)
+	: m_broadPhase(allocator)
 {
 	m_contactList = NULL;
 	m_contactCount = 0;
@@ -104,6 +106,8 @@ void b2ContactManager::Destroy(b2Contact* c)
 // contact list.
 void b2ContactManager::Collide()
 {
+	b2ProfileScope("b2ContactManager::Collide");
+
 	// Update awake contacts.
 	b2Contact* c = m_contactList;
 	while (c)
@@ -30,7 +30,7 @@ class b2BlockAllocator;
 class b2ContactManager
 {
 public:
-	b2ContactManager();
+	explicit b2ContactManager(const b2Allocator& allocator = b2Allocator());
 
 	// Broad-phase callback.
 	void AddPair(void* proxyUserDataA, void* proxyUserDataB);
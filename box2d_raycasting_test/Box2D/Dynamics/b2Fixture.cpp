@@ -53,6 +53,13 @@ void b2Fixture::Create(b2BlockAllocator* allocator, b2Body* body, const b2Fixtur
 
 	m_shape = def->shape->Clone(allocator);
 
+	b2World* world = body->GetWorld();
+	++world->m_fixtureCount;
+	if (m_shape->m_type == b2Shape::e_chain)
+	{
+		++world->m_chainShapeCount;
+	}
+
 	// Reserve proxy space
 	int32 childCount = m_shape->GetChildCount();
 	m_proxies = (b2FixtureProxy*)allocator->Allocate(childCount * sizeof(b2FixtureProxy));
@@ -76,6 +83,13 @@ void b2Fixture::Destroy(b2BlockAllocator* allocator)
 	allocator->Free(m_proxies, childCount * sizeof(b2FixtureProxy));
 	m_proxies = NULL;
 
+	b2World* world = m_body->GetWorld();
+	--world->m_fixtureCount;
+	if (m_shape->m_type == b2Shape::e_chain)
+	{
+		--world->m_chainShapeCount;
+	}
+
 	// Free the child shape.
 	switch (m_shape->m_type)
 	{
@@ -130,7 +144,7 @@ void b2Fixture::CreateProxies(b2BroadPhase* broadPhase, const b2Transform& xf)
 	{
 		b2FixtureProxy* proxy = m_proxies + i;
 		m_shape->ComputeAABB(&proxy->aabb, xf, i);
-		proxy->proxyId = broadPhase->CreateProxy(proxy->aabb, proxy);
+		proxy->proxyId = broadPhase->CreateProxy(proxy->aabb, proxy, m_body->GetType() == b2_staticBody, m_filter.categoryBits);
 		proxy->fixture = this;
 		proxy->childIndex = i;
 	}
@@ -213,6 +227,7 @@ void b2Fixture::Refilter()
 	b2BroadPhase* broadPhase = &world->m_contactManager.m_broadPhase;
 	for (int32 i = 0; i < m_proxyCount; ++i)
 	{
+		broadPhase->SetCategoryBits(m_proxies[i].proxyId, m_filter.categoryBits);
 		broadPhase->TouchProxy(m_proxies[i].proxyId);
 	}
 }
@@ -289,6 +304,10 @@ void b2Fixture::Dump(int32 bodyIndex)
 			b2Log("    shape.m_nextVertex.Set(%.15lef, %.15lef);\n", s->m_nextVertex.x, s->m_nextVertex.y);
 			b2Log("    shape.m_hasPrevVertex = bool(%d);\n", s->m_hasPrevVertex);
 			b2Log("    shape.m_hasNextVertex = bool(%d);\n", s->m_hasNextVertex);
+			if (s->HasSegmentTree())
+			{
+				b2Log("    shape.CreateSegmentTree();\n");
+			}
 		}
 		break;
 
@@ -161,6 +161,10 @@ public:
 	/// @param input the ray-cast input parameters.
 	bool RayCast(b2RayCastOutput* output, const b2RayCastInput& input, int32 childIndex) const;
 
+	/// Test if a segment hits this shape, without computing hit data.
+	/// @param input the segment parameters.
+	bool TestSegment(const b2RayCastInput& input, int32 childIndex) const;
+
 	/// Get the mass data for this fixture. The mass data is based on the density and
 	/// the shape. The rotational inertia is about the shape's origin. This operation
 	/// may be expensive.
@@ -201,6 +205,7 @@ protected:
 	friend class b2World;
 	friend class b2Contact;
 	friend class b2ContactManager;
+	friend class b2QuerySnapshot;
 
 	b2Fixture();
 
@@ -331,6 +336,11 @@ inline bool b2Fixture::RayCast(b2RayCastOutput* output, const b2RayCastInput& in
 	return m_shape->RayCast(output, input, m_body->GetTransform(), childIndex);
 }
 
+inline bool b2Fixture::TestSegment(const b2RayCastInput& input, int32 childIndex) const
+{
+	return m_shape->TestSegment(input, m_body->GetTransform(), childIndex);
+}
+
 inline void b2Fixture::GetMassData(b2MassData* massData) const
 {
 	m_shape->ComputeMass(massData, m_density);
@@ -0,0 +1,230 @@
+/*
+* Copyright (c) 2006-2011 Erin Catto http://www.box2d.org
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include <Box2D/Dynamics/b2QuerySnapshot.h>
+#include <Box2D/Dynamics/b2Fixture.h>
+#include <Box2D/Dynamics/b2WorldCallbacks.h>
+#include <Box2D/Collision/b2BroadPhase.h>
+
+b2QuerySnapshot::b2QuerySnapshot(const b2Allocator& allocator)
+	: m_allocator(allocator)
+{
+	for (int32 i = 0; i < 2; ++i)
+	{
+		m_nodes[i] = NULL;
+		m_proxies[i] = NULL;
+		m_capacity[i] = 0;
+		m_root[i] = b2_nullNode;
+		m_generation[i] = 0;
+	}
+
+	m_memory = NULL;
+	m_copyCount = 0;
+	m_prev = NULL;
+	m_next = NULL;
+}
+
+b2QuerySnapshot::~b2QuerySnapshot()
+{
+	FreeMemory();
+}
+
+void b2QuerySnapshot::FreeMemory()
+{
+	int32 capacity = m_capacity[0] + m_capacity[1];
+	m_allocator.Free(m_memory, capacity * (sizeof(b2SnapshotNode) + sizeof(b2SnapshotProxy)), b2_snapshotMemory);
+	m_memory = NULL;
+}
+
+void b2QuerySnapshot::CopyNode(int32 tree, const b2DynamicTree* source, int32 nodeId)
+{
+	const b2TreeNode* node = source->m_nodes + nodeId;
+	if (node->height < 0)
+	{
+		// Free nodes can't be reached from the root.
+		return;
+	}
+
+	b2SnapshotNode* copy = m_nodes[tree] + nodeId;
+	copy->aabb = node->aabb;
+	copy->child1 = node->child1;
+	copy->child2 = node->child2;
+	copy->categoryBits = node->categoryBits;
+	++m_copyCount;
+
+	if (node->IsLeaf())
+	{
+		const b2FixtureProxy* fixtureProxy = (const b2FixtureProxy*)node->userData;
+		const b2Fixture* fixture = fixtureProxy->fixture;
+		const b2Body* body = fixture->GetBody();
+
+		b2SnapshotProxy* proxy = m_proxies[tree] + nodeId;
+		proxy->fixture = fixtureProxy->fixture;
+		proxy->shape = fixture->GetShape();
+		proxy->body = body;
+		proxy->transform = body->GetTransform();
+		proxy->shape->ComputeAABB(&proxy->aabb, proxy->transform, fixtureProxy->childIndex);
+		proxy->childIndex = fixtureProxy->childIndex;
+		proxy->bodyType = body->GetType();
+	}
+}
+
+void b2QuerySnapshot::Update(const b2BroadPhase* broadPhase)
+{
+	const b2DynamicTree* trees[2];
+	trees[b2BroadPhase::e_dynamicTree] = &broadPhase->m_tree;
+	trees[b2BroadPhase::e_staticTree] = &broadPhase->m_staticTree;
+
+	m_copyCount = 0;
+
+	// The node arrays only grow, so a snapshot of a different size needs a new block.
+	bool fullCopy[2];
+	if (m_capacity[0] != trees[0]->m_nodeCapacity || m_capacity[1] != trees[1]->m_nodeCapacity)
+	{
+		FreeMemory();
+
+		int32 capacity = trees[0]->m_nodeCapacity + trees[1]->m_nodeCapacity;
+		m_memory = m_allocator.Allocate(capacity * (sizeof(b2SnapshotNode) + sizeof(b2SnapshotProxy)), b2_snapshotMemory);
+
+		// Nodes first, as they are what traversal touches.
+		m_nodes[0] = (b2SnapshotNode*)m_memory;
+		m_nodes[1] = m_nodes[0] + trees[0]->m_nodeCapacity;
+		m_proxies[0] = (b2SnapshotProxy*)(m_nodes[1] + trees[1]->m_nodeCapacity);
+		m_proxies[1] = m_proxies[0] + trees[0]->m_nodeCapacity;
+
+		for (int32 i = 0; i < 2; ++i)
+		{
+			m_capacity[i] = trees[i]->m_nodeCapacity;
+			fullCopy[i] = true;
+		}
+	}
+	else
+	{
+		for (int32 i = 0; i < 2; ++i)
+		{
+			fullCopy[i] = m_generation[i] < trees[i]->m_fullChangeGeneration;
+		}
+	}
+
+	for (int32 i = 0; i < 2; ++i)
+	{
+		const b2DynamicTree* tree = trees[i];
+		b2Assert(tree->m_trackChanges);
+
+		if (fullCopy[i])
+		{
+			for (int32 nodeId = 0; nodeId < tree->m_nodeCapacity; ++nodeId)
+			{
+				CopyNode(i, tree, nodeId);
+			}
+		}
+		else
+		{
+			// Copy the nodes that changed after the last update. Later entries can't
+			// belong to earlier generations, so walk the log back to front.
+			for (int32 j = tree->m_changeCount - 1; j >= 0; --j)
+			{
+				const b2TreeChange* change = tree->m_changeLog + j;
+				if (change->generation <= m_generation[i])
+				{
+					break;
+				}
+
+				CopyNode(i, tree, change->nodeId);
+			}
+		}
+
+		m_root[i] = tree->m_root;
+		m_generation[i] = tree->m_generation;
+	}
+}
+
+struct b2SnapshotQueryWrapper
+{
+	bool ReportProxy(const b2SnapshotProxy& proxy)
+	{
+		return callback->ReportFixture(proxy.fixture);
+	}
+
+	b2QueryCallback* callback;
+};
+
+void b2QuerySnapshot::QueryAABB(b2QueryCallback* callback, const b2AABB& aabb, uint16 maskBits) const
+{
+	b2SnapshotQueryWrapper wrapper;
+	wrapper.callback = callback;
+	QueryProxies(&wrapper, aabb, maskBits);
+}
+
+struct b2SnapshotRayCastWrapper
+{
+	float32 RayCastCallback(const b2RayCastInput& input, const b2SnapshotProxy& proxy)
+	{
+		b2RayCastOutput output;
+		bool hit = proxy.shape->RayCast(&output, input, proxy.transform, proxy.childIndex);
+
+		if (hit)
+		{
+			float32 fraction = output.fraction;
+			b2Vec2 point = (1.0f - fraction) * input.p1 + fraction * input.p2;
+			float32 value = callback->ReportFixture(proxy.fixture, point, output.normal, fraction);
+			if (value == 0.0f)
+			{
+				terminated = true;
+			}
+			else if (value > 0.0f)
+			{
+				maxFraction = value;
+			}
+			return value;
+		}
+
+		return input.maxFraction;
+	}
+
+	b2RayCastCallback* callback;
+	float32 maxFraction;
+	bool terminated;
+};
+
+b2TreeStats b2QuerySnapshot::RayCast(b2RayCastCallback* callback, const b2Vec2& point1, const b2Vec2& point2,
+									 uint16 maskBits) const
+{
+	b2SnapshotRayCastWrapper wrapper;
+	wrapper.callback = callback;
+	wrapper.maxFraction = 1.0f;
+	wrapper.terminated = false;
+
+	b2RayCastInput input;
+	input.maxFraction = 1.0f;
+	input.p1 = point1;
+	input.p2 = point2;
+
+	// Cast against static geometry first to clip the ray, as the broad-phase does.
+	b2TreeStats stats = RayCastTree(&wrapper, b2BroadPhase::e_staticTree, input, maskBits);
+	if (wrapper.terminated)
+	{
+		return stats;
+	}
+
+	input.maxFraction = wrapper.maxFraction;
+	b2TreeStats dynamicStats = RayCastTree(&wrapper, b2BroadPhase::e_dynamicTree, input, maskBits);
+	stats.nodeVisits += dynamicStats.nodeVisits;
+	stats.leafVisits += dynamicStats.leafVisits;
+	return stats;
+}
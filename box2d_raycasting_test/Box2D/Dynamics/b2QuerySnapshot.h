@@ -0,0 +1,302 @@
+/*
+* Copyright (c) 2006-2011 Erin Catto http://www.box2d.org
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef B2_QUERY_SNAPSHOT_H
+#define B2_QUERY_SNAPSHOT_H
+
+#include <Box2D/Collision/b2DynamicTree.h>
+#include <Box2D/Common/b2Allocator.h>
+#include <Box2D/Common/b2GrowableStack.h>
+#include <Box2D/Dynamics/b2Body.h>
+
+class b2BroadPhase;
+class b2Fixture;
+class b2QueryCallback;
+class b2RayCastCallback;
+class b2Shape;
+
+/// A fixture proxy as it was when the snapshot was last updated.
+struct b2SnapshotProxy
+{
+	b2Fixture* fixture;
+	const b2Shape* shape;
+	const b2Body* body;
+	b2Transform transform;
+	b2AABB aabb;	///< tight AABB of the child shape
+	int32 childIndex;
+	b2BodyType bodyType;
+};
+
+/// A broad-phase tree node stripped down to what queries need.
+struct b2SnapshotNode
+{
+	bool IsLeaf() const
+	{
+		return child1 == b2_nullNode;
+	}
+
+	b2AABB aabb;
+	int32 child1;
+	int32 child2;
+	uint16 categoryBits;
+};
+
+/// A read-only copy of the broad-phase trees of a world, with the shape and transform
+/// of every fixture proxy. Create one with b2World::CreateQuerySnapshot and bring it up
+/// to date with b2World::UpdateQuerySnapshot.
+///
+/// Queries only read the snapshot, so any number of threads may query it while the
+/// world steps. It must not be queried while it is being updated; keep two snapshots
+/// and alternate between them to update one while the other is in use.
+///
+/// All of the snapshot data lives in one allocation. Updates copy only the tree nodes
+/// and proxies that changed since the snapshot was last updated, so their cost scales
+/// with the number of moving proxies rather than with the size of the world.
+///
+/// Shapes are not copied, so fixtures must not be destroyed while a snapshot that
+/// holds them is being queried. The fixtures reported to callbacks should only be
+/// used to identify them or to read data that doesn't change during a step.
+class b2QuerySnapshot
+{
+public:
+
+	/// Query the snapshot for all fixtures that potentially overlap the provided AABB.
+	/// @param callback a user implemented callback class.
+	/// @param aabb the query box.
+	/// @param maskBits the categories the query can find.
+	void QueryAABB(b2QueryCallback* callback, const b2AABB& aabb, uint16 maskBits = b2_allCategories) const;
+
+	/// Query the snapshot for proxies whose fat AABB overlaps the provided AABB. The
+	/// callback class implements bool ReportProxy(const b2SnapshotProxy& proxy) and
+	/// returns false to stop the query. Static proxies are reported first.
+	template <typename T>
+	void QueryProxies(T* callback, const b2AABB& aabb, uint16 maskBits = b2_allCategories) const;
+
+	/// Ray-cast the snapshot for all fixtures in the path of the ray. Works like
+	/// b2World::RayCast.
+	/// @param callback a user implemented callback class.
+	/// @param point1 the ray starting point
+	/// @param point2 the ray ending point
+	/// @param maskBits the categories the ray can hit.
+	/// @return how many nodes and proxies the ray visited.
+	b2TreeStats RayCast(b2RayCastCallback* callback, const b2Vec2& point1, const b2Vec2& point2,
+						uint16 maskBits = b2_allCategories) const;
+
+	/// Get the number of nodes copied by the last update. For profiling.
+	int32 GetUpdateCopyCount() const;
+
+	/// Get the size of the snapshot in bytes.
+	int32 GetByteCount() const;
+
+private:
+
+	friend class b2World;
+
+	explicit b2QuerySnapshot(const b2Allocator& allocator);
+	~b2QuerySnapshot();
+
+	b2QuerySnapshot(const b2QuerySnapshot&);
+	b2QuerySnapshot& operator=(const b2QuerySnapshot&);
+
+	void Update(const b2BroadPhase* broadPhase);
+	void FreeMemory();
+	void CopyNode(int32 tree, const b2DynamicTree* source, int32 nodeId);
+
+	template <typename T>
+	void QueryTree(T* callback, int32 tree, const b2AABB& aabb, uint16 maskBits) const;
+
+	template <typename T>
+	b2TreeStats RayCastTree(T* callback, int32 tree, const b2RayCastInput& input, uint16 maskBits) const;
+
+	// Indexed by broad-phase tree: dynamic, then static. The node and proxy arrays are
+	// parallel, with proxies only filled in for leaves. They all point into m_memory.
+	b2SnapshotNode* m_nodes[2];
+	b2SnapshotProxy* m_proxies[2];
+	int32 m_capacity[2];
+	int32 m_root[2];
+	uint32 m_generation[2];
+
+	b2Allocator m_allocator;
+	void* m_memory;
+	int32 m_copyCount;
+
+	// The world keeps a list of its snapshots to know which changes are still needed.
+	b2QuerySnapshot* m_prev;
+	b2QuerySnapshot* m_next;
+};
+
+inline int32 b2QuerySnapshot::GetUpdateCopyCount() const
+{
+	return m_copyCount;
+}
+
+inline int32 b2QuerySnapshot::GetByteCount() const
+{
+	int32 capacity = m_capacity[0] + m_capacity[1];
+	return sizeof(b2QuerySnapshot) + capacity * (sizeof(b2SnapshotNode) + sizeof(b2SnapshotProxy));
+}
+
+template <typename T>
+inline void b2QuerySnapshot::QueryProxies(T* callback, const b2AABB& aabb, uint16 maskBits) const
+{
+	QueryTree(callback, 1, aabb, maskBits);
+	QueryTree(callback, 0, aabb, maskBits);
+}
+
+template <typename T>
+inline void b2QuerySnapshot::QueryTree(T* callback, int32 tree, const b2AABB& aabb, uint16 maskBits) const
+{
+	const b2SnapshotNode* nodes = m_nodes[tree];
+
+	b2GrowableStack<int32, 256> stack;
+	stack.Push(m_root[tree]);
+
+	while (stack.GetCount() > 0)
+	{
+		int32 nodeId = stack.Pop();
+		if (nodeId == b2_nullNode)
+		{
+			continue;
+		}
+
+		const b2SnapshotNode* node = nodes + nodeId;
+
+		if (b2MaskExcludes(node->categoryBits, maskBits))
+		{
+			continue;
+		}
+
+		if (b2TestOverlap(node->aabb, aabb))
+		{
+			if (node->IsLeaf())
+			{
+				bool proceed = callback->ReportProxy(m_proxies[tree][nodeId]);
+				if (proceed == false)
+				{
+					return;
+				}
+			}
+			else
+			{
+				stack.Push(node->child1);
+				stack.Push(node->child2);
+			}
+		}
+	}
+}
+
+template <typename T>
+inline b2TreeStats b2QuerySnapshot::RayCastTree(T* callback, int32 tree, const b2RayCastInput& input, uint16 maskBits) const
+{
+	b2TreeStats stats = { 0, 0 };
+	const b2SnapshotNode* nodes = m_nodes[tree];
+
+	b2Vec2 p1 = input.p1;
+	b2Vec2 p2 = input.p2;
+	b2Vec2 r = p2 - p1;
+	b2Assert(r.LengthSquared() > 0.0f);
+	r.Normalize();
+
+	// v is perpendicular to the segment.
+	b2Vec2 v = b2Cross(1.0f, r);
+	b2Vec2 abs_v = b2Abs(v);
+
+	// Separating axis for segment (Gino, p80).
+	// |dot(v, p1 - c)| > dot(|v|, h)
+
+	float32 maxFraction = input.maxFraction;
+
+	// Build a bounding box for the segment.
+	b2AABB segmentAABB;
+	{
+		b2Vec2 t = p1 + maxFraction * (p2 - p1);
+		segmentAABB.lowerBound = b2Min(p1, t);
+		segmentAABB.upperBound = b2Max(p1, t);
+	}
+
+	b2GrowableStack<int32, 256> stack;
+	stack.Push(m_root[tree]);
+
+	while (stack.GetCount() > 0)
+	{
+		int32 nodeId = stack.Pop();
+		if (nodeId == b2_nullNode)
+		{
+			continue;
+		}
+
+		const b2SnapshotNode* node = nodes + nodeId;
+
+		if (b2MaskExcludes(node->categoryBits, maskBits))
+		{
+			continue;
+		}
+
+		++stats.nodeVisits;
+
+		if (b2TestOverlap(node->aabb, segmentAABB) == false)
+		{
+			continue;
+		}
+
+		// Separating axis for segment (Gino, p80).
+		// |dot(v, p1 - c)| > dot(|v|, h)
+		b2Vec2 c = node->aabb.GetCenter();
+		b2Vec2 h = node->aabb.GetExtents();
+		float32 separation = b2Abs(b2Dot(v, p1 - c)) - b2Dot(abs_v, h);
+		if (separation > 0.0f)
+		{
+			continue;
+		}
+
+		if (node->IsLeaf())
+		{
+			b2RayCastInput subInput;
+			subInput.p1 = input.p1;
+			subInput.p2 = input.p2;
+			subInput.maxFraction = maxFraction;
+
+			++stats.leafVisits;
+			float32 value = callback->RayCastCallback(subInput, m_proxies[tree][nodeId]);
+
+			if (value == 0.0f)
+			{
+				// The client has terminated the ray cast.
+				return stats;
+			}
+
+			if (value > 0.0f)
+			{
+				// Update segment bounding box.
+				maxFraction = value;
+				b2Vec2 t = p1 + maxFraction * (p2 - p1);
+				segmentAABB.lowerBound = b2Min(p1, t);
+				segmentAABB.upperBound = b2Max(p1, t);
+			}
+		}
+		else
+		{
+			stack.Push(node->child1);
+			stack.Push(node->child2);
+		}
+	}
+
+	return stats;
+}
+
+#endif
@@ -20,6 +20,7 @@
 #include <Box2D/Dynamics/b2Body.h>
 #include <Box2D/Dynamics/b2Fixture.h>
 #include <Box2D/Dynamics/b2Island.h>
+#include <Box2D/Dynamics/b2QuerySnapshot.h>
 #include <Box2D/Dynamics/Joints/b2PulleyJoint.h>
 #include <Box2D/Dynamics/Contacts/b2Contact.h>
 #include <Box2D/Dynamics/Contacts/b2ContactSolver.h>
@@ -31,19 +32,27 @@
 #include <Box2D/Collision/Shapes/b2PolygonShape.h>
 #include <Box2D/Collision/b2TimeOfImpact.h>
 #include <Box2D/Common/b2Draw.h>
+#include <Box2D/Common/b2Profiler.h>
 #include <Box2D/Common/b2Timer.h>
 #include <new>
 
-b2World::b2World(const b2Vec2& gravity)
+b2World::b2World(const b2Vec2& gravity, const b2Allocator& allocator)
+	: m_allocator(allocator)
+	, m_blockAllocator(allocator)
+	, m_stackAllocator(allocator)
+	, m_contactManager(allocator)
 {
 	m_destructionListener = NULL;
 	g_debugDraw = NULL;
 
 	m_bodyList = NULL;
 	m_jointList = NULL;
+	m_snapshotList = NULL;
 
 	m_bodyCount = 0;
 	m_jointCount = 0;
+	m_fixtureCount = 0;
+	m_chainShapeCount = 0;
 
 	m_warmStarting = true;
 	m_continuousPhysics = true;
@@ -61,27 +70,67 @@ b2World::b2World(const b2Vec2& gravity)
 	m_contactManager.m_allocator = &m_blockAllocator;
 
 	memset(&m_profile, 0, sizeof(b2Profile));
+
+	memset(&m_memoryStats, 0, sizeof(b2MemoryStats));
+	ComputeMemoryStats(&m_memoryStats);
 }
 
 b2World::~b2World()
 {
-	// Some shapes allocate using b2Alloc.
-	b2Body* b = m_bodyList;
-	while (b)
+	while (m_snapshotList)
+	{
+		DestroyQuerySnapshot(m_snapshotList);
+	}
+
+	// Everything else goes with the block allocator.
+	ReleaseChainShapes();
+}
+
+void b2World::Clear()
+{
+	b2Assert(IsLocked() == false);
+	if (IsLocked())
+	{
+		return;
+	}
+
+	ReleaseChainShapes();
+
+	m_blockAllocator.Clear();
+	m_contactManager.m_broadPhase.Clear();
+	m_contactManager.m_contactList = NULL;
+	m_contactManager.m_contactCount = 0;
+
+	m_bodyList = NULL;
+	m_jointList = NULL;
+	m_bodyCount = 0;
+	m_jointCount = 0;
+	m_fixtureCount = 0;
+
+	m_flags &= ~e_newFixture;
+	m_stepComplete = true;
+}
+
+// Chain shapes allocate their vertices using b2Alloc.
+void b2World::ReleaseChainShapes()
+{
+	if (m_chainShapeCount == 0)
 	{
-		b2Body* bNext = b->m_next;
+		return;
+	}
 
-		b2Fixture* f = b->m_fixtureList;
-		while (f)
+	for (b2Body* b = m_bodyList; b; b = b->m_next)
+	{
+		for (b2Fixture* f = b->m_fixtureList; f; f = f->m_next)
 		{
-			b2Fixture* fNext = f->m_next;
-			f->m_proxyCount = 0;
-			f->Destroy(&m_blockAllocator);
-			f = fNext;
+			if (f->m_shape->m_type == b2Shape::e_chain)
+			{
+				f->m_shape->~b2Shape();
+			}
 		}
-
-		b = bNext;
 	}
+
+	m_chainShapeCount = 0;
 }
 
 void b2World::SetDestructionListener(b2DestructionListener* listener)
@@ -128,6 +177,121 @@ b2Body* b2World::CreateBody(const b2BodyDef* def)
 	return b;
 }
 
+void b2World::CreateStaticBodies(const b2BodyDef* bodyDefs, const b2FixtureDef* fixtureDefs, int32 count,
+								 b2Body** bodies)
+{
+	b2Assert(IsLocked() == false);
+	if (IsLocked() || count <= 0)
+	{
+		return;
+	}
+
+	// Allocate all the bodies before the fixtures so the bodies end up next to each
+	// other in the block allocator's chunks.
+	b2Body** created = bodies;
+	if (created == NULL)
+	{
+		created = (b2Body**)m_allocator.Allocate(count * sizeof(b2Body*), b2_worldMemory);
+	}
+
+	for (int32 i = 0; i < count; ++i)
+	{
+		b2Assert(bodyDefs[i].type == b2_staticBody);
+		void* mem = m_blockAllocator.Allocate(sizeof(b2Body));
+		created[i] = new (mem) b2Body(bodyDefs + i, this);
+	}
+
+	int32 proxyCount = 0;
+	for (int32 i = 0; i < count; ++i)
+	{
+		b2Body* b = created[i];
+
+		void* mem = m_blockAllocator.Allocate(sizeof(b2Fixture));
+		b2Fixture* fixture = new (mem) b2Fixture;
+		fixture->Create(&m_blockAllocator, b, fixtureDefs + i);
+
+		b->m_fixtureList = fixture;
+		b->m_fixtureCount = 1;
+
+		if (b->m_flags & b2Body::e_activeFlag)
+		{
+			proxyCount += fixture->m_shape->GetChildCount();
+		}
+
+		// Add to world doubly linked list.
+		b->m_prev = NULL;
+		b->m_next = m_bodyList;
+		if (m_bodyList)
+		{
+			m_bodyList->m_prev = b;
+		}
+		m_bodyList = b;
+	}
+	m_bodyCount += count;
+
+	// Gather the proxies of every child of every active fixture and insert them in
+	// one batch.
+	if (proxyCount > 0)
+	{
+		int32 aabbSize = proxyCount * sizeof(b2AABB);
+		int32 userDataSize = proxyCount * sizeof(void*);
+		int32 proxyIdSize = proxyCount * sizeof(int32);
+		int32 categorySize = proxyCount * sizeof(uint16);
+		int32 memSize = aabbSize + userDataSize + proxyIdSize + categorySize;
+		int8* mem = (int8*)m_allocator.Allocate(memSize, b2_worldMemory);
+		b2AABB* aabbs = (b2AABB*)mem;
+		void** userData = (void**)(mem + aabbSize);
+		int32* proxyIds = (int32*)(mem + aabbSize + userDataSize);
+		uint16* categoryBits = (uint16*)(mem + aabbSize + userDataSize + proxyIdSize);
+
+		int32 index = 0;
+		for (int32 i = 0; i < count; ++i)
+		{
+			b2Body* b = created[i];
+			if ((b->m_flags & b2Body::e_activeFlag) == 0)
+			{
+				continue;
+			}
+
+			b2Fixture* fixture = b->m_fixtureList;
+			int32 childCount = fixture->m_shape->GetChildCount();
+			for (int32 j = 0; j < childCount; ++j)
+			{
+				b2FixtureProxy* proxy = fixture->m_proxies + j;
+				fixture->m_shape->ComputeAABB(&proxy->aabb, b->m_xf, j);
+				proxy->fixture = fixture;
+				proxy->childIndex = j;
+
+				aabbs[index] = proxy->aabb;
+				userData[index] = proxy;
+				categoryBits[index] = fixture->m_filter.categoryBits;
+				++index;
+			}
+		}
+		b2Assert(index == proxyCount);
+
+		m_contactManager.m_broadPhase.CreateStaticProxies(aabbs, userData, categoryBits, proxyCount, proxyIds);
+
+		for (int32 i = 0; i < proxyCount; ++i)
+		{
+			b2FixtureProxy* proxy = (b2FixtureProxy*)userData[i];
+			proxy->proxyId = proxyIds[i];
+			++proxy->fixture->m_proxyCount;
+		}
+
+		m_allocator.Free(mem, memSize, b2_worldMemory);
+	}
+
+	if (created != bodies)
+	{
+		m_allocator.Free(created, count * sizeof(b2Body*), b2_worldMemory);
+	}
+
+	// Static bodies have no mass, so there is no mass data to reset. New contacts
+	// with dynamic bodies are created at the beginning of the next time step.
+	m_flags |= e_newFixture;
+}
+
 void b2World::DestroyBody(b2Body* b)
 {
 	b2Assert(m_bodyCount > 0);
@@ -385,6 +549,8 @@ void b2World::SetAllowSleeping(bool flag)
 // Find islands, integrate and solve constraints, solve position constraints
 void b2World::Solve(const b2TimeStep& step)
 {
+	b2ProfileScope("b2World::Solve");
+
 	m_profile.solveInit = 0.0f;
 	m_profile.solveVelocity = 0.0f;
 	m_profile.solvePosition = 0.0f;
@@ -576,6 +742,8 @@ void b2World::Solve(const b2TimeStep& step)
 // Find TOI contacts and solve them.
 void b2World::SolveTOI(const b2TimeStep& step)
 {
+	b2ProfileScope("b2World::SolveTOI");
+
 	b2Island island(2 * b2_maxTOIContacts, b2_maxTOIContacts, 0, &m_stackAllocator, m_contactManager.m_contactListener);
 
 	if (m_stepComplete)
@@ -679,15 +847,24 @@ void b2World::SolveTOI(const b2TimeStep& step)
 				int32 indexB = c->GetChildIndexB();
 
 				// Compute the time of impact in interval [0, minTOI]
-				b2TOIInput input;
-				input.proxyA.Set(fA->GetShape(), indexA);
-				input.proxyB.Set(fB->GetShape(), indexB);
-				input.sweepA = bA->m_sweep;
-				input.sweepB = bB->m_sweep;
-				input.tMax = 1.0f;
-
 				b2TOIOutput output;
-				b2TimeOfImpact(&output, &input);
+				const b2Shape* shapeA = fA->GetShape();
+				if (shapeA->GetType() == b2Shape::e_chain && ((b2ChainShape*)shapeA)->HasSegmentTree())
+				{
+					b2TimeOfImpact(&output, (b2ChainShape*)shapeA, bA->m_sweep,
+								   fB->GetShape(), indexB, bB->m_sweep, 1.0f);
+				}
+				else
+				{
+					b2TOIInput input;
+					input.proxyA.Set(shapeA, indexA);
+					input.proxyB.Set(fB->GetShape(), indexB);
+					input.sweepA = bA->m_sweep;
+					input.sweepB = bB->m_sweep;
+					input.tMax = 1.0f;
+
+					b2TimeOfImpact(&output, &input);
+				}
 
 				// Beta is the fraction of the remaining portion of the .
 				float32 beta = output.t;
@@ -896,6 +1073,7 @@ void b2World::SolveTOI(const b2TimeStep& step)
 
 void b2World::Step(float32 dt, int32 velocityIterations, int32 positionIterations)
 {
+	b2ProfileScope("b2World::Step");
 	b2Timer stepTimer;
 
 	// If new fixtures were added, we need to find the new contacts.
@@ -960,6 +1138,12 @@ void b2World::Step(float32 dt, int32 velocityIterations, int32 positionIteration
 	m_flags &= ~e_locked;
 
 	m_profile.step = stepTimer.GetMilliseconds();
+
+	// Contacts peak here, as new contacts are found at the end of Solve.
+	if (m_flags & e_sampleMemory)
+	{
+		ComputeMemoryStats(&m_memoryStats);
+	}
 }
 
 void b2World::ClearForces()
@@ -984,11 +1168,16 @@ struct b2WorldQueryWrapper
 };
 
 void b2World::QueryAABB(b2QueryCallback* callback, const b2AABB& aabb) const
+{
+	QueryAABB(callback, aabb, b2_allCategories);
+}
+
+void b2World::QueryAABB(b2QueryCallback* callback, const b2AABB& aabb, uint16 maskBits) const
 {
 	b2WorldQueryWrapper wrapper;
 	wrapper.broadPhase = &m_contactManager.m_broadPhase;
 	wrapper.callback = callback;
-	m_contactManager.m_broadPhase.Query(&wrapper, aabb);
+	m_contactManager.m_broadPhase.Query(&wrapper, aabb, maskBits);
 }
 
 struct b2WorldRayCastWrapper
@@ -1016,7 +1205,13 @@ struct b2WorldRayCastWrapper
 	b2RayCastCallback* callback;
 };
 
-void b2World::RayCast(b2RayCastCallback* callback, const b2Vec2& point1, const b2Vec2& point2) const
+b2TreeStats b2World::RayCast(b2RayCastCallback* callback, const b2Vec2& point1, const b2Vec2& point2) const
+{
+	return RayCast(callback, point1, point2, b2_allCategories);
+}
+
+b2TreeStats b2World::RayCast(b2RayCastCallback* callback, const b2Vec2& point1, const b2Vec2& point2, uint16 maskBits,
+							 b2TreeNodeCallback* nodeCallback) const
 {
 	b2WorldRayCastWrapper wrapper;
 	wrapper.broadPhase = &m_contactManager.m_broadPhase;
@@ -1025,7 +1220,247 @@ void b2World::RayCast(b2RayCastCallback* callback, const b2Vec2& point1, const b
 	input.maxFraction = 1.0f;
 	input.p1 = point1;
 	input.p2 = point2;
-	m_contactManager.m_broadPhase.RayCast(&wrapper, input);
+	return m_contactManager.m_broadPhase.RayCast(&wrapper, input, maskBits, nodeCallback);
+}
+
+b2QuerySnapshot* b2World::CreateQuerySnapshot()
+{
+	b2Assert(IsLocked() == false);
+	if (IsLocked())
+	{
+		return NULL;
+	}
+
+	void* mem = m_allocator.Allocate(sizeof(b2QuerySnapshot), b2_snapshotMemory);
+	b2QuerySnapshot* snapshot = new (mem) b2QuerySnapshot(m_allocator);
+
+	// The first snapshot turns on change tracking.
+	if (m_snapshotList == NULL)
+	{
+		m_contactManager.m_broadPhase.SetTreeChangeTracking(true);
+	}
+
+	// Add to the world's snapshot list.
+	snapshot->m_prev = NULL;
+	snapshot->m_next = m_snapshotList;
+	if (m_snapshotList)
+	{
+		m_snapshotList->m_prev = snapshot;
+	}
+	m_snapshotList = snapshot;
+
+	UpdateQuerySnapshot(snapshot);
+	return snapshot;
+}
+
+void b2World::DestroyQuerySnapshot(b2QuerySnapshot* snapshot)
+{
+	b2Assert(IsLocked() == false);
+	if (IsLocked())
+	{
+		return;
+	}
+
+	// Remove from the world's snapshot list.
+	if (snapshot->m_prev)
+	{
+		snapshot->m_prev->m_next = snapshot->m_next;
+	}
+
+	if (snapshot->m_next)
+	{
+		snapshot->m_next->m_prev = snapshot->m_prev;
+	}
+
+	if (snapshot == m_snapshotList)
+	{
+		m_snapshotList = snapshot->m_next;
+	}
+
+	snapshot->~b2QuerySnapshot();
+	m_allocator.Free(snapshot, sizeof(b2QuerySnapshot), b2_snapshotMemory);
+
+	// Stop logging changes that nothing will read.
+	if (m_snapshotList == NULL)
+	{
+		m_contactManager.m_broadPhase.SetTreeChangeTracking(false);
+	}
+}
+
+void b2World::UpdateQuerySnapshot(b2QuerySnapshot* snapshot)
+{
+	b2ProfileScope("b2World::UpdateQuerySnapshot");
+
+	b2Assert(IsLocked() == false);
+	if (IsLocked())
+	{
+		return;
+	}
+
+	b2BroadPhase* broadPhase = &m_contactManager.m_broadPhase;
+	snapshot->Update(broadPhase);
+
+	// Changes that every snapshot has seen can be dropped from the logs.
+	uint32 oldest[2] = { snapshot->m_generation[0], snapshot->m_generation[1] };
+	for (b2QuerySnapshot* s = m_snapshotList; s; s = s->m_next)
+	{
+		oldest[0] = b2Min(oldest[0], s->m_generation[0]);
+		oldest[1] = b2Min(oldest[1], s->m_generation[1]);
+	}
+
+	broadPhase->AdvanceTreeGenerations(oldest);
+}
+
+struct b2WorldRayCastAllWrapper
+{
+	float32 RayCastCallback(const b2RayCastInput& input, int32 proxyId)
+	{
+		void* userData = broadPhase->GetUserData(proxyId);
+		b2FixtureProxy* proxy = (b2FixtureProxy*)userData;
+		b2Fixture* fixture = proxy->fixture;
+		if (fixture->IsSensor())
+		{
+			return -1.0f;
+		}
+
+		b2RayCastOutput output;
+		if (fixture->RayCast(&output, input, proxy->childIndex) == false)
+		{
+			return -1.0f;
+		}
+
+		// The ray has already been clipped to the farthest hit when the buffer is full,
+		// so this hit is always kept. Insertion sort it into place.
+		int32 i = b2Min(count, capacity - 1);
+		while (i > 0 && hits[i - 1].fraction > output.fraction)
+		{
+			hits[i] = hits[i - 1];
+			--i;
+		}
+
+		float32 fraction = output.fraction;
+		hits[i].fixture = fixture;
+		hits[i].point = (1.0f - fraction) * input.p1 + fraction * input.p2;
+		hits[i].normal = output.normal;
+		hits[i].fraction = fraction;
+		count = b2Min(count + 1, capacity);
+
+		// Once the buffer is full nothing beyond the farthest kept hit can get in.
+		if (count == capacity)
+		{
+			return hits[count - 1].fraction;
+		}
+
+		return input.maxFraction;
+	}
+
+	const b2BroadPhase* broadPhase;
+	b2RayCastHit* hits;
+	int32 capacity;
+	int32 count;
+};
+
+int32 b2World::RayCastAll(const b2Vec2& point1, const b2Vec2& point2, b2RayCastHit* hits, int32 capacity,
+						  uint16 maskBits) const
+{
+	if (capacity <= 0)
+	{
+		return 0;
+	}
+
+	b2WorldRayCastAllWrapper wrapper;
+	wrapper.broadPhase = &m_contactManager.m_broadPhase;
+	wrapper.hits = hits;
+	wrapper.capacity = capacity;
+	wrapper.count = 0;
+	b2RayCastInput input;
+	input.maxFraction = 1.0f;
+	input.p1 = point1;
+	input.p2 = point2;
+	m_contactManager.m_broadPhase.RayCast(&wrapper, input, maskBits);
+	return wrapper.count;
+}
+
+struct b2WorldOcclusionWrapper
+{
+	float32 RayCastCallback(const b2RayCastInput& input, int32 proxyId)
+	{
+		void* userData = broadPhase->GetUserData(proxyId);
+		b2FixtureProxy* proxy = (b2FixtureProxy*)userData;
+		b2Fixture* fixture = proxy->fixture;
+
+		if (fixture->IsSensor() == false && fixture->TestSegment(input, proxy->childIndex))
+		{
+			// Any hit will do, so terminate the ray-cast.
+			occluded = true;
+			return 0.0f;
+		}
+
+		return input.maxFraction;
+	}
+
+	const b2BroadPhase* broadPhase;
+	bool occluded;
+};
+
+bool b2World::TestSegmentOccluded(const b2Vec2& point1, const b2Vec2& point2, uint16 maskBits) const
+{
+	if (point1 == point2)
+	{
+		return false;
+	}
+
+	b2WorldOcclusionWrapper wrapper;
+	wrapper.broadPhase = &m_contactManager.m_broadPhase;
+	wrapper.occluded = false;
+	b2RayCastInput input;
+	input.maxFraction = 1.0f;
+	input.p1 = point1;
+	input.p2 = point2;
+	m_contactManager.m_broadPhase.RayCast(&wrapper, input, maskBits);
+	return wrapper.occluded;
+}
+
+struct b2OcclusionBatch
+{
+	const b2World* world;
+	const b2Vec2* points1;
+	const b2Vec2* points2;
+	bool* occluded;
+	uint16 maskBits;
+};
+
+static void b2TestOcclusionRange(void* context, int32 begin, int32 end)
+{
+	b2ProfileScope("TestSegmentsOccluded range");
+	b2OcclusionBatch* batch = (b2OcclusionBatch*)context;
+	for (int32 i = begin; i < end; ++i)
+	{
+		batch->occluded[i] = batch->world->TestSegmentOccluded(batch->points1[i], batch->points2[i], batch->maskBits);
+	}
+}
+
+void b2World::TestSegmentsOccluded(const b2Vec2* points1, const b2Vec2* points2, int32 count,
+								   bool* occluded, uint16 maskBits) const
+{
+	b2ProfileScope("b2World::TestSegmentsOccluded");
+
+	b2OcclusionBatch batch;
+	batch.world = this;
+	batch.points1 = points1;
+	batch.points2 = points2;
+	batch.occluded = occluded;
+	batch.maskBits = maskBits;
+
+	// Queries only read the world, so the batch can be split into independent ranges.
+	int32 rangeCount = count / b2_occlusionBatchSize;
+	if (rangeCount <= 1)
+	{
+		b2TestOcclusionRange(&batch, 0, count);
+		return;
+	}
+
+	m_queryThreads.ParallelFor(b2TestOcclusionRange, &batch, count, rangeCount);
 }
 
 void b2World::DrawShape(b2Fixture* fixture, const b2Transform& xf, const b2Color& color)
@@ -1091,6 +1526,31 @@ void b2World::DrawShape(b2Fixture* fixture, const b2Transform& xf, const b2Color
 	}
 }
 
+void b2World::DrawTree(const b2DynamicTree* tree, const b2Color& color)
+{
+	// Internal nodes are drawn fainter so that the leaves stand out.
+	b2Color internalColor(color.r, color.g, color.b, 0.5f * color.a);
+
+	for (int32 i = 0; i < tree->m_nodeCapacity; ++i)
+	{
+		const b2TreeNode* node = tree->m_nodes + i;
+		if (node->height < 0)
+		{
+			// Free node in pool
+			continue;
+		}
+
+		const b2AABB& aabb = node->aabb;
+		b2Vec2 vs[4];
+		vs[0].Set(aabb.lowerBound.x, aabb.lowerBound.y);
+		vs[1].Set(aabb.upperBound.x, aabb.lowerBound.y);
+		vs[2].Set(aabb.upperBound.x, aabb.upperBound.y);
+		vs[3].Set(aabb.lowerBound.x, aabb.upperBound.y);
+
+		g_debugDraw->DrawPolygon(vs, 4, node->IsLeaf() ? color : internalColor);
+	}
+}
+
 void b2World::DrawJoint(b2Joint* joint)
 {
 	b2Body* bodyA = joint->GetBodyA();
@@ -1225,6 +1685,13 @@ void b2World::DrawDebugData()
 		}
 	}
 
+	if (flags & b2Draw::e_treeBit)
+	{
+		const b2BroadPhase* bp = &m_contactManager.m_broadPhase;
+		DrawTree(&bp->m_staticTree, b2Color(0.5f, 0.5f, 0.9f));
+		DrawTree(&bp->m_tree, b2Color(0.9f, 0.9f, 0.3f));
+	}
+
 	if (flags & b2Draw::e_centerOfMassBit)
 	{
 		for (b2Body* b = m_bodyList; b; b = b->GetNext())
@@ -1236,6 +1703,158 @@ void b2World::DrawDebugData()
 	}
 }
 
+void b2World::SetTreeRefitting(bool flag)
+{
+	m_contactManager.m_broadPhase.SetTreeRefitEnabled(flag);
+}
+
+bool b2World::GetTreeRefitting() const
+{
+	return m_contactManager.m_broadPhase.IsTreeRefitEnabled();
+}
+
+void b2World::SetAdaptiveMargins(bool flag)
+{
+	m_contactManager.m_broadPhase.SetAdaptiveMargins(flag);
+}
+
+bool b2World::GetAdaptiveMargins() const
+{
+	return m_contactManager.m_broadPhase.GetAdaptiveMargins();
+}
+
+const b2ProxyMoveStats& b2World::GetProxyMoveStats() const
+{
+	return m_contactManager.m_broadPhase.GetMoveStats();
+}
+
+void b2World::ResetProxyMoveStats()
+{
+	m_contactManager.m_broadPhase.ResetMoveStats();
+}
+
+const b2StackAllocatorStats& b2World::GetStackAllocatorStats() const
+{
+	return m_stackAllocator.GetStats();
+}
+
+void b2World::ResetStackAllocatorStats()
+{
+	m_stackAllocator.ResetStats();
+}
+
+void b2World::RebuildStaticTree()
+{
+	b2Assert(IsLocked() == false);
+	if (IsLocked())
+	{
+		return;
+	}
+
+	m_contactManager.m_broadPhase.RebuildStaticTree();
+}
+
+void b2World::SetStaticTreeCompression(bool flag)
+{
+	m_contactManager.m_broadPhase.SetStaticTreeCompression(flag);
+}
+
+bool b2World::GetStaticTreeCompression() const
+{
+	return m_contactManager.m_broadPhase.GetStaticTreeCompression();
+}
+
+void b2World::SetArenaMode(bool flag)
+{
+	b2Assert(m_bodyCount == 0);
+	if (flag == m_blockAllocator.GetArenaMode())
+	{
+		return;
+	}
+
+	// Drop the chunks left behind by destroyed objects.
+	m_blockAllocator.Clear();
+	m_blockAllocator.SetArenaMode(flag);
+}
+
+bool b2World::GetArenaMode() const
+{
+	return m_blockAllocator.GetArenaMode();
+}
+
+void b2World::SetThreadCaching(bool flag)
+{
+	b2Assert(IsLocked() == false);
+	if (IsLocked())
+	{
+		return;
+	}
+
+	m_blockAllocator.SetThreadCaching(flag);
+}
+
+bool b2World::GetThreadCaching() const
+{
+	return m_blockAllocator.GetThreadCaching();
+}
+
+b2MemoryStats b2World::GetMemoryStats() const
+{
+	ComputeMemoryStats(&m_memoryStats);
+	return m_memoryStats;
+}
+
+void b2World::ResetMemoryPeaks()
+{
+	memset(&m_memoryStats, 0, sizeof(b2MemoryStats));
+	ComputeMemoryStats(&m_memoryStats);
+}
+
+// Fill in the current values and raise the peaks already in the stats.
+void b2World::ComputeMemoryStats(b2MemoryStats* stats) const
+{
+	const b2BroadPhase& broadPhase = m_contactManager.m_broadPhase;
+
+	m_blockAllocator.GetStats(&stats->blockAllocator);
+	stats->stackAllocator = m_stackAllocator.GetStats();
+
+	const b2DynamicTree* trees[2] = { &broadPhase.m_tree, &broadPhase.m_staticTree };
+	for (int32 i = 0; i < 2; ++i)
+	{
+		stats->treeNodeCapacity[i] = trees[i]->GetNodeCapacity();
+		stats->treeBytes[i] = trees[i]->GetByteCount();
+	}
+
+	stats->compressedTreeBytes = broadPhase.GetCompressedTreeByteCount();
+	stats->moveCapacity = broadPhase.m_moveCapacity;
+	stats->pairCapacity = broadPhase.m_pairCapacity;
+	stats->broadPhaseBytes = broadPhase.m_moveCapacity * sizeof(int32) + broadPhase.m_pairCapacity * sizeof(b2Pair) +
+		broadPhase.m_proxySpeedCapacity * sizeof(float32);
+
+	stats->snapshotBytes = 0;
+	for (const b2QuerySnapshot* snapshot = m_snapshotList; snapshot; snapshot = snapshot->m_next)
+	{
+		stats->snapshotBytes += snapshot->GetByteCount();
+	}
+
+	stats->totalBytes = sizeof(b2World) + stats->blockAllocator.capacity + stats->stackAllocator.capacity +
+		stats->treeBytes[0] + stats->treeBytes[1] + stats->compressedTreeBytes + stats->broadPhaseBytes +
+		stats->snapshotBytes;
+
+	stats->bodyCount = m_bodyCount;
+	stats->fixtureCount = m_fixtureCount;
+	stats->proxyCount = broadPhase.GetProxyCount();
+	stats->contactCount = m_contactManager.m_contactCount;
+	stats->jointCount = m_jointCount;
+
+	stats->peakTotalBytes = b2Max(stats->peakTotalBytes, stats->totalBytes);
+	stats->peakBodyCount = b2Max(stats->peakBodyCount, stats->bodyCount);
+	stats->peakFixtureCount = b2Max(stats->peakFixtureCount, stats->fixtureCount);
+	stats->peakProxyCount = b2Max(stats->peakProxyCount, stats->proxyCount);
+	stats->peakContactCount = b2Max(stats->peakContactCount, stats->contactCount);
+	stats->peakJointCount = b2Max(stats->peakJointCount, stats->jointCount);
+}
+
 int32 b2World::GetProxyCount() const
 {
 	return m_contactManager.m_broadPhase.GetProxyCount();
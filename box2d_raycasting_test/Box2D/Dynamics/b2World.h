@@ -22,6 +22,7 @@
 #include <Box2D/Common/b2Math.h>
 #include <Box2D/Common/b2BlockAllocator.h>
 #include <Box2D/Common/b2StackAllocator.h>
+#include <Box2D/Common/b2ThreadPool.h>
 #include <Box2D/Dynamics/b2ContactManager.h>
 #include <Box2D/Dynamics/b2WorldCallbacks.h>
 #include <Box2D/Dynamics/b2TimeStep.h>
@@ -29,11 +30,56 @@
 struct b2AABB;
 struct b2BodyDef;
 struct b2Color;
+struct b2FixtureDef;
 struct b2JointDef;
+struct b2WorldFileNode;
 class b2Body;
 class b2Draw;
 class b2Fixture;
 class b2Joint;
+class b2QuerySnapshot;
+
+/// A fixture hit by b2World::RayCastAll.
+struct b2RayCastHit
+{
+	b2Fixture* fixture;	///< the fixture hit by the ray
+	b2Vec2 point;		///< the point of initial intersection
+	b2Vec2 normal;		///< the normal vector at the point of intersection
+	float32 fraction;	///< the fraction along the ray of the intersection
+};
+
+/// The memory held by a world. Sizes are in bytes. Buffers only grow until the world
+/// is cleared, so most sizes are capacities rather than what is in use. Peaks are
+/// sampled whenever the stats are read, and after every step if
+/// b2World::SetStepMemorySampling is on. Memory that shapes allocate with b2Alloc is
+/// not included.
+struct b2MemoryStats
+{
+	b2BlockAllocatorStats blockAllocator;	///< bodies, fixtures, shapes, contacts and joints
+	b2StackAllocatorStats stackAllocator;	///< per step memory, with its high-water mark
+
+	int32 treeNodeCapacity[2];	///< indexed by broad-phase tree: dynamic, then static
+	int32 treeBytes[2];			///< node pools and tree buffers, indexed by tree
+	int32 compressedTreeBytes;
+	int32 moveCapacity;			///< broad-phase move buffer entries
+	int32 pairCapacity;			///< broad-phase pair buffer entries
+	int32 broadPhaseBytes;		///< move, pair and proxy speed buffers
+	int32 snapshotBytes;		///< query snapshots
+	int32 totalBytes;			///< all of the above plus the world itself
+
+	int32 bodyCount;
+	int32 fixtureCount;
+	int32 proxyCount;
+	int32 contactCount;
+	int32 jointCount;
+
+	int32 peakTotalBytes;
+	int32 peakBodyCount;
+	int32 peakFixtureCount;
+	int32 peakProxyCount;
+	int32 peakContactCount;
+	int32 peakJointCount;
+};
 
 /// The world class manages all physics entities, dynamic simulation,
 /// and asynchronous queries. The world also contains efficient memory
@@ -43,11 +89,20 @@ class b2World
 public:
 	/// Construct a world object.
 	/// @param gravity the world gravity vector.
-	b2World(const b2Vec2& gravity);
+	/// @param allocator the memory callbacks for the world's allocators, broad-phase
+	/// and query snapshots. The context must outlive the world.
+	b2World(const b2Vec2& gravity, const b2Allocator& allocator = b2Allocator());
 
 	/// Destruct the world. All physics entities are destroyed and all heap memory is released.
 	~b2World();
 
+	/// Destroy every body, fixture, joint and contact at once, without calling their
+	/// destructors or the destruction listener. The broad-phase and allocator memory is
+	/// kept for the next level. Query snapshots must be updated before they are queried
+	/// again.
+	/// @warning This function is locked during callbacks.
+	void Clear();
+
 	/// Register a destruction listener. The listener is owned by you and must
 	/// remain in scope.
 	void SetDestructionListener(b2DestructionListener* listener);
@@ -71,6 +126,18 @@ public:
 	/// @warning This function is locked during callbacks.
 	b2Body* CreateBody(const b2BodyDef* def);
 
+	/// Create many static bodies with one fixture each. This is much faster than
+	/// calling CreateBody and CreateFixture in a loop for large amounts of level
+	/// geometry: the bodies are allocated in a row, their proxies are built into a
+	/// sub-tree of the static tree in one top-down pass, and no pairs are searched
+	/// for between them. The bodies can be destroyed one by one as usual.
+	/// @param bodyDefs count body definitions, which must all be static.
+	/// @param fixtureDefs count fixture definitions, one per body.
+	/// @param bodies optionally receives the new bodies, in the order of the definitions.
+	/// @warning This function is locked during callbacks.
+	void CreateStaticBodies(const b2BodyDef* bodyDefs, const b2FixtureDef* fixtureDefs, int32 count,
+							b2Body** bodies = NULL);
+
 	/// Destroy a rigid body given a definition. No reference to the definition
 	/// is retained. This function is locked during callbacks.
 	/// @warning This automatically deletes all associated shapes and joints.
@@ -113,13 +180,83 @@ public:
 	/// @param aabb the query box.
 	void QueryAABB(b2QueryCallback* callback, const b2AABB& aabb) const;
 
+	/// Query the world for all fixtures that potentially overlap the provided AABB
+	/// and have a category bit in the mask. Sub-trees of the broad-phase without
+	/// such fixtures are skipped entirely.
+	/// @param callback a user implemented callback class.
+	/// @param aabb the query box.
+	/// @param maskBits the categories to report. b2_allCategories reports every fixture,
+	/// including fixtures whose category bits are zero.
+	void QueryAABB(b2QueryCallback* callback, const b2AABB& aabb, uint16 maskBits) const;
+
 	/// Ray-cast the world for all fixtures in the path of the ray. Your callback
 	/// controls whether you get the closest point, any point, or n-points.
 	/// The ray-cast ignores shapes that contain the starting point.
 	/// @param callback a user implemented callback class.
 	/// @param point1 the ray starting point
 	/// @param point2 the ray ending point
-	void RayCast(b2RayCastCallback* callback, const b2Vec2& point1, const b2Vec2& point2) const;
+	/// @return how many broad-phase nodes and fixtures the ray visited.
+	b2TreeStats RayCast(b2RayCastCallback* callback, const b2Vec2& point1, const b2Vec2& point2) const;
+
+	/// Ray-cast the world for fixtures in the path of the ray that have a category bit
+	/// in the mask. Other fixtures are never tested, and sub-trees of the broad-phase
+	/// without matching fixtures are skipped entirely.
+	/// @param callback a user implemented callback class.
+	/// @param point1 the ray starting point
+	/// @param point2 the ray ending point
+	/// @param maskBits the categories the ray can hit.
+	/// @param nodeCallback optionally told about every broad-phase node the ray visits.
+	/// @return how many broad-phase nodes and fixtures the ray visited.
+	b2TreeStats RayCast(b2RayCastCallback* callback, const b2Vec2& point1, const b2Vec2& point2, uint16 maskBits,
+						b2TreeNodeCallback* nodeCallback = NULL) const;
+
+	/// Ray-cast the world for every fixture in the path of the ray. Hits are written to
+	/// the caller's buffer sorted front-to-back. If there are more hits than fit, only
+	/// the nearest are kept, and the ray is clipped to the farthest kept hit once the
+	/// buffer is full. Pass a small capacity to cut the query off after the first few hits.
+	/// Sensors are not reported. Shapes containing point1 are ignored, as with RayCast.
+	/// @param point1 the ray starting point
+	/// @param point2 the ray ending point
+	/// @param hits receives up to capacity hits.
+	/// @param capacity the size of the hits array.
+	/// @param maskBits the categories the ray can hit.
+	/// @return the number of hits written.
+	int32 RayCastAll(const b2Vec2& point1, const b2Vec2& point2, b2RayCastHit* hits, int32 capacity,
+					 uint16 maskBits = b2_allCategories) const;
+
+	/// Create a query snapshot of the broad-phase and fixture transforms. The snapshot
+	/// can be queried from other threads while the world steps. While any snapshot
+	/// exists the broad-phase logs its changes, so keep snapshots up to date or destroy
+	/// them. This must not be called while the world is stepping.
+	/// @warning snapshots are destroyed with the world.
+	b2QuerySnapshot* CreateQuerySnapshot();
+
+	/// Destroy a query snapshot. This must not be called while the world is stepping
+	/// or the snapshot is being queried.
+	void DestroyQuerySnapshot(b2QuerySnapshot* snapshot);
+
+	/// Bring a snapshot up to date with the world. Only what changed since the snapshot
+	/// was last updated is copied. This must not be called while the world is stepping
+	/// or the snapshot is being queried.
+	void UpdateQuerySnapshot(b2QuerySnapshot* snapshot);
+
+	/// Test if anything blocks the segment from point1 to point2. This stops at the
+	/// first fixture hit and never computes hit points or normals, so it is much cheaper
+	/// than a closest-hit ray-cast. Sensors never block. Shapes containing point1 are
+	/// ignored, as with RayCast.
+	/// @param maskBits the categories that can block the segment.
+	/// @return true if the segment is blocked.
+	bool TestSegmentOccluded(const b2Vec2& point1, const b2Vec2& point2, uint16 maskBits = b2_allCategories) const;
+
+	/// Test a batch of segments for occlusion. Segment i runs from points1[i] to points2[i]
+	/// and its result is written to occluded[i]. Large batches are split across worker
+	/// threads that the world starts on first use and keeps for later batches.
+	/// The world must not be modified until this returns.
+	/// @param count the number of segments.
+	/// @param occluded receives one result per segment.
+	/// @param maskBits the categories that can block the segments.
+	void TestSegmentsOccluded(const b2Vec2* points1, const b2Vec2* points2, int32 count,
+							  bool* occluded, uint16 maskBits = b2_allCategories) const;
 
 	/// Get the world body list. With the returned body, use b2Body::GetNext to get
 	/// the next body in the world list. A NULL body indicates the end of the list.
@@ -157,6 +294,73 @@ public:
 	void SetSubStepping(bool flag) { m_subStepping = flag; }
 	bool GetSubStepping() const { return m_subStepping; }
 
+	/// Enable/disable refitting of the broad-phase tree. This is faster than
+	/// re-inserting proxies when many bodies move by small amounts.
+	void SetTreeRefitting(bool flag);
+	bool GetTreeRefitting() const;
+
+	/// Enable/disable adaptive broad-phase margins. Fast bodies get fat AABBs sized from
+	/// their recent motion so they escape them less often, slow bodies get tight ones.
+	void SetAdaptiveMargins(bool flag);
+	bool GetAdaptiveMargins() const;
+
+	/// Get the broad-phase proxy movement counters. These accumulate until reset.
+	const b2ProxyMoveStats& GetProxyMoveStats() const;
+
+	/// Reset the broad-phase proxy movement counters.
+	void ResetProxyMoveStats();
+
+	/// Get the stack allocator counters. Spills are per step allocations that didn't
+	/// fit in b2_stackSize; they go to extra segments that are kept for later steps.
+	const b2StackAllocatorStats& GetStackAllocatorStats() const;
+
+	/// Reset the stack allocator spill counts and high-water mark.
+	void ResetStackAllocatorStats();
+
+	/// Get the memory callbacks the world was created with.
+	const b2Allocator& GetAllocator() const;
+
+	/// Get the memory held by the world and its object counts, with their peaks. This
+	/// samples the world, raising the stored peaks.
+	b2MemoryStats GetMemoryStats() const;
+
+	/// Enable/disable sampling the memory stats at the end of every step. Without it
+	/// the peaks only see what the world holds when the stats are read, which misses
+	/// contacts that come and go between reads. Off by default.
+	void SetStepMemorySampling(bool flag);
+	bool GetStepMemorySampling() const;
+
+	/// Reset the peaks of the memory stats to the current values. The stack allocator
+	/// high-water mark is reset with ResetStackAllocatorStats.
+	void ResetMemoryPeaks();
+
+	/// Rebuild the broad-phase tree that holds static bodies. Call this after
+	/// building static level geometry to get an optimal static tree.
+	/// @warning This function is locked during callbacks.
+	void RebuildStaticTree();
+
+	/// Enable/disable a compressed copy of the static broad-phase tree for queries and
+	/// ray casts. It uses a fraction of the memory, which helps large static levels fit
+	/// in cache. The copy is rebuilt on the next step whenever static bodies are
+	/// created, moved or destroyed, so keep static geometry static.
+	void SetStaticTreeCompression(bool flag);
+	bool GetStaticTreeCompression() const;
+
+	/// Enable/disable arena mode. Bodies, fixtures, shapes, contacts and joints then
+	/// come from large contiguous regions that Clear rewinds instead of releasing, so
+	/// reloading a level doesn't go back to the b2Allocator. The world must have no
+	/// bodies.
+	void SetArenaMode(bool flag);
+	bool GetArenaMode() const;
+
+	/// Enable/disable per-thread caches in the block allocator that holds bodies,
+	/// fixtures, shapes, contacts and joints, so that several threads can allocate
+	/// and free from it at once, e.g. a parallel narrow-phase creating contacts. See
+	/// b2BlockAllocator::SetThreadCaching. The world itself is still not thread-safe.
+	/// @warning This function is locked during callbacks.
+	void SetThreadCaching(bool flag);
+	bool GetThreadCaching() const;
+
 	/// Get the number of broad-phase proxies.
 	int32 GetProxyCount() const;
 
@@ -209,6 +413,34 @@ public:
 	/// @warning this should be called outside of a time step.
 	void Dump();
 
+	/// Write the bodies, fixtures, joints and broad-phase trees of the world in the
+	/// binary world file format (see b2WorldFile.h). User data, contacts and mouse
+	/// joints are not saved.
+	/// @param buffer receives the file, or NULL to only compute its size.
+	/// @param capacity the size of the buffer.
+	/// @return the size of the file, which may be larger than capacity. Nothing is
+	/// written if it doesn't fit.
+	/// @warning this should be called outside of a time step.
+	int32 SaveToMemory(void* buffer, int32 capacity);
+
+	/// Write the world to a binary world file.
+	/// @return false if the file could not be written.
+	bool SaveToFile(const char* path);
+
+	/// Load a binary world file into this world, which must be empty. The saved
+	/// broad-phase trees are used as they are, so no proxies are inserted and no
+	/// tree is rebuilt. Contacts are created on the next time step.
+	/// The structure of the file is checked, and every loaded value must be finite.
+	/// Positions, sizes and material values must also be within 1e6, shape radii must
+	/// be zero or at least b2_linearSlop, and polygons must be convex with unit normals.
+	/// @return false if the data is not a valid world file of this version.
+	/// @warning this function is locked during callbacks.
+	bool LoadFromMemory(const void* data, int32 size);
+
+	/// Map a binary world file into memory and load it with LoadFromMemory.
+	/// @return false if the file could not be read or is not valid.
+	bool LoadFromFile(const char* path);
+
 private:
 
 	// m_flags
@@ -216,7 +448,8 @@ private:
 	{
 		e_newFixture	= 0x0001,
 		e_locked		= 0x0002,
-		e_clearForces	= 0x0004
+		e_clearForces	= 0x0004,
+		e_sampleMemory	= 0x0008
 	};
 
 	friend class b2Body;
@@ -227,9 +460,17 @@ private:
 	void Solve(const b2TimeStep& step);
 	void SolveTOI(const b2TimeStep& step);
 
+	int32 SaveTree(const b2DynamicTree* tree, b2WorldFileNode* nodes, int32* remap) const;
+	void LoadTree(b2DynamicTree* tree, const b2WorldFileNode* nodes, int32 count, int32 root);
+
+	void ReleaseChainShapes();
+	void ComputeMemoryStats(b2MemoryStats* stats) const;
+
 	void DrawJoint(b2Joint* joint);
 	void DrawShape(b2Fixture* shape, const b2Transform& xf, const b2Color& color);
+	void DrawTree(const b2DynamicTree* tree, const b2Color& color);
 
+	b2Allocator m_allocator;
 	b2BlockAllocator m_blockAllocator;
 	b2StackAllocator m_stackAllocator;
 
@@ -239,10 +480,22 @@ private:
 
 	b2Body* m_bodyList;
 	b2Joint* m_jointList;
+	b2QuerySnapshot* m_snapshotList;
 
 	int32 m_bodyCount;
 	int32 m_jointCount;
 
+	int32 m_fixtureCount;
+
+	// Chain shapes own b2Alloc memory, so they are the only shapes teardown must visit.
+	int32 m_chainShapeCount;
+
+	// The last sample, holding the peaks. Reading the stats samples them, so this is mutable.
+	mutable b2MemoryStats m_memoryStats;
+
+	// Runs batched queries. Queries don't modify the world, so this is mutable.
+	mutable b2ThreadPool m_queryThreads;
+
 	b2Vec2 m_gravity;
 	bool m_allowSleep;
 
@@ -341,6 +594,23 @@ inline bool b2World::GetAutoClearForces() const
 	return (m_flags & e_clearForces) == e_clearForces;
 }
 
+inline void b2World::SetStepMemorySampling(bool flag)
+{
+	if (flag)
+	{
+		m_flags |= e_sampleMemory;
+	}
+	else
+	{
+		m_flags &= ~e_sampleMemory;
+	}
+}
+
+inline bool b2World::GetStepMemorySampling() const
+{
+	return (m_flags & e_sampleMemory) == e_sampleMemory;
+}
+
 inline const b2ContactManager& b2World::GetContactManager() const
 {
 	return m_contactManager;
@@ -351,4 +621,9 @@ inline const b2Profile& b2World::GetProfile() const
 	return m_profile;
 }
 
+inline const b2Allocator& b2World::GetAllocator() const
+{
+	return m_allocator;
+}
+
 #endif
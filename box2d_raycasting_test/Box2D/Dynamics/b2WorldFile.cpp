@@ -0,0 +1,1323 @@
+/*
+* Copyright (c) 2006-2011 Erin Catto http://www.box2d.org
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include <Box2D/Dynamics/b2WorldFile.h>
+#include <Box2D/Dynamics/b2World.h>
+#include <Box2D/Dynamics/b2Body.h>
+#include <Box2D/Dynamics/b2Fixture.h>
+#include <Box2D/Dynamics/Joints/b2DistanceJoint.h>
+#include <Box2D/Dynamics/Joints/b2FrictionJoint.h>
+#include <Box2D/Dynamics/Joints/b2GearJoint.h>
+#include <Box2D/Dynamics/Joints/b2MotorJoint.h>
+#include <Box2D/Dynamics/Joints/b2PrismaticJoint.h>
+#include <Box2D/Dynamics/Joints/b2PulleyJoint.h>
+#include <Box2D/Dynamics/Joints/b2RevoluteJoint.h>
+#include <Box2D/Dynamics/Joints/b2RopeJoint.h>
+#include <Box2D/Dynamics/Joints/b2WeldJoint.h>
+#include <Box2D/Dynamics/Joints/b2WheelJoint.h>
+#include <Box2D/Collision/Shapes/b2CircleShape.h>
+#include <Box2D/Collision/Shapes/b2EdgeShape.h>
+#include <Box2D/Collision/Shapes/b2ChainShape.h>
+#include <Box2D/Collision/Shapes/b2PolygonShape.h>
+#include <Box2D/Common/b2GrowableStack.h>
+#include <new>
+#include <stdio.h>
+#include <string.h>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// The number of shape points a shape is saved with.
+static int32 b2GetSavedVertexCount(const b2Shape* shape)
+{
+	switch (shape->m_type)
+	{
+	case b2Shape::e_circle:
+		return 1;
+
+	case b2Shape::e_edge:
+		return 4;
+
+	case b2Shape::e_polygon:
+		return 1 + 2 * ((b2PolygonShape*)shape)->m_count;
+
+	case b2Shape::e_chain:
+		return 2 + ((b2ChainShape*)shape)->m_count;
+
+	default:
+		b2Assert(false);
+		return 0;
+	}
+}
+
+// Check that an array of records lies inside the file.
+static bool b2IsValidSection(const b2WorldFileHeader* header, uint32 offset, int32 count, uint32 recordSize)
+{
+	if (count < 0 || (offset & 3) != 0 || offset < sizeof(b2WorldFileHeader) || offset > header->size)
+	{
+		return false;
+	}
+
+	return uint32(count) <= (header->size - offset) / recordSize;
+}
+
+// Loaded positions, sizes and material values must be finite and no larger than this.
+// float32 only has centimetre precision out to about 1e5, so no sensible world comes
+// near it, and products of two such values stay far from overflowing.
+static const float32 b2_worldFileMaxValue = 1.0e6f;
+
+static bool b2IsValidValue(float32 x)
+{
+	return b2IsValid(x) && b2Abs(x) <= b2_worldFileMaxValue;
+}
+
+// Sizes must also be zero or at least the given minimum. Densities must not be
+// vanishingly small, as the masses computed from them are inverted, and shapes much
+// smaller than the collision slop stall time of impact.
+static bool b2IsValidSize(float32 x, float32 minimum)
+{
+	return x == 0.0f || (minimum <= x && x <= b2_worldFileMaxValue);
+}
+
+static bool b2IsValidPoint(const b2Vec2& v)
+{
+	return b2IsValidValue(v.x) && b2IsValidValue(v.y);
+}
+
+static bool b2IsValidBounds(const b2AABB& aabb)
+{
+	return b2IsValidPoint(aabb.lowerBound) && b2IsValidPoint(aabb.upperBound) &&
+		aabb.lowerBound.x <= aabb.upperBound.x && aabb.lowerBound.y <= aabb.upperBound.y;
+}
+
+// Check the shape points of a fixture. Polygons must be convex with a positive area,
+// as b2PolygonShape::Set makes them, and their normals must have unit length.
+static bool b2IsValidShapePoints(const b2WorldFileFixture* fixture, const b2Vec2* points)
+{
+	for (int32 i = 0; i < fixture->vertexCount; ++i)
+	{
+		if (b2IsValidPoint(points[i]) == false)
+		{
+			return false;
+		}
+	}
+
+	if (fixture->shapeType == b2Shape::e_polygon)
+	{
+		b2PolygonShape polygon;
+		polygon.m_count = fixture->vertexCount / 2;
+		memcpy(polygon.m_vertices, points + 1, polygon.m_count * sizeof(b2Vec2));
+		if (polygon.Validate() == false)
+		{
+			return false;
+		}
+
+		const b2Vec2* vertices = polygon.m_vertices;
+		const b2Vec2* normals = points + 1 + polygon.m_count;
+		float32 area = 0.0f;
+		for (int32 i = 0; i < polygon.m_count; ++i)
+		{
+			b2Vec2 edge = vertices[i + 1 < polygon.m_count ? i + 1 : 0] - vertices[i];
+			if (edge.LengthSquared() <= b2_epsilon * b2_epsilon || b2Abs(normals[i].Length() - 1.0f) > 1.0e-3f)
+			{
+				return false;
+			}
+			area += 0.5f * b2Cross(vertices[i] - vertices[0], edge);
+		}
+
+		if (area <= b2_epsilon)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+int32 b2World::SaveTree(const b2DynamicTree* tree, b2WorldFileNode* nodes, int32* remap) const
+{
+	for (int32 i = 0; i < tree->m_nodeCapacity; ++i)
+	{
+		remap[i] = b2_nullNode;
+	}
+
+	if (tree->m_root == b2_nullNode)
+	{
+		return 0;
+	}
+
+	// Number the nodes depth first so each sub-tree is stored contiguously.
+	int32 count = 0;
+	b2GrowableStack<int32, 256> stack;
+	stack.Push(tree->m_root);
+	while (stack.GetCount() > 0)
+	{
+		int32 nodeId = stack.Pop();
+		const b2TreeNode* node = tree->m_nodes + nodeId;
+		remap[nodeId] = count;
+		++count;
+
+		if (node->IsLeaf() == false)
+		{
+			stack.Push(node->child2);
+			stack.Push(node->child1);
+		}
+	}
+
+	b2Assert(count == tree->m_nodeCount);
+
+	for (int32 i = 0; i < tree->m_nodeCapacity; ++i)
+	{
+		if (remap[i] == b2_nullNode)
+		{
+			continue;
+		}
+
+		const b2TreeNode* node = tree->m_nodes + i;
+		b2WorldFileNode* record = nodes + remap[i];
+		record->aabb = node->aabb;
+		record->parent = node->parent != b2_nullNode ? remap[node->parent] : b2_nullNode;
+		record->child1 = node->child1 != b2_nullNode ? remap[node->child1] : b2_nullNode;
+		record->child2 = node->child2 != b2_nullNode ? remap[node->child2] : b2_nullNode;
+		record->height = node->height;
+		record->categoryBits = node->categoryBits;
+	}
+
+	return count;
+}
+
+int32 b2World::SaveToMemory(void* buffer, int32 capacity)
+{
+	b2Assert(IsLocked() == false);
+
+	b2BroadPhase* broadPhase = &m_contactManager.m_broadPhase;
+	b2DynamicTree* trees[2];
+	trees[b2BroadPhase::e_dynamicTree] = &broadPhase->m_tree;
+	trees[b2BroadPhase::e_staticTree] = &broadPhase->m_staticTree;
+
+	// Pending refits would leave stale bounds in the saved tree.
+	if (trees[b2BroadPhase::e_dynamicTree]->m_refitCount > 0)
+	{
+		trees[b2BroadPhase::e_dynamicTree]->Refit();
+	}
+
+	// Count the records.
+	int32 fixtureCount = 0;
+	int32 proxyCount = 0;
+	int32 vertexCount = 0;
+	for (b2Body* b = m_bodyList; b; b = b->m_next)
+	{
+		for (b2Fixture* f = b->m_fixtureList; f; f = f->m_next)
+		{
+			++fixtureCount;
+			proxyCount += f->m_proxyCount;
+			vertexCount += b2GetSavedVertexCount(f->m_shape);
+		}
+	}
+
+	// Joints are saved in creation order, which is the reverse of the list order.
+	b2Joint* lastJoint = NULL;
+	int32 jointCount = 0;
+	for (b2Joint* j = m_jointList; j; j = j->m_next)
+	{
+		lastJoint = j;
+		if (j->m_type != e_mouseJoint)
+		{
+			++jointCount;
+		}
+	}
+
+	b2WorldFileHeader header;
+	header.magic = b2_worldFileMagic;
+	header.version = b2_worldFileVersion;
+	header.gravity = m_gravity;
+	header.bodyCount = m_bodyCount;
+	header.fixtureCount = fixtureCount;
+	header.proxyCount = proxyCount;
+	header.vertexCount = vertexCount;
+	header.jointCount = jointCount;
+
+	uint32 offset = sizeof(b2WorldFileHeader);
+	header.bodyOffset = offset;
+	offset += m_bodyCount * sizeof(b2WorldFileBody);
+	header.fixtureOffset = offset;
+	offset += fixtureCount * sizeof(b2WorldFileFixture);
+	header.proxyOffset = offset;
+	offset += proxyCount * sizeof(b2WorldFileProxy);
+	header.vertexOffset = offset;
+	offset += vertexCount * sizeof(b2Vec2);
+	header.jointOffset = offset;
+	offset += jointCount * sizeof(b2WorldFileJoint);
+	for (int32 i = 0; i < 2; ++i)
+	{
+		header.nodeCount[i] = trees[i]->m_nodeCount;
+		header.root[i] = b2_nullNode;
+		header.nodeOffset[i] = offset;
+		offset += trees[i]->m_nodeCount * sizeof(b2WorldFileNode);
+	}
+	header.size = offset;
+
+	if (buffer == NULL || int32(header.size) > capacity)
+	{
+		return header.size;
+	}
+
+	char* data = (char*)buffer;
+
+	// Trees first, as the proxies refer to the renumbered nodes.
+	int32* remap[2];
+	for (int32 i = 0; i < 2; ++i)
+	{
+		remap[i] = (int32*)m_allocator.Allocate(trees[i]->m_nodeCapacity * sizeof(int32), b2_worldMemory);
+		b2WorldFileNode* nodes = (b2WorldFileNode*)(data + header.nodeOffset[i]);
+		SaveTree(trees[i], nodes, remap[i]);
+
+		if (trees[i]->m_root != b2_nullNode)
+		{
+			header.root[i] = remap[i][trees[i]->m_root];
+		}
+	}
+
+	memcpy(data, &header, sizeof(b2WorldFileHeader));
+
+	b2WorldFileBody* bodies = (b2WorldFileBody*)(data + header.bodyOffset);
+	b2WorldFileFixture* fixtures = (b2WorldFileFixture*)(data + header.fixtureOffset);
+	b2WorldFileProxy* proxies = (b2WorldFileProxy*)(data + header.proxyOffset);
+	b2Vec2* vertices = (b2Vec2*)(data + header.vertexOffset);
+
+	int32 bodyIndex = 0;
+	for (b2Body* b = m_bodyList; b; b = b->m_next)
+	{
+		// Joints refer to bodies by index.
+		b->m_islandIndex = bodyIndex;
+
+		b2WorldFileBody* body = bodies + bodyIndex;
+		body->position = b->GetPosition();
+		body->angle = b->GetAngle();
+		body->linearVelocity = b->m_linearVelocity;
+		body->angularVelocity = b->m_angularVelocity;
+		body->linearDamping = b->m_linearDamping;
+		body->angularDamping = b->m_angularDamping;
+		body->gravityScale = b->m_gravityScale;
+		body->type = b->m_type;
+		body->flags = 0;
+		body->flags |= b->IsAwake() ? b2WorldFileBody::e_awakeFlag : 0;
+		body->flags |= b->IsSleepingAllowed() ? b2WorldFileBody::e_autoSleepFlag : 0;
+		body->flags |= b->IsFixedRotation() ? b2WorldFileBody::e_fixedRotationFlag : 0;
+		body->flags |= b->IsBullet() ? b2WorldFileBody::e_bulletFlag : 0;
+		body->flags |= b->IsActive() ? b2WorldFileBody::e_activeFlag : 0;
+		body->fixtureCount = b->m_fixtureCount;
+		++bodyIndex;
+
+		for (b2Fixture* f = b->m_fixtureList; f; f = f->m_next)
+		{
+			b2WorldFileFixture* fixture = fixtures;
+			++fixtures;
+
+			memset(fixture, 0, sizeof(b2WorldFileFixture));
+			fixture->friction = f->m_friction;
+			fixture->restitution = f->m_restitution;
+			fixture->density = f->m_density;
+			fixture->categoryBits = f->m_filter.categoryBits;
+			fixture->maskBits = f->m_filter.maskBits;
+			fixture->groupIndex = f->m_filter.groupIndex;
+			fixture->isSensor = f->m_isSensor ? 1 : 0;
+
+			const b2Shape* shape = f->m_shape;
+			fixture->shapeType = shape->m_type;
+			fixture->radius = shape->m_radius;
+			fixture->vertexCount = b2GetSavedVertexCount(shape);
+
+			switch (shape->m_type)
+			{
+			case b2Shape::e_circle:
+				{
+					const b2CircleShape* circle = (const b2CircleShape*)shape;
+					vertices[0] = circle->m_p;
+				}
+				break;
+
+			case b2Shape::e_edge:
+				{
+					const b2EdgeShape* edge = (const b2EdgeShape*)shape;
+					vertices[0] = edge->m_vertex0;
+					vertices[1] = edge->m_vertex1;
+					vertices[2] = edge->m_vertex2;
+					vertices[3] = edge->m_vertex3;
+					fixture->shapeFlags |= edge->m_hasVertex0 ? b2WorldFileFixture::e_hasVertex0Flag : 0;
+					fixture->shapeFlags |= edge->m_hasVertex3 ? b2WorldFileFixture::e_hasVertex3Flag : 0;
+				}
+				break;
+
+			case b2Shape::e_polygon:
+				{
+					const b2PolygonShape* polygon = (const b2PolygonShape*)shape;
+					vertices[0] = polygon->m_centroid;
+					memcpy(vertices + 1, polygon->m_vertices, polygon->m_count * sizeof(b2Vec2));
+					memcpy(vertices + 1 + polygon->m_count, polygon->m_normals, polygon->m_count * sizeof(b2Vec2));
+				}
+				break;
+
+			case b2Shape::e_chain:
+				{
+					const b2ChainShape* chain = (const b2ChainShape*)shape;
+					vertices[0] = chain->m_prevVertex;
+					vertices[1] = chain->m_nextVertex;
+					memcpy(vertices + 2, chain->m_vertices, chain->m_count * sizeof(b2Vec2));
+					fixture->shapeFlags |= chain->m_hasPrevVertex ? b2WorldFileFixture::e_hasVertex0Flag : 0;
+					fixture->shapeFlags |= chain->m_hasNextVertex ? b2WorldFileFixture::e_hasVertex3Flag : 0;
+					fixture->shapeFlags |= chain->HasSegmentTree() ? b2WorldFileFixture::e_segmentTreeFlag : 0;
+				}
+				break;
+
+			default:
+				b2Assert(false);
+				break;
+			}
+			vertices += fixture->vertexCount;
+
+			fixture->proxyCount = f->m_proxyCount;
+			for (int32 i = 0; i < f->m_proxyCount; ++i)
+			{
+				const b2FixtureProxy* proxy = f->m_proxies + i;
+				int32 tree = broadPhase->IsStaticProxy(proxy->proxyId) ? b2BroadPhase::e_staticTree : b2BroadPhase::e_dynamicTree;
+				int32 nodeId = remap[tree][b2BroadPhase::GetNodeId(proxy->proxyId)];
+				proxies->aabb = proxy->aabb;
+				proxies->proxyId = b2BroadPhase::GetProxyId(nodeId, tree);
+				++proxies;
+			}
+		}
+	}
+
+	for (int32 i = 0; i < 2; ++i)
+	{
+		m_allocator.Free(remap[i], trees[i]->m_nodeCapacity * sizeof(int32), b2_worldMemory);
+	}
+
+	// Save gear joints last so the joints they connect come first.
+	b2WorldFileJoint* joints = (b2WorldFileJoint*)(data + header.jointOffset);
+	int32 jointIndex = 0;
+	for (int32 pass = 0; pass < 2; ++pass)
+	{
+		for (b2Joint* j = lastJoint; j; j = j->m_prev)
+		{
+			if (j->m_type == e_mouseJoint || (j->m_type == e_gearJoint) != (pass == 1))
+			{
+				continue;
+			}
+
+			j->m_index = jointIndex;
+
+			b2WorldFileJoint* joint = joints + jointIndex;
+			++jointIndex;
+
+			joint->type = j->m_type;
+			joint->bodyA = j->m_bodyA->m_islandIndex;
+			joint->bodyB = j->m_bodyB->m_islandIndex;
+			joint->joint1 = b2_nullNode;
+			joint->joint2 = b2_nullNode;
+			joint->flags = j->m_collideConnected ? b2WorldFileJoint::e_collideConnectedFlag : 0;
+
+			// Zero the unused fields so saving the same world gives the same file.
+			b2Vec2* v = joint->vectors;
+			float32* s = joint->scalars;
+			for (int32 i = 0; i < 4; ++i)
+			{
+				v[i].SetZero();
+			}
+			for (int32 i = 0; i < 6; ++i)
+			{
+				s[i] = 0.0f;
+			}
+
+			switch (j->m_type)
+			{
+			case e_distanceJoint:
+				{
+					const b2DistanceJoint* dj = (const b2DistanceJoint*)j;
+					v[0] = dj->GetLocalAnchorA();
+					v[1] = dj->GetLocalAnchorB();
+					s[0] = dj->GetLength();
+					s[1] = dj->GetFrequency();
+					s[2] = dj->GetDampingRatio();
+				}
+				break;
+
+			case e_frictionJoint:
+				{
+					const b2FrictionJoint* fj = (const b2FrictionJoint*)j;
+					v[0] = fj->GetLocalAnchorA();
+					v[1] = fj->GetLocalAnchorB();
+					s[0] = fj->GetMaxForce();
+					s[1] = fj->GetMaxTorque();
+				}
+				break;
+
+			case e_gearJoint:
+				{
+					b2GearJoint* gj = (b2GearJoint*)j;
+					joint->joint1 = gj->GetJoint1()->m_index;
+					joint->joint2 = gj->GetJoint2()->m_index;
+					s[0] = gj->GetRatio();
+				}
+				break;
+
+			case e_motorJoint:
+				{
+					const b2MotorJoint* mj = (const b2MotorJoint*)j;
+					v[0] = mj->GetLinearOffset();
+					s[0] = mj->GetAngularOffset();
+					s[1] = mj->GetMaxForce();
+					s[2] = mj->GetMaxTorque();
+					s[3] = mj->GetCorrectionFactor();
+				}
+				break;
+
+			case e_prismaticJoint:
+				{
+					const b2PrismaticJoint* pj = (const b2PrismaticJoint*)j;
+					v[0] = pj->GetLocalAnchorA();
+					v[1] = pj->GetLocalAnchorB();
+					v[2] = pj->GetLocalAxisA();
+					s[0] = pj->GetReferenceAngle();
+					s[1] = pj->GetLowerLimit();
+					s[2] = pj->GetUpperLimit();
+					s[3] = pj->GetMaxMotorForce();
+					s[4] = pj->GetMotorSpeed();
+					joint->flags |= pj->IsLimitEnabled() ? b2WorldFileJoint::e_enableLimitFlag : 0;
+					joint->flags |= pj->IsMotorEnabled() ? b2WorldFileJoint::e_enableMotorFlag : 0;
+				}
+				break;
+
+			case e_pulleyJoint:
+				{
+					const b2PulleyJoint* pj = (const b2PulleyJoint*)j;
+					v[0] = pj->GetGroundAnchorA();
+					v[1] = pj->GetGroundAnchorB();
+					v[2] = pj->GetLocalAnchorA();
+					v[3] = pj->GetLocalAnchorB();
+					s[0] = pj->GetLengthA();
+					s[1] = pj->GetLengthB();
+					s[2] = pj->GetRatio();
+				}
+				break;
+
+			case e_revoluteJoint:
+				{
+					const b2RevoluteJoint* rj = (const b2RevoluteJoint*)j;
+					v[0] = rj->GetLocalAnchorA();
+					v[1] = rj->GetLocalAnchorB();
+					s[0] = rj->GetReferenceAngle();
+					s[1] = rj->GetLowerLimit();
+					s[2] = rj->GetUpperLimit();
+					s[3] = rj->GetMotorSpeed();
+					s[4] = rj->GetMaxMotorTorque();
+					joint->flags |= rj->IsLimitEnabled() ? b2WorldFileJoint::e_enableLimitFlag : 0;
+					joint->flags |= rj->IsMotorEnabled() ? b2WorldFileJoint::e_enableMotorFlag : 0;
+				}
+				break;
+
+			case e_ropeJoint:
+				{
+					const b2RopeJoint* rj = (const b2RopeJoint*)j;
+					v[0] = rj->GetLocalAnchorA();
+					v[1] = rj->GetLocalAnchorB();
+					s[0] = rj->GetMaxLength();
+				}
+				break;
+
+			case e_weldJoint:
+				{
+					const b2WeldJoint* wj = (const b2WeldJoint*)j;
+					v[0] = wj->GetLocalAnchorA();
+					v[1] = wj->GetLocalAnchorB();
+					s[0] = wj->GetReferenceAngle();
+					s[1] = wj->GetFrequency();
+					s[2] = wj->GetDampingRatio();
+				}
+				break;
+
+			case e_wheelJoint:
+				{
+					const b2WheelJoint* wj = (const b2WheelJoint*)j;
+					v[0] = wj->GetLocalAnchorA();
+					v[1] = wj->GetLocalAnchorB();
+					v[2] = wj->GetLocalAxisA();
+					s[0] = wj->GetMaxMotorTorque();
+					s[1] = wj->GetMotorSpeed();
+					s[2] = wj->GetSpringFrequencyHz();
+					s[3] = wj->GetSpringDampingRatio();
+					joint->flags |= wj->IsMotorEnabled() ? b2WorldFileJoint::e_enableMotorFlag : 0;
+				}
+				break;
+
+			default:
+				b2Assert(false);
+				break;
+			}
+		}
+	}
+
+	b2Assert(jointIndex == jointCount);
+
+	return header.size;
+}
+
+bool b2World::SaveToFile(const char* path)
+{
+	int32 size = SaveToMemory(NULL, 0);
+	void* buffer = m_allocator.Allocate(size, b2_worldMemory);
+	SaveToMemory(buffer, size);
+
+	bool success = false;
+	FILE* file = fopen(path, "wb");
+	if (file)
+	{
+		success = fwrite(buffer, size, 1, file) == 1;
+		success = fclose(file) == 0 && success;
+	}
+
+	m_allocator.Free(buffer, size, b2_worldMemory);
+	return success;
+}
+
+void b2World::LoadTree(b2DynamicTree* tree, const b2WorldFileNode* nodes, int32 count, int32 root)
+{
+	// Replace the node pool. The tree is empty, so nothing needs to be kept.
+	if (count > tree->m_nodeCapacity)
+	{
+		tree->m_allocator.Free(tree->m_nodes, tree->m_nodeCapacity * sizeof(b2TreeNode), b2_treeMemory);
+		tree->m_nodeCapacity = count;
+		tree->m_nodes = (b2TreeNode*)tree->m_allocator.Allocate(tree->m_nodeCapacity * sizeof(b2TreeNode), b2_treeMemory);
+	}
+
+	for (int32 i = 0; i < count; ++i)
+	{
+		const b2WorldFileNode* record = nodes + i;
+		b2TreeNode* node = tree->m_nodes + i;
+		node->aabb = record->aabb;
+		node->userData = NULL;
+		node->parent = record->parent;
+		node->child1 = record->child1;
+		node->child2 = record->child2;
+		node->height = record->height;
+		node->categoryBits = uint16(record->categoryBits);
+		node->refit = false;
+		node->generation = 0;
+	}
+
+	// Build a linked list for the free list.
+	for (int32 i = count; i < tree->m_nodeCapacity; ++i)
+	{
+		tree->m_nodes[i].next = i + 1;
+		tree->m_nodes[i].height = -1;
+	}
+
+	if (count < tree->m_nodeCapacity)
+	{
+		tree->m_nodes[tree->m_nodeCapacity - 1].next = b2_nullNode;
+		tree->m_freeList = count;
+	}
+	else
+	{
+		tree->m_freeList = b2_nullNode;
+	}
+
+	tree->m_root = root;
+	tree->m_nodeCount = count;
+	tree->m_path = 0;
+	tree->m_insertionCount = 0;
+	tree->m_refitCount = 0;
+	tree->m_basePerimeter = tree->ComputeInternalPerimeter();
+	tree->m_perimeterGrowth = 0.0f;
+	tree->MarkAllChanged();
+}
+
+bool b2World::LoadFromMemory(const void* data, int32 size)
+{
+	b2Assert(IsLocked() == false);
+	if (IsLocked())
+	{
+		return false;
+	}
+
+	b2Assert(m_bodyCount == 0 && m_jointCount == 0);
+	if (m_bodyCount != 0 || m_jointCount != 0)
+	{
+		return false;
+	}
+
+	// Validate everything before touching the world so a bad file leaves it empty.
+	if (data == NULL || size < int32(sizeof(b2WorldFileHeader)))
+	{
+		return false;
+	}
+
+	const char* bytes = (const char*)data;
+	const b2WorldFileHeader* header = (const b2WorldFileHeader*)bytes;
+	if (header->magic != b2_worldFileMagic || header->version != b2_worldFileVersion || header->size > uint32(size) ||
+		b2IsValidPoint(header->gravity) == false)
+	{
+		return false;
+	}
+
+	if (b2IsValidSection(header, header->bodyOffset, header->bodyCount, sizeof(b2WorldFileBody)) == false ||
+		b2IsValidSection(header, header->fixtureOffset, header->fixtureCount, sizeof(b2WorldFileFixture)) == false ||
+		b2IsValidSection(header, header->proxyOffset, header->proxyCount, sizeof(b2WorldFileProxy)) == false ||
+		b2IsValidSection(header, header->vertexOffset, header->vertexCount, sizeof(b2Vec2)) == false ||
+		b2IsValidSection(header, header->jointOffset, header->jointCount, sizeof(b2WorldFileJoint)) == false ||
+		b2IsValidSection(header, header->nodeOffset[0], header->nodeCount[0], sizeof(b2WorldFileNode)) == false ||
+		b2IsValidSection(header, header->nodeOffset[1], header->nodeCount[1], sizeof(b2WorldFileNode)) == false)
+	{
+		return false;
+	}
+
+	const b2WorldFileBody* bodies = (const b2WorldFileBody*)(bytes + header->bodyOffset);
+	const b2WorldFileFixture* fixtures = (const b2WorldFileFixture*)(bytes + header->fixtureOffset);
+	const b2WorldFileProxy* proxies = (const b2WorldFileProxy*)(bytes + header->proxyOffset);
+	const b2Vec2* vertices = (const b2Vec2*)(bytes + header->vertexOffset);
+	const b2WorldFileJoint* joints = (const b2WorldFileJoint*)(bytes + header->jointOffset);
+	const b2WorldFileNode* nodes[2];
+	nodes[0] = (const b2WorldFileNode*)(bytes + header->nodeOffset[0]);
+	nodes[1] = (const b2WorldFileNode*)(bytes + header->nodeOffset[1]);
+
+	// Each node must link to nodes inside its tree, and leaves must have no children.
+	// Children must link back to their parent and heights must add up, and every node
+	// must be reachable from the root exactly once, so the trees can be walked safely.
+	int32 leafCount[2] = { 0, 0 };
+	for (int32 i = 0; i < 2; ++i)
+	{
+		int32 count = header->nodeCount[i];
+		if (header->root[i] < b2_nullNode || header->root[i] >= count || (count > 0) != (header->root[i] != b2_nullNode))
+		{
+			return false;
+		}
+
+		for (int32 j = 0; j < count; ++j)
+		{
+			const b2WorldFileNode* node = nodes[i] + j;
+			if (node->parent < b2_nullNode || node->parent >= count ||
+				node->child1 < b2_nullNode || node->child1 >= count ||
+				node->child2 < b2_nullNode || node->child2 >= count ||
+				node->height < 0 || b2IsValidBounds(node->aabb) == false)
+			{
+				return false;
+			}
+
+			if (node->child1 == b2_nullNode)
+			{
+				if (node->child2 != b2_nullNode || node->height != 0)
+				{
+					return false;
+				}
+				++leafCount[i];
+			}
+			else
+			{
+				if (node->child2 == b2_nullNode)
+				{
+					return false;
+				}
+
+				const b2WorldFileNode* child1 = nodes[i] + node->child1;
+				const b2WorldFileNode* child2 = nodes[i] + node->child2;
+				if (child1->parent != j || child2->parent != j ||
+					node->height != 1 + b2Max(child1->height, child2->height))
+				{
+					return false;
+				}
+			}
+		}
+
+		if (count == 0)
+		{
+			continue;
+		}
+
+		if (nodes[i][header->root[i]].parent != b2_nullNode)
+		{
+			return false;
+		}
+
+		bool* visited = (bool*)m_allocator.Allocate(count * sizeof(bool), b2_worldMemory);
+		memset(visited, 0, count * sizeof(bool));
+
+		int32 reached = 0;
+		bool revisited = false;
+		b2GrowableStack<int32, 256> stack;
+		stack.Push(header->root[i]);
+		while (stack.GetCount() > 0)
+		{
+			int32 nodeId = stack.Pop();
+			if (visited[nodeId])
+			{
+				revisited = true;
+				break;
+			}
+			visited[nodeId] = true;
+			++reached;
+
+			const b2WorldFileNode* node = nodes[i] + nodeId;
+			if (node->child1 != b2_nullNode)
+			{
+				stack.Push(node->child1);
+				stack.Push(node->child2);
+			}
+		}
+
+		m_allocator.Free(visited, count * sizeof(bool), b2_worldMemory);
+
+		if (revisited || reached != count)
+		{
+			return false;
+		}
+	}
+
+	// Every leaf must belong to exactly one proxy.
+	if (leafCount[0] + leafCount[1] != header->proxyCount)
+	{
+		return false;
+	}
+
+	bool* claimed[2];
+	for (int32 i = 0; i < 2; ++i)
+	{
+		claimed[i] = (bool*)m_allocator.Allocate(b2Max(header->nodeCount[i], 1) * sizeof(bool), b2_worldMemory);
+		memset(claimed[i], 0, header->nodeCount[i] * sizeof(bool));
+	}
+
+	bool valid = true;
+	int32 fixtureCount = 0;
+	int32 proxyCount = 0;
+	int32 vertexCount = 0;
+	for (int32 i = 0; i < header->bodyCount && valid; ++i)
+	{
+		const b2WorldFileBody* body = bodies + i;
+		if (body->type < b2_staticBody || body->type > b2_dynamicBody || body->fixtureCount < 0 ||
+			body->fixtureCount > header->fixtureCount - fixtureCount ||
+			b2IsValidPoint(body->position) == false || b2IsValidPoint(body->linearVelocity) == false ||
+			b2IsValidValue(body->angle) == false || b2IsValidValue(body->angularVelocity) == false ||
+			(b2IsValidValue(body->linearDamping) && body->linearDamping >= 0.0f) == false ||
+			(b2IsValidValue(body->angularDamping) && body->angularDamping >= 0.0f) == false ||
+			b2IsValidValue(body->gravityScale) == false)
+		{
+			valid = false;
+			break;
+		}
+
+		bool active = (body->flags & b2WorldFileBody::e_activeFlag) != 0;
+
+		for (int32 j = 0; j < body->fixtureCount; ++j)
+		{
+			const b2WorldFileFixture* fixture = fixtures + fixtureCount;
+			++fixtureCount;
+
+			int32 childCount = 1;
+			switch (fixture->shapeType)
+			{
+			case b2Shape::e_circle:
+				valid = fixture->vertexCount == 1;
+				break;
+
+			case b2Shape::e_edge:
+				valid = fixture->vertexCount == 4;
+				break;
+
+			case b2Shape::e_polygon:
+				valid = (fixture->vertexCount & 1) == 1 &&
+					3 <= fixture->vertexCount / 2 && fixture->vertexCount / 2 <= b2_maxPolygonVertices;
+				break;
+
+			case b2Shape::e_chain:
+				valid = fixture->vertexCount >= 4;
+				childCount = (fixture->shapeFlags & b2WorldFileFixture::e_segmentTreeFlag) ? 1 : fixture->vertexCount - 3;
+				break;
+
+			default:
+				valid = false;
+				break;
+			}
+
+			if (valid == false || fixture->vertexCount > header->vertexCount - vertexCount ||
+				fixture->proxyCount != (active ? childCount : 0) ||
+				fixture->proxyCount > header->proxyCount - proxyCount ||
+				(b2IsValidValue(fixture->friction) && fixture->friction >= 0.0f) == false ||
+				(b2IsValidValue(fixture->restitution) && fixture->restitution >= 0.0f) == false ||
+				b2IsValidSize(fixture->density, 1.0f / b2_worldFileMaxValue) == false ||
+				b2IsValidSize(fixture->radius, b2_linearSlop) == false ||
+				b2IsValidShapePoints(fixture, vertices + vertexCount) == false)
+			{
+				valid = false;
+				break;
+			}
+			vertexCount += fixture->vertexCount;
+
+			for (int32 k = 0; k < fixture->proxyCount; ++k)
+			{
+				const b2WorldFileProxy* proxy = proxies + proxyCount;
+				int32 proxyId = proxy->proxyId;
+				++proxyCount;
+
+				// Proxies in the static tree must belong to static bodies.
+				int32 tree = proxyId & 1;
+				int32 nodeId = b2BroadPhase::GetNodeId(proxyId);
+				if (proxyId < 0 || nodeId >= header->nodeCount[tree] || b2IsValidBounds(proxy->aabb) == false ||
+					(tree == b2BroadPhase::e_staticTree) != (body->type == b2_staticBody) ||
+					nodes[tree][nodeId].child1 != b2_nullNode || claimed[tree][nodeId])
+				{
+					valid = false;
+					break;
+				}
+				claimed[tree][nodeId] = true;
+			}
+
+			if (valid == false)
+			{
+				break;
+			}
+		}
+	}
+
+	for (int32 i = 0; i < 2; ++i)
+	{
+		m_allocator.Free(claimed[i], b2Max(header->nodeCount[i], 1) * sizeof(bool), b2_worldMemory);
+	}
+
+	if (valid == false || fixtureCount != header->fixtureCount || proxyCount != header->proxyCount ||
+		vertexCount != header->vertexCount)
+	{
+		return false;
+	}
+
+	for (int32 i = 0; i < header->jointCount; ++i)
+	{
+		const b2WorldFileJoint* joint = joints + i;
+		if (joint->type <= e_unknownJoint || joint->type > e_motorJoint || joint->type == e_mouseJoint ||
+			joint->bodyA < 0 || joint->bodyA >= header->bodyCount ||
+			joint->bodyB < 0 || joint->bodyB >= header->bodyCount || joint->bodyA == joint->bodyB)
+		{
+			return false;
+		}
+
+		// Anchors and axes are bounded like shape points. Scalars include forces and
+		// limits, which can legitimately be huge, so they only need to be finite.
+		for (int32 j = 0; j < 4; ++j)
+		{
+			if (b2IsValidPoint(joint->vectors[j]) == false)
+			{
+				return false;
+			}
+		}
+
+		for (int32 j = 0; j < 6; ++j)
+		{
+			if (b2IsValid(joint->scalars[j]) == false)
+			{
+				return false;
+			}
+		}
+
+		if (joint->type == e_gearJoint)
+		{
+			// Gear joints connect earlier revolute or prismatic joints.
+			if (joint->joint1 < 0 || joint->joint1 >= i || joint->joint2 < 0 || joint->joint2 >= i)
+			{
+				return false;
+			}
+
+			int32 type1 = joints[joint->joint1].type;
+			int32 type2 = joints[joint->joint2].type;
+			if ((type1 != e_revoluteJoint && type1 != e_prismaticJoint) ||
+				(type2 != e_revoluteJoint && type2 != e_prismaticJoint))
+			{
+				return false;
+			}
+		}
+	}
+
+	// The file is valid. Build the world.
+	m_gravity = header->gravity;
+
+	b2BroadPhase* broadPhase = &m_contactManager.m_broadPhase;
+	b2DynamicTree* trees[2];
+	trees[b2BroadPhase::e_dynamicTree] = &broadPhase->m_tree;
+	trees[b2BroadPhase::e_staticTree] = &broadPhase->m_staticTree;
+	for (int32 i = 0; i < 2; ++i)
+	{
+		LoadTree(trees[i], nodes[i], header->nodeCount[i], header->root[i]);
+	}
+
+	// Make room for the speed history of every proxy.
+	int32 proxyIdLimit = 2 * b2Max(header->nodeCount[0], header->nodeCount[1]);
+	if (proxyIdLimit > broadPhase->m_proxySpeedCapacity)
+	{
+		broadPhase->m_allocator.Free(broadPhase->m_proxySpeeds, broadPhase->m_proxySpeedCapacity * sizeof(float32), b2_broadPhaseMemory);
+		while (broadPhase->m_proxySpeedCapacity < proxyIdLimit)
+		{
+			broadPhase->m_proxySpeedCapacity *= 2;
+		}
+		broadPhase->m_proxySpeeds = (float32*)broadPhase->m_allocator.Allocate(broadPhase->m_proxySpeedCapacity * sizeof(float32), b2_broadPhaseMemory);
+	}
+	memset(broadPhase->m_proxySpeeds, 0, broadPhase->m_proxySpeedCapacity * sizeof(float32));
+	broadPhase->m_proxyCount = header->proxyCount;
+
+	b2Body** bodyArray = (b2Body**)m_allocator.Allocate(b2Max(header->bodyCount, 1) * sizeof(b2Body*), b2_worldMemory);
+	b2Body* lastBody = NULL;
+
+	for (int32 i = 0; i < header->bodyCount; ++i)
+	{
+		const b2WorldFileBody* body = bodies + i;
+
+		b2BodyDef bd;
+		bd.type = b2BodyType(body->type);
+		bd.position = body->position;
+		bd.angle = body->angle;
+		bd.linearVelocity = body->linearVelocity;
+		bd.angularVelocity = body->angularVelocity;
+		bd.linearDamping = body->linearDamping;
+		bd.angularDamping = body->angularDamping;
+		bd.gravityScale = body->gravityScale;
+		bd.awake = (body->flags & b2WorldFileBody::e_awakeFlag) != 0;
+		bd.allowSleep = (body->flags & b2WorldFileBody::e_autoSleepFlag) != 0;
+		bd.fixedRotation = (body->flags & b2WorldFileBody::e_fixedRotationFlag) != 0;
+		bd.bullet = (body->flags & b2WorldFileBody::e_bulletFlag) != 0;
+		bd.active = (body->flags & b2WorldFileBody::e_activeFlag) != 0;
+
+		void* mem = m_blockAllocator.Allocate(sizeof(b2Body));
+		b2Body* b = new (mem) b2Body(&bd, this);
+		bodyArray[i] = b;
+
+		// Append to keep the saved list order.
+		b->m_prev = lastBody;
+		b->m_next = NULL;
+		if (lastBody)
+		{
+			lastBody->m_next = b;
+		}
+		else
+		{
+			m_bodyList = b;
+		}
+		lastBody = b;
+		++m_bodyCount;
+
+		b2Fixture* lastFixture = NULL;
+		for (int32 j = 0; j < body->fixtureCount; ++j)
+		{
+			const b2WorldFileFixture* fixture = fixtures;
+			++fixtures;
+
+			b2FixtureDef fd;
+			fd.friction = fixture->friction;
+			fd.restitution = fixture->restitution;
+			fd.density = fixture->density;
+			fd.filter.categoryBits = fixture->categoryBits;
+			fd.filter.maskBits = fixture->maskBits;
+			fd.filter.groupIndex = fixture->groupIndex;
+			fd.isSensor = fixture->isSensor != 0;
+
+			// Build the shape on the stack for the fixture to clone.
+			b2CircleShape circle;
+			b2EdgeShape edge;
+			b2PolygonShape polygon;
+			b2ChainShape chain;
+			switch (fixture->shapeType)
+			{
+			case b2Shape::e_circle:
+				circle.m_p = vertices[0];
+				fd.shape = &circle;
+				break;
+
+			case b2Shape::e_edge:
+				edge.m_vertex0 = vertices[0];
+				edge.m_vertex1 = vertices[1];
+				edge.m_vertex2 = vertices[2];
+				edge.m_vertex3 = vertices[3];
+				edge.m_hasVertex0 = (fixture->shapeFlags & b2WorldFileFixture::e_hasVertex0Flag) != 0;
+				edge.m_hasVertex3 = (fixture->shapeFlags & b2WorldFileFixture::e_hasVertex3Flag) != 0;
+				fd.shape = &edge;
+				break;
+
+			case b2Shape::e_polygon:
+				polygon.m_count = fixture->vertexCount / 2;
+				polygon.m_centroid = vertices[0];
+				memcpy(polygon.m_vertices, vertices + 1, polygon.m_count * sizeof(b2Vec2));
+				memcpy(polygon.m_normals, vertices + 1 + polygon.m_count, polygon.m_count * sizeof(b2Vec2));
+				fd.shape = &polygon;
+				break;
+
+			case b2Shape::e_chain:
+				// Borrow the mapped vertices. The clone copies them.
+				chain.m_vertices = (b2Vec2*)(vertices + 2);
+				chain.m_count = fixture->vertexCount - 2;
+				chain.m_prevVertex = vertices[0];
+				chain.m_nextVertex = vertices[1];
+				chain.m_hasPrevVertex = (fixture->shapeFlags & b2WorldFileFixture::e_hasVertex0Flag) != 0;
+				chain.m_hasNextVertex = (fixture->shapeFlags & b2WorldFileFixture::e_hasVertex3Flag) != 0;
+				if (fixture->shapeFlags & b2WorldFileFixture::e_segmentTreeFlag)
+				{
+					chain.CreateSegmentTree();
+				}
+				fd.shape = &chain;
+				break;
+			}
+			const_cast<b2Shape*>(fd.shape)->m_radius = fixture->radius;
+			vertices += fixture->vertexCount;
+
+			void* memory = m_blockAllocator.Allocate(sizeof(b2Fixture));
+			b2Fixture* f = new (memory) b2Fixture;
+			f->Create(&m_blockAllocator, b, &fd);
+
+			chain.m_vertices = NULL;
+			chain.m_count = 0;
+
+			// Hook the proxies up to the loaded tree leaves instead of inserting them.
+			for (int32 k = 0; k < fixture->proxyCount; ++k)
+			{
+				b2FixtureProxy* proxy = f->m_proxies + k;
+				proxy->aabb = proxies->aabb;
+				proxy->fixture = f;
+				proxy->childIndex = k;
+				proxy->proxyId = proxies->proxyId;
+				++proxies;
+
+				int32 tree = broadPhase->IsStaticProxy(proxy->proxyId) ? b2BroadPhase::e_staticTree : b2BroadPhase::e_dynamicTree;
+				trees[tree]->m_nodes[b2BroadPhase::GetNodeId(proxy->proxyId)].userData = proxy;
+
+				// Static proxies don't need pairs of their own; moving proxies find them.
+				if (tree == b2BroadPhase::e_dynamicTree)
+				{
+					broadPhase->BufferMove(proxy->proxyId);
+				}
+			}
+			f->m_proxyCount = fixture->proxyCount;
+
+			// Append to keep the saved list order.
+			if (lastFixture)
+			{
+				lastFixture->m_next = f;
+			}
+			else
+			{
+				b->m_fixtureList = f;
+			}
+			lastFixture = f;
+			++b->m_fixtureCount;
+		}
+
+		// Computing the mass moves the center of mass, which adjusts the velocity.
+		b->ResetMassData();
+		b->m_linearVelocity = body->linearVelocity;
+		b->m_angularVelocity = body->angularVelocity;
+	}
+
+	// Let the world know we have new fixtures.
+	m_flags |= e_newFixture;
+
+	b2Joint** jointArray = (b2Joint**)m_allocator.Allocate(b2Max(header->jointCount, 1) * sizeof(b2Joint*), b2_worldMemory);
+
+	for (int32 i = 0; i < header->jointCount; ++i)
+	{
+		const b2WorldFileJoint* joint = joints + i;
+		const b2Vec2* v = joint->vectors;
+		const float32* s = joint->scalars;
+
+		b2DistanceJointDef distanceDef;
+		b2FrictionJointDef frictionDef;
+		b2GearJointDef gearDef;
+		b2MotorJointDef motorDef;
+		b2PrismaticJointDef prismaticDef;
+		b2PulleyJointDef pulleyDef;
+		b2RevoluteJointDef revoluteDef;
+		b2RopeJointDef ropeDef;
+		b2WeldJointDef weldDef;
+		b2WheelJointDef wheelDef;
+
+		b2JointDef* def = NULL;
+		switch (joint->type)
+		{
+		case e_distanceJoint:
+			distanceDef.localAnchorA = v[0];
+			distanceDef.localAnchorB = v[1];
+			distanceDef.length = s[0];
+			distanceDef.frequencyHz = s[1];
+			distanceDef.dampingRatio = s[2];
+			def = &distanceDef;
+			break;
+
+		case e_frictionJoint:
+			frictionDef.localAnchorA = v[0];
+			frictionDef.localAnchorB = v[1];
+			frictionDef.maxForce = s[0];
+			frictionDef.maxTorque = s[1];
+			def = &frictionDef;
+			break;
+
+		case e_gearJoint:
+			gearDef.joint1 = jointArray[joint->joint1];
+			gearDef.joint2 = jointArray[joint->joint2];
+			gearDef.ratio = s[0];
+			def = &gearDef;
+			break;
+
+		case e_motorJoint:
+			motorDef.linearOffset = v[0];
+			motorDef.angularOffset = s[0];
+			motorDef.maxForce = s[1];
+			motorDef.maxTorque = s[2];
+			motorDef.correctionFactor = s[3];
+			def = &motorDef;
+			break;
+
+		case e_prismaticJoint:
+			prismaticDef.localAnchorA = v[0];
+			prismaticDef.localAnchorB = v[1];
+			prismaticDef.localAxisA = v[2];
+			prismaticDef.referenceAngle = s[0];
+			prismaticDef.enableLimit = (joint->flags & b2WorldFileJoint::e_enableLimitFlag) != 0;
+			prismaticDef.lowerTranslation = s[1];
+			prismaticDef.upperTranslation = s[2];
+			prismaticDef.enableMotor = (joint->flags & b2WorldFileJoint::e_enableMotorFlag) != 0;
+			prismaticDef.maxMotorForce = s[3];
+			prismaticDef.motorSpeed = s[4];
+			def = &prismaticDef;
+			break;
+
+		case e_pulleyJoint:
+			pulleyDef.groundAnchorA = v[0];
+			pulleyDef.groundAnchorB = v[1];
+			pulleyDef.localAnchorA = v[2];
+			pulleyDef.localAnchorB = v[3];
+			pulleyDef.lengthA = s[0];
+			pulleyDef.lengthB = s[1];
+			pulleyDef.ratio = s[2];
+			def = &pulleyDef;
+			break;
+
+		case e_revoluteJoint:
+			revoluteDef.localAnchorA = v[0];
+			revoluteDef.localAnchorB = v[1];
+			revoluteDef.referenceAngle = s[0];
+			revoluteDef.enableLimit = (joint->flags & b2WorldFileJoint::e_enableLimitFlag) != 0;
+			revoluteDef.lowerAngle = s[1];
+			revoluteDef.upperAngle = s[2];
+			revoluteDef.enableMotor = (joint->flags & b2WorldFileJoint::e_enableMotorFlag) != 0;
+			revoluteDef.motorSpeed = s[3];
+			revoluteDef.maxMotorTorque = s[4];
+			def = &revoluteDef;
+			break;
+
+		case e_ropeJoint:
+			ropeDef.localAnchorA = v[0];
+			ropeDef.localAnchorB = v[1];
+			ropeDef.maxLength = s[0];
+			def = &ropeDef;
+			break;
+
+		case e_weldJoint:
+			weldDef.localAnchorA = v[0];
+			weldDef.localAnchorB = v[1];
+			weldDef.referenceAngle = s[0];
+			weldDef.frequencyHz = s[1];
+			weldDef.dampingRatio = s[2];
+			def = &weldDef;
+			break;
+
+		case e_wheelJoint:
+			wheelDef.localAnchorA = v[0];
+			wheelDef.localAnchorB = v[1];
+			wheelDef.localAxisA = v[2];
+			wheelDef.enableMotor = (joint->flags & b2WorldFileJoint::e_enableMotorFlag) != 0;
+			wheelDef.maxMotorTorque = s[0];
+			wheelDef.motorSpeed = s[1];
+			wheelDef.frequencyHz = s[2];
+			wheelDef.dampingRatio = s[3];
+			def = &wheelDef;
+			break;
+		}
+
+		def->bodyA = bodyArray[joint->bodyA];
+		def->bodyB = bodyArray[joint->bodyB];
+		def->collideConnected = (joint->flags & b2WorldFileJoint::e_collideConnectedFlag) != 0;
+		jointArray[i] = CreateJoint(def);
+	}
+
+	m_allocator.Free(jointArray, b2Max(header->jointCount, 1) * sizeof(b2Joint*), b2_worldMemory);
+	m_allocator.Free(bodyArray, b2Max(header->bodyCount, 1) * sizeof(b2Body*), b2_worldMemory);
+
+	return true;
+}
+
+bool b2World::LoadFromFile(const char* path)
+{
+#if defined(_WIN32)
+	HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+
+	bool success = false;
+	LARGE_INTEGER size;
+	if (GetFileSizeEx(file, &size) && size.QuadPart > 0 && size.QuadPart <= 0x7FFFFFFF)
+	{
+		HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (mapping)
+		{
+			const void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+			if (data)
+			{
+				success = LoadFromMemory(data, int32(size.QuadPart));
+				UnmapViewOfFile(data);
+			}
+			CloseHandle(mapping);
+		}
+	}
+
+	CloseHandle(file);
+	return success;
+#else
+	int file = open(path, O_RDONLY);
+	if (file < 0)
+	{
+		return false;
+	}
+
+	bool success = false;
+	struct stat info;
+	if (fstat(file, &info) == 0 && info.st_size > 0 && info.st_size <= 0x7FFFFFFF)
+	{
+		void* data = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+		if (data != MAP_FAILED)
+		{
+			success = LoadFromMemory(data, int32(info.st_size));
+			munmap(data, info.st_size);
+		}
+	}
+
+	close(file);
+	return success;
+#endif
+}
@@ -0,0 +1,159 @@
+/*
+* Copyright (c) 2006-2011 Erin Catto http://www.box2d.org
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef B2_WORLD_FILE_H
+#define B2_WORLD_FILE_H
+
+#include <Box2D/Collision/b2Collision.h>
+
+/// The binary world file format written by b2World::SaveToMemory and read by
+/// b2World::LoadFromMemory. A file is a header followed by arrays of fixed size
+/// records. All records are made of 4 byte fields in native byte order, so a mapped
+/// file can be read in place. Files are only portable between machines with the
+/// same byte order.
+
+/// "b2WF" read as a little endian integer. A file with the wrong byte order fails
+/// the magic number check.
+#define b2_worldFileMagic 0x46573262
+
+/// Bump this whenever the layout or meaning of any record changes.
+#define b2_worldFileVersion 2
+
+struct b2WorldFileHeader
+{
+	uint32 magic;
+	uint32 version;
+	uint32 size;	///< total size of the file in bytes
+
+	b2Vec2 gravity;
+
+	int32 bodyCount;
+	int32 fixtureCount;
+	int32 proxyCount;
+	int32 vertexCount;
+	int32 jointCount;
+	int32 nodeCount[2];	///< indexed by broad-phase tree: dynamic, then static
+	int32 root[2];
+
+	// Byte offsets of the record arrays from the start of the file.
+	uint32 bodyOffset;
+	uint32 fixtureOffset;
+	uint32 proxyOffset;
+	uint32 vertexOffset;
+	uint32 jointOffset;
+	uint32 nodeOffset[2];
+};
+
+/// Bodies and their fixtures are stored in list order. Each body owns the next
+/// fixtureCount fixtures.
+struct b2WorldFileBody
+{
+	enum
+	{
+		e_awakeFlag			= 0x0001,
+		e_autoSleepFlag		= 0x0002,
+		e_fixedRotationFlag	= 0x0004,
+		e_bulletFlag		= 0x0008,
+		e_activeFlag		= 0x0010
+	};
+
+	b2Vec2 position;
+	float32 angle;
+	b2Vec2 linearVelocity;
+	float32 angularVelocity;
+	float32 linearDamping;
+	float32 angularDamping;
+	float32 gravityScale;
+	int32 type;
+	uint32 flags;
+	int32 fixtureCount;
+};
+
+/// Each fixture owns the next vertexCount shape points and the next proxyCount proxies.
+/// The shape points are laid out as follows:
+/// - circle: position
+/// - edge: vertex0, vertex1, vertex2, vertex3
+/// - polygon: centroid, then the vertices, then the normals
+/// - chain: previous vertex, next vertex, then the vertices
+struct b2WorldFileFixture
+{
+	enum
+	{
+		e_hasVertex0Flag	= 0x0001,	///< edge vertex0 or chain previous vertex
+		e_hasVertex3Flag	= 0x0002,	///< edge vertex3 or chain next vertex
+		e_segmentTreeFlag	= 0x0004	///< chain with a segment tree
+	};
+
+	float32 friction;
+	float32 restitution;
+	float32 density;
+	uint16 categoryBits;
+	uint16 maskBits;
+	int16 groupIndex;
+	uint16 isSensor;
+
+	int32 shapeType;
+	float32 radius;
+	uint32 shapeFlags;
+	int32 vertexCount;
+	int32 proxyCount;	///< the shape's child count, or zero if the body is inactive
+};
+
+/// A fixture proxy. Proxies are stored in child order.
+struct b2WorldFileProxy
+{
+	b2AABB aabb;
+	int32 proxyId;
+};
+
+/// Joints are stored in creation order, except that gear joints come last so the
+/// joints they connect are created first. Mouse joints are not stored.
+/// The meaning of vectors and scalars depends on the joint type. They hold the
+/// fields of the joint def in the order they are declared, skipping the flags.
+struct b2WorldFileJoint
+{
+	enum
+	{
+		e_collideConnectedFlag	= 0x0001,
+		e_enableLimitFlag		= 0x0002,
+		e_enableMotorFlag		= 0x0004
+	};
+
+	int32 type;
+	int32 bodyA;
+	int32 bodyB;
+	int32 joint1;	///< gear joints only
+	int32 joint2;	///< gear joints only
+	uint32 flags;
+	b2Vec2 vectors[4];
+	float32 scalars[6];
+};
+
+/// A broad-phase tree node. Nodes are stored in depth first order, so node ids are
+/// the record indices and proxy ids are 2 * node id + tree.
+struct b2WorldFileNode
+{
+	b2AABB aabb;
+	int32 parent;
+	int32 child1;
+	int32 child2;
+	int32 height;
+	uint32 categoryBits;
+};
+
+#endif
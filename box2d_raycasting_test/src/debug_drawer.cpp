@@ -97,4 +97,22 @@ void DebugDrawerSFML::DrawTransform(const b2Transform& xf) {
 
 	m_target->draw(redLine, 2, sf::Lines);
 	m_target->draw(greenLine, 2, sf::Lines);
-}
\ No newline at end of file
+}
+
+void TreeNodeDrawerSFML::ReportNode(const b2AABB& aabb) {
+	const sf::Vector2f corners[4] = {
+		B2VecToSFVec(aabb.lowerBound, m_scale),
+		B2VecToSFVec(b2Vec2(aabb.upperBound.x, aabb.lowerBound.y), m_scale),
+		B2VecToSFVec(aabb.upperBound, m_scale),
+		B2VecToSFVec(b2Vec2(aabb.lowerBound.x, aabb.upperBound.y), m_scale)
+	};
+	m_lines.setPrimitiveType(sf::Lines);
+	for (int i = 0; i < 4; ++i) {
+		m_lines.append(sf::Vertex(corners[i], m_color));
+		m_lines.append(sf::Vertex(corners[(i + 1) % 4], m_color));
+	}
+}
+
+void TreeNodeDrawerSFML::Draw(sf::RenderTarget& target) const {
+	target.draw(m_lines);
+}
@@ -4,9 +4,11 @@
 #ifndef DEBUG_DRAWER_H_
 #define DEBUG_DRAWER_H_
 
+#include "Box2D/Collision/b2DynamicTree.h"
 #include "Box2D/Common/b2Draw.h"
 
 #include "SFML/Graphics/Color.hpp"
+#include "SFML/Graphics/VertexArray.hpp"
 #include "SFML/System/Vector2.hpp"
 
 namespace sf {
@@ -36,4 +38,21 @@ public:
 	void DrawTransform(const b2Transform& xf);
 };
 
+// Collects the bounds of the broad-phase nodes that ray-casts visit and draws them in one
+// batch. Every visit adds a faint outline, so the nodes that the most rays pay for are
+// the brightest.
+class TreeNodeDrawerSFML : public b2TreeNodeCallback {
+public:
+	float m_scale = 32.0f;
+	sf::Color m_color = sf::Color(255, 64, 0, 24);
+
+	void ReportNode(const b2AABB& aabb);
+
+	void Clear() { m_lines.clear(); }
+	void Draw(sf::RenderTarget& target) const;
+
+private:
+	sf::VertexArray m_lines;
+};
+
 #endif//DEBUG_DRAWER_H_
\ No newline at end of file
@@ -0,0 +1,54 @@
+// Rachel Crawford 2016
+// This file lives at https://github.com/rachelnertia/Box2D-Raycasting-Test
+
+#include "input_trace.h"
+
+namespace {
+
+// "RCTR" read as a little endian integer.
+const uint32 trace_magic = 0x52544352;
+// Bump this whenever TraceFrame changes.
+const uint32 trace_version = 2;
+
+}
+
+bool InputTraceWriter::Open(const char* path, float timestep) {
+	m_file.open(path, std::ios::binary | std::ios::trunc);
+	if (!m_file) {
+		return false;
+	}
+
+	TraceHeader header;
+	header.magic = trace_magic;
+	header.version = trace_version;
+	header.timestep = timestep;
+	header.frame_size = sizeof(TraceFrame);
+	m_file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	return bool(m_file);
+}
+
+void InputTraceWriter::Write(const TraceFrame& frame) {
+	m_file.write(reinterpret_cast<const char*>(&frame), sizeof(frame));
+	// Flush every frame so a crash loses at most the frame it happened in. A frame is
+	// a few dozen bytes, so this is cheap next to the rest of the frame.
+	m_file.flush();
+}
+
+bool ReadInputTrace(const char* path, TraceHeader& header, std::vector<TraceFrame>& frames) {
+	std::ifstream file(path, std::ios::binary);
+	if (!file.read(reinterpret_cast<char*>(&header), sizeof(header))) {
+		return false;
+	}
+	if (header.magic != trace_magic || header.version != trace_version ||
+		header.frame_size != sizeof(TraceFrame)) {
+		return false;
+	}
+
+	// A partly written last frame, e.g. from a crash, is dropped.
+	frames.clear();
+	TraceFrame frame;
+	while (file.read(reinterpret_cast<char*>(&frame), sizeof(frame))) {
+		frames.push_back(frame);
+	}
+	return true;
+}
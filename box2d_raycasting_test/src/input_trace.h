@@ -0,0 +1,59 @@
+// Rachel Crawford 2016
+// This file lives at https://github.com/rachelnertia/Box2D-Raycasting-Test
+
+#ifndef INPUT_TRACE_H_
+#define INPUT_TRACE_H_
+
+#include <fstream>
+#include <vector>
+
+#include "Box2D/Common/b2Math.h"
+
+// Everything a frame of the main loop depends on besides the world, captured so that
+// a run can be replayed exactly without a keyboard or a window. The camera is the one
+// the frame was drawn from, so the replay doesn't depend on how keys were read.
+struct TraceFrame {
+	enum : uint8 {
+		TRUE_DISTANCE = 0x01,
+		VIEW_PLANE_RAYDIR = 0x02,
+		ASYNC_PHYSICS = 0x04,
+		BOX2D_DEBUG = 0x08,
+		COST_HEATMAP = 0x10
+	};
+
+	b2Vec2 camera_pos;
+	b2Vec2 camera_fwd;
+	// Where sprites were drawn between their previous and current positions.
+	float interpolation;
+	float angle_modifier;
+	uint16 frame_width;
+	// How many fixed steps ran before the frame was drawn.
+	uint8 steps;
+	uint8 flags;
+};
+
+// A trace file is a header followed by frames, written as they happen so that a run
+// that crashes still leaves a usable trace. Fields are stored in native byte order.
+struct TraceHeader {
+	uint32 magic;
+	uint32 version;
+	float timestep;
+	uint32 frame_size;
+};
+
+// Appends frames to a trace file, flushing after each one.
+class InputTraceWriter {
+public:
+	// Returns false if the file can't be opened.
+	bool Open(const char* path, float timestep);
+	bool IsOpen() const { return m_file.is_open(); }
+	void Write(const TraceFrame& frame);
+
+private:
+	std::ofstream m_file;
+};
+
+// Reads a whole trace file. Returns false if it can't be read or isn't a trace.
+bool ReadInputTrace(const char* path, TraceHeader& header, std::vector<TraceFrame>& frames);
+
+#endif//INPUT_TRACE_H_
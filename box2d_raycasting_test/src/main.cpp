@@ -1,40 +1,19 @@
 // Rachel Crawford 2016
 // This file lives at https://github.com/rachelnertia/Box2D-Raycasting-Test
 
+#include <algorithm>
+#include <cstring>
+#include <fstream>
 #include <iostream>
+#include <vector>
 #include "Box2D/Box2D.h"
 #include "SFML/Graphics.hpp"
 #include "debug_drawer.h"
-
-struct Camera {
-	b2Vec2 pos;
-	b2Vec2 fwd;
-};
-
-class RayCastCallback : public b2RayCastCallback {
-public:
-
-	float32 ReportFixture(b2Fixture* fixture, const b2Vec2& point,
-		const b2Vec2& normal, float32 fraction)
-	{
-		m_fixture = fixture;
-		m_point = point;
-		m_normal = normal;
-		m_fraction = fraction;
-		return fraction;
-	}
-
-	b2Fixture* m_fixture = nullptr;
-	b2Vec2 m_point;
-	b2Vec2 m_normal;
-	float32 m_fraction;
-};
-
-b2Vec2 RotateVec(const b2Vec2& vec, const float angle) {
-	return b2Vec2(
-		vec.x*cosf(angle) - vec.y*sinf(angle),
-		vec.x*sinf(angle) + vec.y*cosf(angle));
-}
+#include "input_trace.h"
+#include "perf_hud.h"
+#include "physics_thread.h"
+#include "raycast_renderer.h"
+#include "resolution_controller.h"
 
 float DotProduct(const b2Vec2& a, const b2Vec2& b) {
 	return a.x * b.x + a.y * b.y;
@@ -48,83 +27,37 @@ b2Vec2 ProjectVec(const b2Vec2& vec, const b2Vec2& other) {
 	return scalar * other_dir;
 }
 
-bool distance_mode_toggle = true;
-bool raydir_mode_toggle = true;
-float angle_modifier = 1.0f;
-
-void RaycastRender(b2World& world, sf::RenderTarget& target, Camera& camera) 
-{
-	const float ray_length = 15.0f; // How far rays will travel before they will stop.
-	const float view_angle = (3.14f * (0.25f * angle_modifier)); 
-	const b2Vec2 view_plane(-camera.fwd.y * angle_modifier, camera.fwd.x * angle_modifier);	
-	const b2Vec2 raystart = camera.pos;
-
-	// Cast a ray for each horizontal pixel.
-	for (unsigned i = 0; i < target.getSize().x; ++i) {
-		// Determine the direction the ray should go in...
-		// [-1, 1] How far across the screen from left to right the current ray is.
-		float screenx = -1.0f + (2.0f * (i / (float)target.getSize().x)); 
-		// There are 2 ways to calculate the ray's direction.
-		b2Vec2 raydir = raydir_mode_toggle ?
-			// 1: Scale the view plane vector by screenx and add it to the camera's forward vector.
-			(camera.fwd) + (screenx * view_plane) :
-			// 2: Rotate the camera's forward vector by the viewing angle scaled by screenx. 
-			RotateVec(camera.fwd, view_angle * screenx);
-		// Determine the end point of the ray in world space.
-		b2Vec2 rayend = camera.pos + ray_length * raydir;
-
-		RayCastCallback callback;
-		world.RayCast(&callback, raystart, rayend); // Cast the ray!
-
-		if (callback.m_fixture) { // If the ray hit something...
-			b2Vec2 ray = (callback.m_point - raystart);
-			// Use either the 1) actual distance or 2) perpendicular distance from the camera to the
-			// ray hit point.
-			float distance = distance_mode_toggle ? ray.Length() : DotProduct(ray, camera.fwd);
-			// Use this distance to figure out how tall a line to draw.
-			int line_height = abs(int(target.getSize().y / distance));
-			// Make far-away lines darker.
-			sf::Uint8 f = sf::Uint8((1.f - (distance / ray_length)) * 255.0f);
-			sf::Color c(f, f, f);
-
-			sf::Vertex line[2] =
-			{
-				sf::Vertex(sf::Vector2f(float(i+1), (float)(target.getSize().y / 2) - (line_height / 2)), c),
-				sf::Vertex(sf::Vector2f(float(i+1), (float)(target.getSize().y / 2) + (line_height / 2)), c)
-			};
-
-			target.draw(line, 2, sf::PrimitiveType::Lines);
-		}
-	}
-
-}
-
-// Adds a static box body to the given Box2D world.
-void AddStaticBox(b2World& world, b2Vec2 centre, b2Vec2 dimensions) {
-	b2BodyDef bdef;
-	bdef.type = b2_staticBody;
-	bdef.position = centre;
-	b2Body* body = world.CreateBody(&bdef);
+// Adds a static box body at each of the given centres to the given Box2D world.
+// The bodies are created in one batch, which builds their part of the static
+// broad-phase tree in a single pass.
+void AddStaticBoxes(b2World& world, const std::vector<b2Vec2>& centres, b2Vec2 dimensions) {
 	b2PolygonShape box;
 	box.SetAsBox(dimensions.x, dimensions.y);
-	b2FixtureDef fixture_def;
-	fixture_def.shape = &box;
-	body->CreateFixture(&fixture_def);
+	std::vector<b2BodyDef> body_defs(centres.size());
+	std::vector<b2FixtureDef> fixture_defs(centres.size());
+	for (size_t i = 0; i < centres.size(); ++i) {
+		body_defs[i].type = b2_staticBody;
+		body_defs[i].position = centres[i];
+		fixture_defs[i].shape = &box;
+		fixture_defs[i].filter.categoryBits = WALL_CATEGORY;
+	}
+	world.CreateStaticBodies(body_defs.data(), fixture_defs.data(), (int32)centres.size());
 }
 
-int main() {
+const b2Vec2 gravity(0.0f, -1.0f);
+const float timestep = 1.0f / 60.0f;
 
-	sf::RenderWindow window;
-	window.create(sf::VideoMode(512, 512), "SFML Window");
-
-	b2Vec2 gravity(0.0f, -1.0f);
-
-	b2World world(gravity);
-
-	AddStaticBox(world, b2Vec2(2.5f, 2.5f), b2Vec2(1.0f, 1.0f));
-	AddStaticBox(world, b2Vec2(7.0f, 2.5f), b2Vec2(1.0f, 1.0f));
-	AddStaticBox(world, b2Vec2(7.0f, 7.0f), b2Vec2(1.0f, 1.0f));
-	AddStaticBox(world, b2Vec2(2.5f, 7.0f), b2Vec2(1.0f, 1.0f));
+// Fills the world with the demo's walls and bodies. Replays depend on this building
+// the same world every time.
+void CreateDemoWorld(b2World& world) {
+	{
+		std::vector<b2Vec2> wall_centres;
+		wall_centres.push_back(b2Vec2(2.5f, 2.5f));
+		wall_centres.push_back(b2Vec2(7.0f, 2.5f));
+		wall_centres.push_back(b2Vec2(7.0f, 7.0f));
+		wall_centres.push_back(b2Vec2(2.5f, 7.0f));
+		AddStaticBoxes(world, wall_centres, b2Vec2(1.0f, 1.0f));
+	}
 
 	// Add a dynamic circle body.
 	{
@@ -138,13 +71,179 @@ int main() {
 		fixdef.shape = &circle;
 		fixdef.density = 1.0f;
 		fixdef.friction = 0.3f;
+		fixdef.filter.categoryBits = ENTITY_CATEGORY;
 		body->CreateFixture(&fixdef);
 	}
+}
+
+// Runs the frames of a trace without a window. Each frame does the same stepping and
+// raycasting work as the main loop did when it was recorded, and how long that took is
+// written out as CSV, along with a summary on stderr.
+int Replay(const char* trace_path, const char* timings_path) {
+	TraceHeader header;
+	std::vector<TraceFrame> frames;
+	if (!ReadInputTrace(trace_path, header, frames)) {
+		std::cerr << "Couldn't read trace " << trace_path << std::endl;
+		return 1;
+	}
+
+	std::ofstream timings_file;
+	if (timings_path) {
+		timings_file.open(timings_path);
+		if (!timings_file) {
+			std::cerr << "Couldn't write " << timings_path << std::endl;
+			return 1;
+		}
+	}
+	std::ostream& timings = timings_path ? timings_file : std::cout;
+	timings << "frame,steps,width,physics_ms,render_ms,frame_ms\n";
+
+	b2World world(gravity);
+	CreateDemoWorld(world);
+
+	RaycastRenderer raycast_renderer;
+	bool async_physics = true;
+	PhysicsThread physics_thread(world);
+	b2QuerySnapshot* snapshot = world.CreateQuerySnapshot();
+
+	std::vector<float> frame_times;
+	frame_times.reserve(frames.size());
+
+	for (size_t i = 0; i < frames.size(); ++i) {
+		const TraceFrame& frame = frames[i];
+		sf::Clock frame_clock;
+
+		const bool frame_async = (frame.flags & TraceFrame::ASYNC_PHYSICS) != 0;
+		if (frame_async != async_physics) {
+			// What pressing T does.
+			physics_thread.WaitForStep();
+			async_physics = frame_async;
+			world.UpdateQuerySnapshot(snapshot);
+			raycast_renderer.RecordPreviousPositions(world);
+		}
+
+		// In async mode this is the time spent at the sync point.
+		sf::Clock physics_clock;
+		if (!async_physics) {
+			for (int step = 0; step < frame.steps; ++step) {
+				raycast_renderer.RecordPreviousPositions(world);
+				world.Step(header.timestep, physics_thread.m_velocity_iterations,
+					physics_thread.m_position_iterations);
+			}
+		}
+		else if (frame.steps > 0) {
+			physics_thread.WaitForStep();
+			raycast_renderer.RecordPreviousPositions(*snapshot);
+			world.UpdateQuerySnapshot(snapshot);
+			physics_thread.BeginStep(header.timestep, frame.steps);
+		}
+		const float physics_ms = physics_clock.getElapsedTime().asMicroseconds() / 1000.0f;
+
+		Camera camera;
+		camera.pos = frame.camera_pos;
+		camera.fwd = frame.camera_fwd;
+		raycast_renderer.m_cost_heatmap = (frame.flags & TraceFrame::COST_HEATMAP) != 0;
+
+		// Debug draw frames need a window, so only their wait for the step and the rays
+		// the cost view traces through the tree are replayed.
+		sf::Clock render_clock;
+		if (frame.flags & TraceFrame::BOX2D_DEBUG) {
+			physics_thread.WaitForStep();
+			if (raycast_renderer.m_cost_heatmap) {
+				raycast_renderer.TraceRays(world, camera, frame.frame_width, nullptr);
+			}
+		}
+		else {
+			raycast_renderer.m_true_distance = (frame.flags & TraceFrame::TRUE_DISTANCE) != 0;
+			raycast_renderer.m_view_plane_raydir = (frame.flags & TraceFrame::VIEW_PLANE_RAYDIR) != 0;
+			raycast_renderer.m_angle_modifier = frame.angle_modifier;
+			raycast_renderer.m_interpolation = frame.interpolation;
+
+			if (async_physics) {
+				raycast_renderer.BuildFrame(*snapshot, camera, frame.frame_width, frame.frame_width);
+			}
+			else {
+				raycast_renderer.BuildFrame(world, camera, frame.frame_width, frame.frame_width);
+			}
+		}
+		const float render_ms = render_clock.getElapsedTime().asMicroseconds() / 1000.0f;
+		const float frame_ms = frame_clock.getElapsedTime().asMicroseconds() / 1000.0f;
+
+		timings << i << ',' << int(frame.steps) << ',' << frame.frame_width << ',' << physics_ms << ',' <<
+			render_ms << ',' << frame_ms << '\n';
+		frame_times.push_back(frame_ms);
+	}
+
+	physics_thread.WaitForStep();
+
+	if (!frame_times.empty()) {
+		float total_ms = 0.0f;
+		for (float ms : frame_times) {
+			total_ms += ms;
+		}
+		std::sort(frame_times.begin(), frame_times.end());
+		std::cerr << frame_times.size() << " frames, mean " << total_ms / frame_times.size() <<
+			" ms, 99th percentile " << frame_times[frame_times.size() * 99 / 100] <<
+			" ms, worst " << frame_times.back() << " ms" << std::endl;
+	}
+	return 0;
+}
+
+// Options:
+//   --record PATH   write the input of every frame to a trace file
+//   --replay PATH   replay a trace without a window instead of running the demo
+//   --timings PATH  where a replay writes its frame timings, stdout by default
+//   --font PATH     the font for the performance overlay
+int main(int argc, char** argv) {
+
+	const char* record_path = nullptr;
+	const char* replay_path = nullptr;
+	const char* timings_path = nullptr;
+	const char* font_path = nullptr;
+	for (int i = 1; i < argc; i += 2) {
+		const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+		if (value && strcmp(argv[i], "--record") == 0) {
+			record_path = value;
+		}
+		else if (value && strcmp(argv[i], "--replay") == 0) {
+			replay_path = value;
+		}
+		else if (value && strcmp(argv[i], "--timings") == 0) {
+			timings_path = value;
+		}
+		else if (value && strcmp(argv[i], "--font") == 0) {
+			font_path = value;
+		}
+		else {
+			std::cerr << "Unknown option or missing value: " << argv[i] << std::endl;
+			return 1;
+		}
+	}
+
+	if (replay_path) {
+		return Replay(replay_path, timings_path);
+	}
+
+	InputTraceWriter trace_writer;
+	if (record_path && !trace_writer.Open(record_path, timestep)) {
+		std::cerr << "Couldn't write trace " << record_path << std::endl;
+		return 1;
+	}
+
+	sf::RenderWindow window;
+	window.create(sf::VideoMode(512, 512), "SFML Window");
+
+	b2World world(gravity);
+	CreateDemoWorld(world);
 
 	DebugDrawerSFML debug_drawer;
 	debug_drawer.m_target = &window;
 	debug_drawer.SetFlags(b2Draw::e_shapeBit | b2Draw::e_centerOfMassBit);
 	world.SetDebugDraw(&debug_drawer);
+
+	// Draws the tree nodes the camera's rays visit in the traversal cost view.
+	TreeNodeDrawerSFML tree_node_drawer;
+	tree_node_drawer.m_scale = debug_drawer.m_scale;
 	
 
 	sf::Clock clock;
@@ -158,12 +257,46 @@ int main() {
 	camera.fwd.x = -1.0f;
 	camera.fwd.y = 0.0f;
 
+	// The camera is moved once per step. Frames are drawn from a point between its
+	// previous and current positions.
+	Camera previous_camera = camera;
+	Camera render_camera = camera;
+
 	unsigned frame_tex_width = 512;
 	unsigned frame_tex_height = frame_tex_width;
 
 	sf::RenderTexture frame_tex;
 	frame_tex.create(frame_tex_width, frame_tex_height);
 
+	// Adjusts the width of the frame texture to keep rendering inside a time budget.
+	ResolutionController resolution_controller(frame_tex_width);
+	bool dynamic_resolution = true;
+
+	RaycastRenderer raycast_renderer;
+
+	// In async physics mode the world steps on the physics thread while we render from
+	// a snapshot of the previous step. The snapshot is refreshed at the sync point, which
+	// only copies what moved. The world destroys it.
+	bool async_physics = true;
+	PhysicsThread physics_thread(world);
+	b2QuerySnapshot* snapshot = world.CreateQuerySnapshot();
+
+	PerfHud perf_hud;
+	{
+		// Fall back on a font that ships with the OS if none was given.
+		const char* font_paths[] = {
+			font_path,
+			"font.ttf",
+			"C:/Windows/Fonts/consola.ttf",
+			"/usr/share/fonts/truetype/dejavu/DejaVuSansMono.ttf",
+			"/Library/Fonts/Arial.ttf"
+		};
+		if (!perf_hud.LoadFont(font_paths, sizeof(font_paths) / sizeof(font_paths[0]))) {
+			std::cout << "No font found, the performance overlay will only show the frame graph" << std::endl;
+		}
+	}
+	sf::Clock frame_clock;
+
 	while (window.isOpen()) {
 
 		{
@@ -191,33 +324,67 @@ int main() {
 					case sf::Keyboard::E:
 						// Toggle between ways of calculating the distance to the ray
 						// hit point.
-						distance_mode_toggle = !distance_mode_toggle;
+						raycast_renderer.m_true_distance = !raycast_renderer.m_true_distance;
 						std::cout << "Distance Mode: " <<
-							(distance_mode_toggle ? "true distance" : "perpendicular distance") 
+							(raycast_renderer.m_true_distance ? "true distance" : "perpendicular distance") 
 							<< std::endl;
 						break;
 					case sf::Keyboard::R:
 						// Toggle between ways of calculating the direction of the ray.
-						raydir_mode_toggle = !raydir_mode_toggle;
+						raycast_renderer.m_view_plane_raydir = !raycast_renderer.m_view_plane_raydir;
 						std::cout << "Ray Direction Mode: " <<
-							(raydir_mode_toggle ? "view plane" : "rotated forward vector")
+							(raycast_renderer.m_view_plane_raydir ? "view plane" : "rotated forward vector")
 							<< std::endl;
 						break;
 					case sf::Keyboard::F:
-						if (frame_tex_width > 64) {
-							frame_tex_width /= 2;
-							frame_tex_height = frame_tex_width;
-						}
+					case sf::Keyboard::G:
+						// Choosing the resolution by hand turns off dynamic resolution.
+						dynamic_resolution = false;
+						resolution_controller.SetWidth(event.key.code == sf::Keyboard::F ?
+							frame_tex_width / 2 : frame_tex_width * 2);
+						frame_tex_width = resolution_controller.GetWidth();
+						frame_tex_height = frame_tex_width;
 						frame_tex.create(frame_tex_width, frame_tex_height);
 						std::cout << "Frame Texture Width: " << frame_tex_width << std::endl;
 						break;
-					case sf::Keyboard::G:
-						if (frame_tex_width < 512) {
-							frame_tex_width *= 2;
-							frame_tex_height = frame_tex_width;
+					case sf::Keyboard::T:
+						// Toggle stepping the world on the physics thread.
+						physics_thread.WaitForStep();
+						async_physics = !async_physics;
+						world.UpdateQuerySnapshot(snapshot);
+						raycast_renderer.RecordPreviousPositions(world);
+						std::cout << "Async Physics: " <<
+							(async_physics ? "on" : "off") << std::endl;
+						break;
+					case sf::Keyboard::H:
+						// Toggle dynamic resolution.
+						dynamic_resolution = !dynamic_resolution;
+						resolution_controller.SetWidth(frame_tex_width);
+						std::cout << "Dynamic Resolution: " <<
+							(dynamic_resolution ? "on" : "off") << std::endl;
+						break;
+					case sf::Keyboard::P:
+						// Capture the zones of the next few frames for chrome://tracing.
+						if (b2BeginProfileCapture("profile_trace.json", 120)) {
+							std::cout << "Capturing 120 frames to profile_trace.json" << std::endl;
 						}
-						frame_tex.create(frame_tex_width, frame_tex_height);
-						std::cout << "Frame Texture Width: " << frame_tex_width << std::endl;
+						else if (!b2IsProfileCapturing()) {
+							std::cout << "The profiler is compiled out, define b2_profiler as 1" << std::endl;
+						}
+						break;
+					case sf::Keyboard::F1:
+						// Toggle the performance overlay.
+						perf_hud.m_visible = !perf_hud.m_visible;
+						break;
+					case sf::Keyboard::V:
+						// Toggle showing what each ray costs: a heatmap of the columns in
+						// raycast mode and the tree nodes the rays visit in debug draw mode.
+						raycast_renderer.m_cost_heatmap = !raycast_renderer.m_cost_heatmap;
+						debug_drawer.SetFlags(raycast_renderer.m_cost_heatmap ?
+							debug_drawer.GetFlags() | b2Draw::e_treeBit :
+							debug_drawer.GetFlags() & ~b2Draw::e_treeBit);
+						std::cout << "Traversal Cost View: " <<
+							(raycast_renderer.m_cost_heatmap ? "on" : "off") << std::endl;
 						break;
 					}
 					break;
@@ -226,19 +393,30 @@ int main() {
 			}
 		}
 
+		FrameSample frame_sample = FrameSample();
+
 		{
+			// Also counts moving the camera, which is next to nothing.
+			sf::Clock physics_clock;
+
+			// Run as many fixed steps as the elapsed time covers and carry the rest over to
+			// the next frame. The number of steps per frame is capped so that a slow frame
+			// can't make the next one slower still.
 			dt += clock.restart().asSeconds();
-			float timestep = 1.0f / 60.0f;
-			if (dt >= timestep) { // If 1/60th of a second has passed...
-				dt = 0.0f;
+			const int max_steps = 5;
+			int steps = 0;
+			while (dt >= timestep && steps < max_steps) {
+				dt -= timestep;
+				++steps;
 
 				// Step the Box2D world.
-				{
-					int velocity_iterations = 8;
-					int position_iterations = 2;
-					world.Step(timestep, velocity_iterations, position_iterations);
+				if (!async_physics) {
+					raycast_renderer.RecordPreviousPositions(world);
+					world.Step(timestep, physics_thread.m_velocity_iterations, physics_thread.m_position_iterations);
 				}
-				
+
+				previous_camera = camera;
+
 				// Move and rotate the camera.
 				{
 					const float movespeed = 0.1f;
@@ -272,15 +450,59 @@ int main() {
 				{
 					const float angle_change_speed = 0.05f;
 					if (sf::Keyboard::isKeyPressed(sf::Keyboard::Z)) {
+						float& angle_modifier = raycast_renderer.m_angle_modifier;
 						angle_modifier -= angle_change_speed;
 						angle_modifier = std::max(angle_modifier, 0.25f);
 					}
 					if (sf::Keyboard::isKeyPressed(sf::Keyboard::X)) {
+						float& angle_modifier = raycast_renderer.m_angle_modifier;
 						angle_modifier += angle_change_speed;
 						angle_modifier = std::min(angle_modifier, 2.0f);
 					}
 				}
 			}
+			if (steps == max_steps) {
+				// Give up on the time we couldn't catch up on.
+				dt = std::min(dt, timestep);
+			}
+
+			if (async_physics && steps > 0) {
+				// Sync point: wait for the last steps to finish and snapshot the result for
+				// rendering, then start the next steps so they run while we render.
+				physics_thread.WaitForStep();
+				perf_hud.SampleWorld(world);
+				raycast_renderer.RecordPreviousPositions(*snapshot);
+				world.UpdateQuerySnapshot(snapshot);
+				physics_thread.BeginStep(timestep, steps);
+			}
+			else if (steps > 0) {
+				perf_hud.SampleWorld(world);
+			}
+			frame_sample.physics_ms = physics_clock.getElapsedTime().asMicroseconds() / 1000.0f;
+
+			// Draw everything where it would be part way through the next step.
+			const float alpha = dt / timestep;
+			raycast_renderer.m_interpolation = alpha;
+			render_camera.pos = (1.0f - alpha) * previous_camera.pos + alpha * camera.pos;
+			render_camera.fwd = (1.0f - alpha) * previous_camera.fwd + alpha * camera.fwd;
+			render_camera.fwd.Normalize();
+
+			if (trace_writer.IsOpen()) {
+				TraceFrame frame;
+				frame.camera_pos = render_camera.pos;
+				frame.camera_fwd = render_camera.fwd;
+				frame.interpolation = alpha;
+				frame.angle_modifier = raycast_renderer.m_angle_modifier;
+				frame.frame_width = uint16(frame_tex_width);
+				frame.steps = uint8(steps);
+				frame.flags = uint8(
+					(raycast_renderer.m_true_distance ? TraceFrame::TRUE_DISTANCE : 0) |
+					(raycast_renderer.m_view_plane_raydir ? TraceFrame::VIEW_PLANE_RAYDIR : 0) |
+					(async_physics ? TraceFrame::ASYNC_PHYSICS : 0) |
+					(render_box2d_debug ? TraceFrame::BOX2D_DEBUG : 0) |
+					(raycast_renderer.m_cost_heatmap ? TraceFrame::COST_HEATMAP : 0));
+				trace_writer.Write(frame);
+			}
 		}
 
 
@@ -288,7 +510,13 @@ int main() {
 
 		if (render_box2d_debug) {
 			// Use the DebugDrawerSFML we set up earlier to render the world.
+			physics_thread.WaitForStep();
 			world.DrawDebugData();
+			if (raycast_renderer.m_cost_heatmap) {
+				tree_node_drawer.Clear();
+				raycast_renderer.TraceRays(world, render_camera, frame_tex_width, &tree_node_drawer);
+				tree_node_drawer.Draw(window);
+			}
 			// Draw camera.
 			{
 				float scale = 32.0f;
@@ -311,23 +539,48 @@ int main() {
 			}
 		}
 		else {
-			//sf::Clock render_time_clock;
+			sf::Clock render_time_clock;
 
 			// Render in EXPERIMENTAL RAYCAST MODE:
 			frame_tex.clear(sf::Color::Transparent);
-			RaycastRender(world, frame_tex, camera);
+			if (async_physics) {
+				raycast_renderer.Render(*snapshot, frame_tex, render_camera);
+			}
+			else {
+				raycast_renderer.Render(world, frame_tex, render_camera);
+			}
 			frame_tex.display();
 			sf::Sprite frame_sprite(frame_tex.getTexture());
 			frame_sprite.setScale((float)window.getSize().x / (float)frame_tex.getSize().x, 
 				(float)window.getSize().y / (float)frame_tex.getSize().y);
 			window.draw(frame_sprite);
 
-			//unsigned render_time_ms = render_time_clock.getElapsedTime().asMilliseconds();
-			//std::cout << render_time_ms << std::endl;
+			float render_time_ms = render_time_clock.getElapsedTime().asMicroseconds() / 1000.0f;
+			frame_sample.raycast_ms = render_time_ms;
+			frame_sample.rays = raycast_renderer.GetRayCount();
+			frame_sample.node_visits = raycast_renderer.GetNodeVisits();
+			frame_sample.leaf_visits = raycast_renderer.GetLeafVisits();
+
+			if (dynamic_resolution) {
+				if (resolution_controller.Update(render_time_ms)) {
+					frame_tex_width = resolution_controller.GetWidth();
+					frame_tex_height = frame_tex_width;
+					frame_tex.create(frame_tex_width, frame_tex_height);
+				}
+			}
+		}
+
+		perf_hud.Draw(window);
+
+		{
+			sf::Clock present_clock;
+			window.display();
+			frame_sample.present_ms = present_clock.getElapsedTime().asMicroseconds() / 1000.0f;
 		}
-		
-		window.display();
+		frame_sample.frame_ms = frame_clock.restart().asMicroseconds() / 1000.0f;
+		perf_hud.AddFrame(frame_sample);
 
+		b2ProfileFrame();
 	}
 
 	return 0;
@@ -0,0 +1,151 @@
+// Rachel Crawford 2016
+// This file lives at https://github.com/rachelnertia/Box2D-Raycasting-Test
+
+#include "perf_hud.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+
+#include "Box2D/Box2D.h"
+
+#include "SFML/Graphics/RenderTarget.hpp"
+
+namespace {
+
+const float bar_width = 2.0f;
+const float graph_height = 96.0f;
+const float margin = 4.0f;
+
+const sf::Color raycast_color(230, 80, 60);
+const sf::Color physics_color(80, 200, 80);
+const sf::Color present_color(70, 130, 230);
+// Whatever is left of the frame: input, the HUD itself, waiting on vsync.
+const sf::Color other_color(150, 150, 150);
+const sf::Color background_color(0, 0, 0, 160);
+
+void AppendQuad(sf::VertexArray& vertices, float left, float top, float right, float bottom,
+	sf::Color color) {
+	vertices.append(sf::Vertex(sf::Vector2f(left, top), color));
+	vertices.append(sf::Vertex(sf::Vector2f(right, top), color));
+	vertices.append(sf::Vertex(sf::Vector2f(right, bottom), color));
+	vertices.append(sf::Vertex(sf::Vector2f(left, bottom), color));
+}
+
+}
+
+bool PerfHud::LoadFont(const char* const* paths, int count) {
+	for (int i = 0; i < count; ++i) {
+		if (paths[i] && m_font.loadFromFile(paths[i])) {
+			m_text.setFont(m_font);
+			m_text.setCharacterSize(12);
+			m_has_font = true;
+			return true;
+		}
+	}
+	return false;
+}
+
+void PerfHud::AddFrame(const FrameSample& sample) {
+	m_samples[m_next] = sample;
+	m_next = (m_next + 1) % history;
+	m_count = std::min(m_count + 1, history);
+}
+
+void PerfHud::SampleWorld(const b2World& world) {
+	if (!m_visible) {
+		return;
+	}
+	m_profile = world.GetProfile();
+	m_proxy_count = world.GetProxyCount();
+}
+
+void PerfHud::Draw(sf::RenderTarget& target) {
+	if (!m_visible || m_count == 0) {
+		return;
+	}
+
+	const float bottom = float(target.getSize().y) - margin;
+	BuildGraph(margin, bottom);
+	target.draw(m_graph);
+
+	if (m_has_font) {
+		BuildText();
+		m_text.setPosition(margin, margin);
+		target.draw(m_text);
+	}
+}
+
+// One bar per frame, oldest on the left, split into the raycast, physics and present
+// times stacked from the bottom.
+void PerfHud::BuildGraph(float left, float bottom) {
+	m_graph.setPrimitiveType(sf::PrimitiveType::Quads);
+	m_graph.clear();
+
+	const float top = bottom - graph_height;
+	AppendQuad(m_graph, left, top, left + history * bar_width, bottom, background_color);
+
+	const float scale = graph_height / m_graph_ms;
+	for (int i = 0; i < m_count; ++i) {
+		const FrameSample& sample = m_samples[(m_next - m_count + i + history) % history];
+		const float x = left + (history - m_count + i) * bar_width;
+
+		const float parts[4] = {
+			sample.raycast_ms,
+			sample.physics_ms,
+			sample.present_ms,
+			sample.frame_ms - sample.raycast_ms - sample.physics_ms - sample.present_ms
+		};
+		const sf::Color colors[4] = { raycast_color, physics_color, present_color, other_color };
+
+		float y = bottom;
+		for (int p = 0; p < 4; ++p) {
+			const float height = std::min(std::max(parts[p], 0.0f) * scale, y - top);
+			AppendQuad(m_graph, x, y - height, x + bar_width, y, colors[p]);
+			y -= height;
+		}
+	}
+
+	// Mark the time a frame has at 60Hz.
+	const float budget_y = bottom - std::min(1000.0f / 60.0f * scale, graph_height);
+	AppendQuad(m_graph, left, budget_y, left + history * bar_width, budget_y + 1.0f, sf::Color::White);
+}
+
+void PerfHud::BuildText() {
+	float frame_ms = 0.0f, worst_ms = 0.0f, raycast_ms = 0.0f, physics_ms = 0.0f, present_ms = 0.0f;
+	double rays = 0.0, node_visits = 0.0, leaf_visits = 0.0;
+	for (int i = 0; i < m_count; ++i) {
+		const FrameSample& sample = m_samples[i];
+		frame_ms += sample.frame_ms;
+		worst_ms = std::max(worst_ms, sample.frame_ms);
+		raycast_ms += sample.raycast_ms;
+		physics_ms += sample.physics_ms;
+		present_ms += sample.present_ms;
+		rays += sample.rays;
+		node_visits += sample.node_visits;
+		leaf_visits += sample.leaf_visits;
+	}
+
+	const float frames = float(m_count);
+	const double per_ray = rays > 0.0 ? 1.0 / rays : 0.0;
+
+	std::ostringstream text;
+	text << std::fixed << std::setprecision(2);
+	text << "frame    " << frame_ms / frames << " ms (worst " << worst_ms << ")\n";
+	text << "raycast  " << raycast_ms / frames << " ms\n";
+	text << "physics  " << physics_ms / frames << " ms\n";
+	text << "present  " << present_ms / frames << " ms\n";
+	text << std::setprecision(0);
+	text << "rays/sec " << (frame_ms > 0.0f ? rays * 1000.0 / frame_ms : 0.0) << '\n';
+	text << std::setprecision(1);
+	text << "nodes/ray " << node_visits * per_ray << "  leaves/ray " << leaf_visits * per_ray << '\n';
+	text << "proxies  " << m_proxy_count << "\n\n";
+	text << std::setprecision(2);
+	text << "step     " << m_profile.step << " ms\n";
+	text << "collide  " << m_profile.collide << "\n";
+	text << "solve    " << m_profile.solve << " (init " << m_profile.solveInit << ", vel " <<
+		m_profile.solveVelocity << ", pos " << m_profile.solvePosition << ")\n";
+	text << "broadphase " << m_profile.broadphase << "\n";
+	text << "solve TOI  " << m_profile.solveTOI << "\n";
+	m_text.setString(text.str());
+}
@@ -0,0 +1,71 @@
+// Rachel Crawford 2016
+// This file lives at https://github.com/rachelnertia/Box2D-Raycasting-Test
+
+#ifndef PERF_HUD_H_
+#define PERF_HUD_H_
+
+#include "Box2D/Dynamics/b2TimeStep.h"
+
+#include "SFML/Graphics/Font.hpp"
+#include "SFML/Graphics/Text.hpp"
+#include "SFML/Graphics/VertexArray.hpp"
+
+class b2World;
+
+namespace sf {
+	class RenderTarget;
+}
+
+// Where the time of one frame went. Times are in milliseconds.
+struct FrameSample {
+	float frame_ms;
+	float raycast_ms;
+	// Stepping the world, or waiting for the physics thread at the sync point.
+	float physics_ms;
+	float present_ms;
+	unsigned rays;
+	unsigned node_visits;
+	unsigned leaf_visits;
+};
+
+// An overlay that graphs the last few seconds of frame times and lists the raycasting
+// and Box2D numbers behind them. Frames are always recorded, which is only a copy into
+// a ring buffer, so the graph is full as soon as the overlay is shown. Everything else,
+// including building the text, is skipped while it is hidden.
+class PerfHud {
+public:
+	bool m_visible = false;
+	// The frame time at the top of the graph.
+	float m_graph_ms = 33.3f;
+
+	// Try each font file in turn until one loads. Without a font only the graph is drawn.
+	bool LoadFont(const char* const* paths, int count);
+
+	void AddFrame(const FrameSample& sample);
+
+	// Copy the world's step profile and proxy count. Only call this while the world isn't
+	// stepping on another thread.
+	void SampleWorld(const b2World& world);
+
+	void Draw(sf::RenderTarget& target);
+
+private:
+	static const int history = 128;
+
+	void BuildGraph(float left, float bottom);
+	void BuildText();
+
+	FrameSample m_samples[history];
+	int m_next = 0;
+	int m_count = 0;
+
+	b2Profile m_profile = b2Profile();
+	int m_proxy_count = 0;
+
+	sf::Font m_font;
+	bool m_has_font = false;
+	sf::Text m_text;
+	sf::VertexArray m_graph;
+};
+
+#endif//PERF_HUD_H_
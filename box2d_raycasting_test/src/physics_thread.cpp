@@ -0,0 +1,61 @@
+// Rachel Crawford 2016
+// This file lives at https://github.com/rachelnertia/Box2D-Raycasting-Test
+
+#include "physics_thread.h"
+
+#include "Box2D/Dynamics/b2World.h"
+
+#include "SFML/System/Clock.hpp"
+
+PhysicsThread::PhysicsThread(b2World& world) : m_world(world) {
+	m_thread = std::thread(&PhysicsThread::Run, this);
+}
+
+PhysicsThread::~PhysicsThread() {
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_quit = true;
+	}
+	m_condition.notify_all();
+	m_thread.join();
+}
+
+void PhysicsThread::BeginStep(float timestep, int step_count) {
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_timestep = timestep;
+		m_step_count = step_count;
+		m_stepping = true;
+	}
+	m_condition.notify_all();
+}
+
+void PhysicsThread::WaitForStep() {
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_condition.wait(lock, [this] { return !m_stepping; });
+}
+
+void PhysicsThread::Run() {
+	std::unique_lock<std::mutex> lock(m_mutex);
+	for (;;) {
+		m_condition.wait(lock, [this] { return m_stepping || m_quit; });
+		if (m_quit) {
+			return;
+		}
+
+		// Let the main thread check on the step while it runs.
+		float timestep = m_timestep;
+		int step_count = m_step_count;
+		lock.unlock();
+		sf::Clock step_clock;
+		for (int i = 0; i < step_count; ++i) {
+			m_world.Step(timestep, m_velocity_iterations, m_position_iterations);
+		}
+		float step_ms = step_clock.getElapsedTime().asMicroseconds() / 1000.0f;
+		lock.lock();
+
+		m_step_ms = step_ms;
+		m_stepping = false;
+		m_condition.notify_all();
+	}
+}
@@ -0,0 +1,53 @@
+// Rachel Crawford 2016
+// This file lives at https://github.com/rachelnertia/Box2D-Raycasting-Test
+
+#ifndef PHYSICS_THREAD_H_
+#define PHYSICS_THREAD_H_
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+class b2World;
+
+// Steps a Box2D world on its own thread so that rendering can overlap the simulation.
+// Between BeginStep and WaitForStep the world belongs to the physics thread and must
+// not be touched; render from a b2QuerySnapshot taken at the sync point instead.
+class PhysicsThread {
+public:
+	int m_velocity_iterations = 8;
+	int m_position_iterations = 2;
+
+	explicit PhysicsThread(b2World& world);
+	~PhysicsThread();
+
+	// Start stepping the world step_count times. The previous steps must have been
+	// waited for.
+	void BeginStep(float timestep, int step_count = 1);
+
+	// Block until the current step, if any, has finished. This is the sync point.
+	void WaitForStep();
+
+	// The time the last batch of steps took. Only read this after WaitForStep.
+	float GetStepMs() const { return m_step_ms; }
+
+private:
+	PhysicsThread(const PhysicsThread&);
+	PhysicsThread& operator=(const PhysicsThread&);
+
+	void Run();
+
+	b2World& m_world;
+
+	std::mutex m_mutex;
+	std::condition_variable m_condition;
+	bool m_stepping = false;
+	bool m_quit = false;
+	float m_timestep = 0.0f;
+	int m_step_count = 0;
+	float m_step_ms = 0.0f;
+
+	std::thread m_thread;
+};
+
+#endif//PHYSICS_THREAD_H_
@@ -0,0 +1,379 @@
+// Rachel Crawford 2016
+// This file lives at https://github.com/rachelnertia/Box2D-Raycasting-Test
+
+#include "raycast_renderer.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "Box2D/Box2D.h"
+
+#include "SFML/Graphics/RenderTarget.hpp"
+
+namespace {
+
+// Combines the bounds of the proxies of each non-static body in a snapshot query.
+class SnapshotBodyCallback {
+public:
+	explicit SnapshotBodyCallback(RaycastRenderer::BodyBoundsMap& bodies) : m_bodies(bodies) {}
+
+	bool ReportProxy(const b2SnapshotProxy& proxy) {
+		if (proxy.bodyType == b2_staticBody) {
+			return true;
+		}
+
+		auto inserted = m_bodies.insert(std::make_pair(proxy.body, RaycastRenderer::BodyBounds()));
+		RaycastRenderer::BodyBounds& body = inserted.first->second;
+		if (inserted.second) {
+			body.bounds = proxy.aabb;
+			body.position = proxy.transform.p;
+		}
+		else {
+			body.bounds.Combine(proxy.aabb);
+		}
+		return true;
+	}
+
+private:
+	RaycastRenderer::BodyBoundsMap& m_bodies;
+};
+
+class RayCastCallback : public b2RayCastCallback {
+public:
+
+	float32 ReportFixture(b2Fixture* fixture, const b2Vec2& point,
+		const b2Vec2& normal, float32 fraction)
+	{
+		m_fixture = fixture;
+		m_point = point;
+		m_normal = normal;
+		m_fraction = fraction;
+		return fraction;
+	}
+
+	b2Fixture* m_fixture = nullptr;
+	b2Vec2 m_point;
+	b2Vec2 m_normal;
+	float32 m_fraction;
+};
+
+// Make far-away things darker.
+sf::Uint8 DistanceShade(float distance, float ray_length) {
+	return sf::Uint8((1.f - (distance / ray_length)) * 255.0f);
+}
+
+// Sprites closer than this to the camera plane are not drawn.
+const float near_distance = 0.1f;
+
+// Blue through green to red as value goes from 0 to max.
+sf::Color HeatColor(float value, float max) {
+	const float t = std::min(std::max(value / max, 0.0f), 1.0f);
+	return sf::Color(
+		sf::Uint8(255.0f * std::max(2.0f * t - 1.0f, 0.0f)),
+		sf::Uint8(255.0f * (1.0f - std::abs(2.0f * t - 1.0f))),
+		sf::Uint8(255.0f * std::max(1.0f - 2.0f * t, 0.0f)));
+}
+
+}
+
+b2Vec2 RotateVec(const b2Vec2& vec, const float angle) {
+	return b2Vec2(
+		vec.x*cosf(angle) - vec.y*sinf(angle),
+		vec.x*sinf(angle) + vec.y*cosf(angle));
+}
+
+float RaycastRenderer::GetViewAngle() const {
+	return 3.14f * (0.25f * m_angle_modifier);
+}
+
+b2Vec2 RaycastRenderer::GetRayDirection(const Camera& camera, float screenx) const {
+	const b2Vec2 view_plane(-camera.fwd.y * m_angle_modifier, camera.fwd.x * m_angle_modifier);
+	// There are 2 ways to calculate the ray's direction.
+	return m_view_plane_raydir ?
+		// 1: Scale the view plane vector by screenx and add it to the camera's forward vector.
+		(camera.fwd) + (screenx * view_plane) :
+		// 2: Rotate the camera's forward vector by the viewing angle scaled by screenx.
+		RotateVec(camera.fwd, GetViewAngle() * screenx);
+}
+
+b2Vec2 RaycastRenderer::GetRayEnd(const Camera& camera, unsigned column, unsigned width) const {
+	// [-1, 1] How far across the screen from left to right the column is.
+	float screenx = -1.0f + (2.0f * (column / (float)width));
+	return camera.pos + m_ray_length * GetRayDirection(camera, screenx);
+}
+
+void RaycastRenderer::Render(const b2World& world, sf::RenderTarget& target, const Camera& camera) {
+	BuildScene(world, camera, target.getSize().x, target.getSize().y);
+	target.draw(m_lines);
+}
+
+void RaycastRenderer::Render(const b2QuerySnapshot& snapshot, sf::RenderTarget& target, const Camera& camera) {
+	BuildScene(snapshot, camera, target.getSize().x, target.getSize().y);
+	target.draw(m_lines);
+}
+
+void RaycastRenderer::BuildFrame(const b2World& world, const Camera& camera, unsigned width, unsigned height) {
+	BuildScene(world, camera, width, height);
+}
+
+void RaycastRenderer::BuildFrame(const b2QuerySnapshot& snapshot, const Camera& camera, unsigned width,
+	unsigned height) {
+	BuildScene(snapshot, camera, width, height);
+}
+
+template <typename Scene>
+void RaycastRenderer::BuildScene(const Scene& scene, const Camera& camera, unsigned width, unsigned height) {
+	m_lines.setPrimitiveType(sf::PrimitiveType::Lines);
+	m_lines.clear();
+
+	RenderWalls(scene, camera, width, height);
+	m_sprites.clear();
+	if (m_cost_heatmap) {
+		return;
+	}
+	AddSprites(scene, camera, width, height);
+	RenderSprites(width, height);
+}
+
+void RaycastRenderer::TraceRays(const b2World& world, const Camera& camera, unsigned width,
+	b2TreeNodeCallback* node_callback) const {
+	for (unsigned i = 0; i < width; ++i) {
+		RayCastCallback callback;
+		world.RayCast(&callback, camera.pos, GetRayEnd(camera, i, width), WALL_CATEGORY, node_callback);
+	}
+}
+
+template <typename Scene>
+void RaycastRenderer::RenderWalls(const Scene& scene, const Camera& camera, unsigned width, unsigned height) {
+	b2ProfileScope("RaycastRenderer::RenderWalls");
+
+	const b2Vec2 raystart = camera.pos;
+
+	m_depth_buffer.assign(width, m_ray_length);
+	m_column_stats.resize(width);
+	m_ray_count = width;
+	m_node_visits = 0;
+	m_leaf_visits = 0;
+
+	// Cast a ray for each horizontal pixel.
+	for (unsigned i = 0; i < width; ++i) {
+		// Determine the end point of the ray in world space.
+		b2Vec2 rayend = GetRayEnd(camera, i, width);
+
+		RayCastCallback callback;
+		b2TreeStats stats = scene.RayCast(&callback, raystart, rayend, WALL_CATEGORY); // Cast the ray!
+		m_column_stats[i] = stats;
+		m_node_visits += stats.nodeVisits;
+		m_leaf_visits += stats.leafVisits;
+
+		if (m_cost_heatmap) {
+			const float x = float(i + 1);
+			const float middle = float(height / 2);
+			const sf::Color node_color = HeatColor(float(stats.nodeVisits), m_heatmap_max_nodes);
+			const sf::Color leaf_color = HeatColor(float(stats.leafVisits), m_heatmap_max_leaves);
+			m_lines.append(sf::Vertex(sf::Vector2f(x, 0.0f), node_color));
+			m_lines.append(sf::Vertex(sf::Vector2f(x, middle), node_color));
+			m_lines.append(sf::Vertex(sf::Vector2f(x, middle), leaf_color));
+			m_lines.append(sf::Vertex(sf::Vector2f(x, float(height)), leaf_color));
+		}
+
+		if (callback.m_fixture) { // If the ray hit something...
+			b2Vec2 ray = (callback.m_point - raystart);
+			// Use either the 1) actual distance or 2) perpendicular distance from the camera to the
+			// ray hit point.
+			float distance = m_true_distance ? ray.Length() : b2Dot(ray, camera.fwd);
+			m_depth_buffer[i] = distance;
+			if (m_cost_heatmap) {
+				continue;
+			}
+			// Use this distance to figure out how tall a line to draw.
+			int line_height = abs(int(height / distance));
+			sf::Uint8 f = DistanceShade(distance, m_ray_length);
+			sf::Color c(f, f, f);
+
+			m_lines.append(sf::Vertex(sf::Vector2f(float(i+1), (float)(height / 2) - (line_height / 2)), c));
+			m_lines.append(sf::Vertex(sf::Vector2f(float(i+1), (float)(height / 2) + (line_height / 2)), c));
+		}
+	}
+}
+
+// Works out where a body would appear on screen. Returns false if it is behind the camera,
+// off the edge of the screen or beyond the reach of the rays.
+bool RaycastRenderer::ProjectSprite(const b2AABB& bounds, const Camera& camera, unsigned width, unsigned height,
+	Sprite& sprite) const
+{
+	const b2Vec2 extents = bounds.GetExtents();
+	const float radius = std::max(extents.x, extents.y);
+	const b2Vec2 offset = bounds.GetCenter() - camera.pos;
+	const float forward = b2Dot(offset, camera.fwd);
+	if (forward < near_distance) {
+		return false;
+	}
+
+	const float length = offset.Length();
+	sprite.distance = m_true_distance ? length : forward;
+	if (sprite.distance >= m_ray_length) {
+		return false;
+	}
+
+	// Find the sprite's centre and half-width in the same [-1, 1] screen space the rays use.
+	float screenx, half_width;
+	if (m_view_plane_raydir) {
+		const b2Vec2 view_plane(-camera.fwd.y * m_angle_modifier, camera.fwd.x * m_angle_modifier);
+		const float plane_length = view_plane.Length();
+		screenx = b2Dot(offset, view_plane) / (forward * plane_length * plane_length);
+		half_width = radius / (forward * plane_length);
+	}
+	else {
+		const float view_angle = GetViewAngle();
+		screenx = atan2f(b2Cross(camera.fwd, offset), forward) / view_angle;
+		half_width = asinf(std::min(radius / length, 1.0f)) / view_angle;
+	}
+
+	// Convert to columns.
+	const float half_screen = 0.5f * width;
+	sprite.left = (screenx - half_width + 1.0f) * half_screen;
+	sprite.right = (screenx + half_width + 1.0f) * half_screen;
+	if (sprite.right < 0.0f || sprite.left >= width) {
+		return false;
+	}
+
+	sprite.height = 2.0f * radius * height / sprite.distance;
+	return true;
+}
+
+void RaycastRenderer::AddSprites(const b2World& world, const Camera& camera, unsigned width, unsigned height) {
+	for (const b2Body* body = world.GetBodyList(); body; body = body->GetNext()) {
+		const b2Fixture* fixture = body->GetFixtureList();
+		if (body->GetType() == b2_staticBody || !fixture) {
+			continue;
+		}
+
+		// Bound the body's shapes.
+		b2AABB bounds;
+		fixture->GetShape()->ComputeAABB(&bounds, body->GetTransform(), 0);
+		for (; fixture; fixture = fixture->GetNext()) {
+			const b2Shape* shape = fixture->GetShape();
+			for (int32 child = 0; child < shape->GetChildCount(); ++child) {
+				b2AABB aabb;
+				shape->ComputeAABB(&aabb, body->GetTransform(), child);
+				bounds.Combine(aabb);
+			}
+		}
+
+		const b2Vec2 offset = GetInterpolationOffset(body, body->GetPosition());
+		bounds.lowerBound += offset;
+		bounds.upperBound += offset;
+
+		Sprite sprite;
+		if (ProjectSprite(bounds, camera, width, height, sprite)) {
+			m_sprites.push_back(sprite);
+		}
+	}
+}
+
+void RaycastRenderer::AddSprites(const b2QuerySnapshot& snapshot, const Camera& camera, unsigned width, unsigned height) {
+	// Nothing further away than the rays reach is drawn.
+	const b2Vec2 reach(m_ray_length, m_ray_length);
+	b2AABB view_bounds;
+	view_bounds.lowerBound = camera.pos - reach;
+	view_bounds.upperBound = camera.pos + reach;
+
+	// Gather the proxies in view by body.
+	m_body_bounds.clear();
+	SnapshotBodyCallback callback(m_body_bounds);
+	snapshot.QueryProxies(&callback, view_bounds);
+
+	for (const auto& entry : m_body_bounds) {
+		const BodyBounds& body = entry.second;
+		const b2Vec2 offset = GetInterpolationOffset(entry.first, body.position);
+		b2AABB bounds = body.bounds;
+		bounds.lowerBound += offset;
+		bounds.upperBound += offset;
+
+		Sprite sprite;
+		if (ProjectSprite(bounds, camera, width, height, sprite)) {
+			m_sprites.push_back(sprite);
+		}
+	}
+}
+
+void RaycastRenderer::RecordPreviousPositions(const b2World& world) {
+	m_previous_positions.clear();
+	for (const b2Body* body = world.GetBodyList(); body; body = body->GetNext()) {
+		if (body->GetType() != b2_staticBody) {
+			m_previous_positions[body] = body->GetPosition();
+		}
+	}
+}
+
+void RaycastRenderer::RecordPreviousPositions(const b2QuerySnapshot& snapshot) {
+	b2AABB everywhere;
+	everywhere.lowerBound.Set(-b2_maxFloat, -b2_maxFloat);
+	everywhere.upperBound.Set(b2_maxFloat, b2_maxFloat);
+
+	m_body_bounds.clear();
+	SnapshotBodyCallback callback(m_body_bounds);
+	snapshot.QueryProxies(&callback, everywhere);
+
+	m_previous_positions.clear();
+	for (const auto& entry : m_body_bounds) {
+		m_previous_positions[entry.first] = entry.second.position;
+	}
+}
+
+b2Vec2 RaycastRenderer::GetInterpolationOffset(const b2Body* body, const b2Vec2& position) const {
+	auto previous = m_previous_positions.find(body);
+	if (previous == m_previous_positions.end()) {
+		return b2Vec2_zero;
+	}
+	return (1.0f - m_interpolation) * (previous->second - position);
+}
+
+void RaycastRenderer::RenderSprites(unsigned width, unsigned height) {
+	b2ProfileScope("RaycastRenderer::RenderSprites");
+
+	m_sprites_drawn = 0;
+	m_sprites_culled = 0;
+
+	// Draw far sprites first so near ones cover them.
+	std::sort(m_sprites.begin(), m_sprites.end(), [](const Sprite& a, const Sprite& b) {
+		return a.distance > b.distance;
+	});
+
+	for (const Sprite& sprite : m_sprites) {
+		const unsigned first = unsigned(std::max(ceilf(sprite.left), 0.0f));
+		const unsigned last = unsigned(std::min(floorf(sprite.right), float(width - 1)));
+
+		// Skip the whole sprite if a wall is in front of it in every column it covers.
+		bool visible = false;
+		for (unsigned i = first; i <= last && !visible; ++i) {
+			visible = sprite.distance < m_depth_buffer[i];
+		}
+		if (!visible) {
+			++m_sprites_culled;
+			continue;
+		}
+		++m_sprites_drawn;
+
+		// Sprites stand on the floor, which is half a wall's height below the camera.
+		const float floor_y = (height / 2) + 0.5f * height / sprite.distance;
+		const float centre_y = floor_y - 0.5f * sprite.height;
+		const float centre_x = 0.5f * (sprite.left + sprite.right);
+		const float half_width = 0.5f * (sprite.right - sprite.left);
+
+		sf::Uint8 f = DistanceShade(sprite.distance, m_ray_length);
+		sf::Color c(f, f / 4, f / 4);
+
+		// Draw the columns that aren't hidden by a wall, each as a slice of a disc.
+		for (unsigned i = first; i <= last; ++i) {
+			if (sprite.distance >= m_depth_buffer[i]) {
+				continue;
+			}
+			const float u = (i - centre_x) / half_width;
+			const float half_slice = 0.5f * sprite.height * sqrtf(std::max(1.0f - u * u, 0.0f));
+			m_lines.append(sf::Vertex(sf::Vector2f(float(i+1), centre_y - half_slice), c));
+			m_lines.append(sf::Vertex(sf::Vector2f(float(i+1), centre_y + half_slice), c));
+		}
+	}
+}
@@ -0,0 +1,142 @@
+// Rachel Crawford 2016
+// This file lives at https://github.com/rachelnertia/Box2D-Raycasting-Test
+
+#ifndef RAYCAST_RENDERER_H_
+#define RAYCAST_RENDERER_H_
+
+#include <unordered_map>
+#include <vector>
+
+#include "Box2D/Collision/b2Collision.h"
+#include "Box2D/Collision/b2DynamicTree.h"
+#include "Box2D/Common/b2Math.h"
+
+#include "SFML/Graphics/VertexArray.hpp"
+
+class b2Body;
+class b2QuerySnapshot;
+class b2World;
+
+namespace sf {
+	class RenderTarget;
+}
+
+struct Camera {
+	b2Vec2 pos;
+	b2Vec2 fwd;
+};
+
+b2Vec2 RotateVec(const b2Vec2& vec, const float angle);
+
+// Fixture category bits. Walls are drawn by the raycast pass, entities by the sprite pass.
+enum : uint16 {
+	WALL_CATEGORY = 0x0001,
+	ENTITY_CATEGORY = 0x0002
+};
+
+// Draws a Box2D world from a camera's point of view by casting one ray per column.
+// Walls are drawn as vertical lines and non-static bodies as billboard sprites that are
+// clipped against the wall depth of each column.
+class RaycastRenderer {
+public:
+	// Use the actual distance to the ray hit point rather than the perpendicular distance.
+	bool m_true_distance = true;
+	// Work out ray directions from the view plane rather than by rotating the forward vector.
+	bool m_view_plane_raydir = true;
+	// Scales the width of the view.
+	float m_angle_modifier = 1.0f;
+	// How far rays will travel before they will stop.
+	float m_ray_length = 15.0f;
+	// Where to draw sprites between their recorded previous position (0) and their
+	// current position (1), so that motion looks smooth at any refresh rate.
+	float m_interpolation = 1.0f;
+	// Colour each column by how much work its ray did instead of drawing the scene. The top
+	// half of a column shows the broad-phase nodes its ray visited and the bottom half the
+	// wall fixtures it tested, going from blue to red as they reach these counts.
+	bool m_cost_heatmap = false;
+	float m_heatmap_max_nodes = 64.0f;
+	float m_heatmap_max_leaves = 8.0f;
+
+	void Render(const b2World& world, sf::RenderTarget& target, const Camera& camera);
+
+	// Render from a snapshot of the world, e.g. while the world steps on another thread.
+	void Render(const b2QuerySnapshot& snapshot, sf::RenderTarget& target, const Camera& camera);
+
+	// Do all of the work of Render except drawing, e.g. to time rendering without a window.
+	void BuildFrame(const b2World& world, const Camera& camera, unsigned width, unsigned height);
+	void BuildFrame(const b2QuerySnapshot& snapshot, const Camera& camera, unsigned width, unsigned height);
+
+	// Cast the rays of a frame without drawing anything and report every broad-phase node
+	// they visit, e.g. to draw the parts of the tree the view is paying for.
+	void TraceRays(const b2World& world, const Camera& camera, unsigned width,
+		b2TreeNodeCallback* node_callback) const;
+
+	// Remember where the non-static bodies are before the world is stepped.
+	void RecordPreviousPositions(const b2World& world);
+	void RecordPreviousPositions(const b2QuerySnapshot& snapshot);
+
+	// The distance to the nearest wall in each column, from the last call to Render.
+	// Columns that didn't hit anything hold m_ray_length.
+	const std::vector<float>& GetDepthBuffer() const { return m_depth_buffer; }
+
+	// How many sprites were drawn and how many were hidden behind walls in the last frame.
+	unsigned GetSpritesDrawn() const { return m_sprites_drawn; }
+	unsigned GetSpritesCulled() const { return m_sprites_culled; }
+
+	// How many rays were cast in the last frame, and how many broad-phase nodes and
+	// wall fixtures they visited between them.
+	unsigned GetRayCount() const { return m_ray_count; }
+	unsigned GetNodeVisits() const { return m_node_visits; }
+	unsigned GetLeafVisits() const { return m_leaf_visits; }
+	// The same for each column.
+	const std::vector<b2TreeStats>& GetColumnStats() const { return m_column_stats; }
+
+	// The bounds of a body gathered from its proxies in a snapshot.
+	struct BodyBounds {
+		b2AABB bounds;
+		b2Vec2 position;
+	};
+	typedef std::unordered_map<const b2Body*, BodyBounds> BodyBoundsMap;
+
+private:
+	struct Sprite {
+		float distance;
+		// Horizontal extent on screen in columns.
+		float left;
+		float right;
+		float height;
+	};
+
+	float GetViewAngle() const;
+	b2Vec2 GetRayDirection(const Camera& camera, float screenx) const;
+	b2Vec2 GetRayEnd(const Camera& camera, unsigned column, unsigned width) const;
+	bool ProjectSprite(const b2AABB& bounds, const Camera& camera, unsigned width, unsigned height,
+		Sprite& sprite) const;
+
+	// Scene is either a b2World or a b2QuerySnapshot.
+	template <typename Scene>
+	void BuildScene(const Scene& scene, const Camera& camera, unsigned width, unsigned height);
+	template <typename Scene>
+	void RenderWalls(const Scene& scene, const Camera& camera, unsigned width, unsigned height);
+	void AddSprites(const b2World& world, const Camera& camera, unsigned width, unsigned height);
+	void AddSprites(const b2QuerySnapshot& snapshot, const Camera& camera, unsigned width, unsigned height);
+	void RenderSprites(unsigned width, unsigned height);
+
+	// How far to move a sprite from where its body is now to where it should be drawn.
+	b2Vec2 GetInterpolationOffset(const b2Body* body, const b2Vec2& position) const;
+
+	std::vector<float> m_depth_buffer;
+	std::vector<b2TreeStats> m_column_stats;
+	std::vector<Sprite> m_sprites;
+	std::unordered_map<const b2Body*, b2Vec2> m_previous_positions;
+	BodyBoundsMap m_body_bounds;
+	sf::VertexArray m_lines;
+
+	unsigned m_sprites_drawn = 0;
+	unsigned m_sprites_culled = 0;
+	unsigned m_ray_count = 0;
+	unsigned m_node_visits = 0;
+	unsigned m_leaf_visits = 0;
+};
+
+#endif//RAYCAST_RENDERER_H_
@@ -0,0 +1,61 @@
+// Rachel Crawford 2016
+// This file lives at https://github.com/rachelnertia/Box2D-Raycasting-Test
+
+#include "resolution_controller.h"
+
+#include <algorithm>
+
+ResolutionController::ResolutionController(unsigned width) {
+	SetWidth(width);
+}
+
+void ResolutionController::SetWidth(unsigned width) {
+	m_width = std::min(std::max(width, m_min_width), m_max_width);
+	m_average_ms = 0.0f;
+	m_frames_since_change = 0;
+}
+
+bool ResolutionController::Update(float render_ms) {
+	// The first frame after a change seeds the average.
+	if (m_frames_since_change == 0) {
+		m_average_ms = render_ms;
+	}
+	else {
+		m_average_ms += m_smoothing * (render_ms - m_average_ms);
+	}
+	++m_frames_since_change;
+
+	if (m_average_ms <= 0.0f) {
+		return false;
+	}
+
+	const bool over_budget = m_average_ms > m_budget_ms;
+	const bool under_budget = m_average_ms < m_grow_ratio * m_budget_ms &&
+		m_frames_since_change >= m_settle_frames;
+	if (!over_budget && !under_budget) {
+		return false;
+	}
+
+	// Scale the width to land at the target fraction of the budget. Growth is limited
+	// because a few cheap frames are a weak estimate of what more columns would cost.
+	float scale = (m_target_ratio * m_budget_ms) / m_average_ms;
+	scale = std::min(scale, 1.25f);
+
+	unsigned width = unsigned(m_width * scale);
+	width = std::min(std::max(width, m_min_width), m_max_width);
+	const unsigned change = width > m_width ? width - m_width : m_width - width;
+	if (change < m_min_change && width != m_min_width && width != m_max_width) {
+		return false;
+	}
+	if (width == m_width) {
+		return false;
+	}
+
+	// Assume the cost per column stays the same.
+	const float average_ms = m_average_ms * width / m_width;
+	SetWidth(width);
+	m_average_ms = average_ms;
+	// Don't reseed from the first frame; it may include recreating the frame texture.
+	m_frames_since_change = 1;
+	return true;
+}
@@ -0,0 +1,52 @@
+// Rachel Crawford 2016
+// This file lives at https://github.com/rachelnertia/Box2D-Raycasting-Test
+
+#ifndef RESOLUTION_CONTROLLER_H_
+#define RESOLUTION_CONTROLLER_H_
+
+// Picks how many columns the raycast renderer should draw so that rendering a frame
+// stays inside a time budget. Render time grows roughly linearly with the number of
+// columns, so the controller scales the width by the ratio of the budget to the
+// measured time.
+//
+// To stop the resolution from oscillating it only shrinks when the smoothed frame time
+// is over budget and only grows when it is comfortably under, after the new width has
+// had time to settle.
+class ResolutionController {
+public:
+	// The time rendering a frame should take.
+	float m_budget_ms = 8.0f;
+	// Aim for this fraction of the budget when picking a new width.
+	float m_target_ratio = 0.85f;
+	// Only grow when the smoothed time is below this fraction of the budget.
+	float m_grow_ratio = 0.7f;
+	// How much of each new measurement goes into the smoothed time.
+	float m_smoothing = 0.2f;
+	// Wait this many frames after a change before growing again.
+	unsigned m_settle_frames = 30;
+	// Ignore changes smaller than this many columns.
+	unsigned m_min_change = 8;
+
+	unsigned m_min_width = 64;
+	unsigned m_max_width = 512;
+
+	explicit ResolutionController(unsigned width);
+
+	// Report how long the last frame took to render at the current width.
+	// Returns true if the width changed.
+	bool Update(float render_ms);
+
+	unsigned GetWidth() const { return m_width; }
+	// Force the width, e.g. when it is chosen by hand.
+	void SetWidth(unsigned width);
+
+	// The smoothed render time.
+	float GetAverageMs() const { return m_average_ms; }
+
+private:
+	unsigned m_width;
+	float m_average_ms = 0.0f;
+	unsigned m_frames_since_change = 0;
+};
+
+#endif//RESOLUTION_CONTROLLER_H_